@@ -0,0 +1,489 @@
+#!/usr/bin/env python3
+"""Performance fuzzer hunting for inputs the tokenizer handles superlinearly.
+
+Each mutation inserts a repeated unit into a ``demo/sample.*`` seed, e.g. an
+opening bracket for deep nesting, a quote for unclosed strings, a run of
+backslashes or a fragment of the seed itself, so the input grows with the
+repeat count ``n``::
+
+    prefix + unit * n + suffix
+
+The input is tokenized at a repeat count taking a measurable time and at 4
+times it, and the growth exponent of the time spent on the repeated part
+is estimated, 1 for linear and 2 for quadratic.  Mutations growing faster
+than the threshold are minimized, shrinking the unit, then the prefix and
+suffix while the growth stays superlinear, and saved to the corpus as JSON.
+
+``--check`` measures the corpus again, to check grammar or engine changes
+against known worst cases.  An entry recorded as fixed fails once it is
+superlinear again.  An entry still open fails only if it grows faster than
+when it was found, so the gate stays green on known, unfixed cases.
+``--mark-fixed`` records the open entries measuring linear as fixed.
+
+Usage::
+
+    python benchmarks/fuzz.py --language py --iterations 200
+    python benchmarks/fuzz.py --check
+    python benchmarks/fuzz.py --check --mark-fixed
+"""
+from __future__ import annotations
+
+import argparse
+import hashlib
+import json
+import math
+import random
+import sys
+import time
+
+from pathlib import Path
+from typing import Any
+from typing import NamedTuple
+from typing import Optional
+
+
+DEMO_DIR = Path(__file__).resolve().parent.parent / "demo"
+CORPUS_DIR = Path(__file__).resolve().parent / "corpus"
+
+#: Growth exponent above which an input is superlinear
+THRESHOLD = 1.5
+
+#: Time the smaller input must take for its growth to be measured, in seconds
+MIN_SECONDS = 0.005
+
+#: Largest repeated part measured, in characters
+MAX_CHARS = 200_000
+
+#: Growth exponent an open corpus entry may measure over the one it was
+#: found with, as the exponent of one input varies between runs
+EXPONENT_SLACK = 0.25
+
+# Units known to stress TextMate grammars and regex engines
+_UNITS = (
+    "(", "[", "{", "<div>", "${", "/*", "<!--", "`",
+    '"', "'", '\\"', "\\", "\\\\", "a\\", " ", "\t", "-", "#", "*", "_",
+    "a", "0", ".", ",", ":", "=", "a ", "a=", "- ", "> ", "* ", "  - a:",
+)
+
+
+class Mutation(NamedTuple):
+    """An input scaling with a repeat count.
+
+    Attributes:
+        language: The extension of the seed sample
+        prefix: The text before the repeated unit
+        unit: The repeated unit
+        suffix: The text after the repeated unit
+    """
+
+    language: str
+    prefix: str
+    unit: str
+    suffix: str
+
+    def text(self, n: int) -> str:
+        """Get the input with the unit repeated n times."""
+        return f"{self.prefix}{self.unit * n}{self.suffix}"
+
+    @property
+    def name(self) -> str:
+        """Get a name identifying the mutation, for its corpus file."""
+        digest = hashlib.sha1("\0".join(self).encode("utf-8")).hexdigest()
+        return f"{self.language}-{digest[:12]}"
+
+
+class Growth(NamedTuple):
+    """How the tokenizing time of a mutation grows with its repeat count.
+
+    Attributes:
+        n: The smaller repeat count measured
+        seconds: The time tokenizing the input at n
+        larger_seconds: The time tokenizing the input at 4 times n
+        exponent: The estimated growth exponent, 0 if it couldn't be measured
+        error: The regex engine error, e.g. a retry limit, if one was hit
+    """
+
+    n: int
+    seconds: float
+    larger_seconds: float
+    exponent: float
+    error: Optional[str] = None
+
+    def superlinear(self, threshold: float = THRESHOLD) -> bool:
+        """Get whether the time grows faster than the threshold exponent."""
+        return self.error is not None or self.exponent > threshold
+
+
+class Tokenizer:
+    """Tokenizes whole inputs with the bundled grammars, as highlighting does."""
+
+    def __init__(self) -> None:
+        from pyonig import api
+
+        self._grammars = api._grammars()
+
+    def seconds(self, language: str, text: str) -> float:
+        """Tokenize an input.
+
+        Args:
+            language: The language name or extension
+            text: The input
+
+        Returns:
+            The time taken
+
+        Raises:
+            Exception: What the tokenizer raised
+        """
+        from pyonig.api import LANG_TO_SCOPE
+        from pyonig.tm_tokenize.tokenize import tokenize
+
+        compiler = self._grammars.compiler_for_scope(LANG_TO_SCOPE[language])
+        state = compiler.root_state
+        began = time.perf_counter()
+        for i, line in enumerate(text.splitlines()):
+            state, _ = tokenize(compiler, state, f"{line}\n", i == 0)
+        return time.perf_counter() - began
+
+
+def measure(tokenizer: Tokenizer, mutation: Mutation) -> Growth:
+    """Estimate the growth exponent of a mutation.
+
+    The repeat count is doubled until the repeated part takes MIN_SECONDS,
+    and as long as the rest of the input, and the time without the unit is
+    taken off both times measured.  Each time is the best of 3.
+
+    Args:
+        tokenizer: The tokenizer
+        mutation: The mutation
+
+    Returns:
+        How its time grows
+
+    Raises:
+        Exception: What the tokenizer raised, other than a regex engine error
+    """
+    import pyonig
+
+    def best(n: int) -> float:
+        return min(tokenizer.seconds(mutation.language, mutation.text(n)) for _ in range(3))
+
+    try:
+        base = best(0)
+        floor = max(MIN_SECONDS, base)
+        n = max(1, 256 // max(len(mutation.unit), 1))
+        while True:
+            seconds = best(n)
+            if seconds - base >= floor or 4 * n * len(mutation.unit) > MAX_CHARS:
+                break
+            n *= 2
+        larger = best(4 * n)
+    except pyonig.OnigError as exc:
+        return Growth(0, 0.0, 0.0, 0.0, str(exc))
+    if seconds - base < floor:
+        # too fast to tell even at the largest size, linear at worst
+        return Growth(n, seconds, larger, 0.0)
+    exponent = math.log(max(larger - base, 1e-9) / (seconds - base), 4)
+    return Growth(n, seconds, larger, exponent)
+
+
+def mutate(rng: random.Random, language: str, seed: str) -> Mutation:
+    """Make a random mutation of a seed.
+
+    Args:
+        rng: The random generator
+        language: The extension of the seed sample
+        seed: The seed sample
+
+    Returns:
+        The mutation
+    """
+    pos = rng.randrange(len(seed) + 1)
+    kind = rng.random()
+    if kind < 0.6:
+        unit = rng.choice(_UNITS)
+    elif kind < 0.9:
+        # a fragment of the seed, within a line or across lines
+        start = rng.randrange(len(seed))
+        unit = seed[start:start + rng.randint(1, 40)]
+    else:
+        unit = "".join(rng.choice(_UNITS) for _ in range(rng.randint(2, 4)))
+    return Mutation(language, seed[:pos], unit, seed[pos:])
+
+
+def _shrink(text: str, keeps: Any) -> str:
+    """Remove chunks of text, halving the chunk size, while keeps() holds."""
+    chunk = max(len(text) // 2, 1)
+    while chunk >= 1:
+        i = 0
+        while i < len(text):
+            candidate = text[:i] + text[i + chunk:]
+            if keeps(candidate):
+                text = candidate
+            else:
+                i += chunk
+        if chunk == 1:
+            break
+        chunk //= 2
+    return text
+
+
+def minimize(tokenizer: Tokenizer, mutation: Mutation, threshold: float = THRESHOLD) -> Mutation:
+    """Shrink a superlinear mutation while it stays superlinear.
+
+    The unit is shrunk first, then the prefix by whole lines from its start
+    and the suffix by whole lines from its end.
+
+    Args:
+        tokenizer: The tokenizer
+        mutation: The mutation
+        threshold: The growth exponent above which it is superlinear
+
+    Returns:
+        The minimized mutation
+    """
+    def keeps(candidate: Mutation) -> bool:
+        if not candidate.unit:
+            return False
+        try:
+            return measure(tokenizer, candidate).superlinear(threshold)
+        except Exception:  # noqa: BLE001
+            return False
+
+    unit = _shrink(mutation.unit, lambda u: keeps(mutation._replace(unit=u)))
+    mutation = mutation._replace(unit=unit)
+
+    lines = mutation.prefix.splitlines(keepends=True)
+    while lines and keeps(mutation._replace(prefix="".join(lines[len(lines) // 2:]))) and len(lines) > 1:
+        lines = lines[len(lines) // 2:]
+    while lines and keeps(mutation._replace(prefix="".join(lines[1:]))):
+        lines = lines[1:]
+    mutation = mutation._replace(prefix="".join(lines))
+
+    lines = mutation.suffix.splitlines(keepends=True)
+    while len(lines) > 1 and keeps(mutation._replace(suffix="".join(lines[:len(lines) // 2]))):
+        lines = lines[:len(lines) // 2]
+    while lines and keeps(mutation._replace(suffix="".join(lines[:-1]))):
+        lines = lines[:-1]
+    return mutation._replace(suffix="".join(lines))
+
+
+def save(mutation: Mutation, growth: Growth, corpus: Path = CORPUS_DIR) -> Path:
+    """Save a mutation to the corpus.
+
+    Args:
+        mutation: The mutation
+        growth: How its time grew when found
+        corpus: The corpus directory
+
+    Returns:
+        The corpus file
+    """
+    path = corpus / f"{mutation.name}.json"
+    corpus.mkdir(parents=True, exist_ok=True)
+    entry = {**mutation._asdict(), "found": growth._asdict()}
+    path.write_text(json.dumps(entry, indent=2) + "\n", encoding="utf-8")
+    return path
+
+
+def load(path: Path) -> Mutation:
+    """Load a mutation from a corpus file."""
+    entry = json.loads(path.read_text(encoding="utf-8"))
+    return Mutation(*(entry[field] for field in Mutation._fields))
+
+
+def load_growths(path: Path) -> tuple[Growth, Optional[Growth]]:
+    """Load how a corpus entry grew.
+
+    Args:
+        path: The corpus file
+
+    Returns:
+        Its growth when found, and when recorded as fixed or None while open
+    """
+    entry = json.loads(path.read_text(encoding="utf-8"))
+    fixed = entry.get("fixed")
+    return Growth(**entry["found"]), None if fixed is None else Growth(**fixed)
+
+
+def mark_fixed(path: Path, growth: Growth) -> None:
+    """Record a corpus entry as fixed, with its growth now."""
+    entry = json.loads(path.read_text(encoding="utf-8"))
+    entry["fixed"] = growth._asdict()
+    path.write_text(json.dumps(entry, indent=2) + "\n", encoding="utf-8")
+
+
+def verdict(growth: Growth, found: Growth, fixed: Optional[Growth], threshold: float = THRESHOLD) -> str:
+    """Judge a corpus entry measured again.
+
+    Args:
+        growth: Its growth now
+        found: Its growth when found
+        fixed: Its growth when recorded as fixed, None while open
+        threshold: The growth exponent above which an input is superlinear
+
+    Returns:
+        ``regressed`` for a fixed entry superlinear again, ``grew`` for an
+        open entry growing faster than when found, both failures, ``open``
+        for an open entry as superlinear as when found, ``linear`` for an
+        open entry no longer superlinear, and ``ok`` for a fixed one
+    """
+    if fixed is not None:
+        return "regressed" if growth.superlinear(threshold) else "ok"
+    if not growth.superlinear(threshold):
+        return "linear"
+    if growth.error is not None and found.error is None:
+        return "grew"
+    if growth.error is None and growth.exponent > found.exponent + EXPONENT_SLACK:
+        return "grew"
+    return "open"
+
+
+def languages() -> list[str]:
+    """Get the languages with a demo sample, by file extension."""
+    from pyonig.api import LANG_TO_SCOPE
+
+    return sorted(
+        path.suffix[1:]
+        for path in DEMO_DIR.glob("sample.*")
+        if path.suffix[1:] in LANG_TO_SCOPE
+    )
+
+
+def usable_seed(tokenizer: Tokenizer, language: str) -> str:
+    """Get a language's demo sample, cut before any line the tokenizer fails on.
+
+    Args:
+        tokenizer: The tokenizer
+        language: The extension of the sample
+
+    Returns:
+        The seed
+    """
+    lines = (DEMO_DIR / f"sample.{language}").read_text(encoding="utf-8").splitlines(keepends=True)
+    good, bad = 0, len(lines) + 1
+    # bisect for the longest prefix of lines that tokenizes
+    while bad - good > 1:
+        mid = (good + bad) // 2
+        try:
+            tokenizer.seconds(language, "".join(lines[:mid]))
+        except Exception:  # noqa: BLE001
+            bad = mid
+        else:
+            good = mid
+    return "".join(lines[:good])
+
+
+def fuzz(
+    language: str,
+    iterations: int,
+    rng: random.Random,
+    threshold: float = THRESHOLD,
+    corpus: Path = CORPUS_DIR,
+) -> list[Path]:
+    """Fuzz a grammar from its demo sample.
+
+    Args:
+        language: The extension of the sample
+        iterations: The number of mutations to try
+        rng: The random generator
+        threshold: The growth exponent above which an input is superlinear
+        corpus: The corpus directory findings are saved to
+
+    Returns:
+        The corpus files of the findings
+    """
+    tokenizer = Tokenizer()
+    seed = usable_seed(tokenizer, language)
+    found = []
+    for _ in range(iterations):
+        mutation = mutate(rng, language, seed)
+        try:
+            if not measure(tokenizer, mutation).superlinear(threshold):
+                continue
+        except Exception:  # noqa: BLE001
+            # a tokenizer failure, not a performance problem
+            continue
+        mutation = minimize(tokenizer, mutation, threshold)
+        growth = measure(tokenizer, mutation)
+        if growth.superlinear(threshold):
+            path = save(mutation, growth, corpus)
+            print(f"{path.name}: x^{growth.exponent:.2f} unit {mutation.unit!r}", flush=True)
+            found.append(path)
+    return found
+
+
+def check(
+    paths: list[Path],
+    threshold: float = THRESHOLD,
+    tokenizer: Optional[Tokenizer] = None,
+    record_fixed: bool = False,
+) -> list[tuple[Path, Growth]]:
+    """Measure corpus entries again.
+
+    Args:
+        paths: The corpus files
+        threshold: The growth exponent above which an input is superlinear
+        tokenizer: The tokenizer, one for the bundled grammars if None
+        record_fixed: Record the open entries measuring linear as fixed
+
+    Returns:
+        The entries failing, fixed ones superlinear again and open ones
+        growing faster than when found, with their growth
+    """
+    tokenizer = tokenizer or Tokenizer()
+    failed = []
+    for path in paths:
+        growth = measure(tokenizer, load(path))
+        status = verdict(growth, *load_growths(path), threshold)
+        if status == "linear" and record_fixed:
+            mark_fixed(path, growth)
+            status = "fixed"
+        print(f"{path.name:<30} x^{growth.exponent:5.2f}  {status}", flush=True)
+        if status in ("regressed", "grew"):
+            failed.append((path, growth))
+    return failed
+
+
+def main(argv: Optional[list[str]] = None) -> int:
+    """Run the fuzzer, or check the corpus."""
+    parser = argparse.ArgumentParser(description="Hunt for inputs the tokenizer handles superlinearly")
+    parser.add_argument("--language", action="append", help="Fuzz some demo samples, by extension, all by default")
+    parser.add_argument("--iterations", type=int, default=100, help="Mutations per language (default: %(default)s)")
+    parser.add_argument("--seed", type=int, help="Random seed, for reproducible runs")
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=THRESHOLD,
+        help="Growth exponent above which an input is superlinear (default: %(default)s)",
+    )
+    parser.add_argument("--corpus", type=Path, default=CORPUS_DIR, help="Corpus directory (default: benchmarks/corpus)")
+    parser.add_argument(
+        "--check",
+        action="store_true",
+        help="Measure the corpus again, fail if a fixed entry regressed or an open one grew",
+    )
+    parser.add_argument(
+        "--mark-fixed",
+        action="store_true",
+        help="With --check, record the open entries measuring linear as fixed",
+    )
+    args = parser.parse_args(argv)
+
+    if args.check:
+        paths = sorted(
+            path for path in args.corpus.glob("*.json")
+            if not args.language or load(path).language in args.language
+        )
+        return 1 if check(paths, args.threshold, record_fixed=args.mark_fixed) else 0
+
+    rng = random.Random(args.seed)
+    found = []
+    for language in args.language or languages():
+        found += fuzz(language, args.iterations, rng, args.threshold, args.corpus)
+    print(f"{len(found)} superlinear inputs saved to {args.corpus}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
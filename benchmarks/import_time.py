@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""Import and startup time benchmark for pyonig.
+
+Times, in fresh interpreters, what regex-only users and short CLI runs pay
+before doing any work:
+
+- ``import`` - ``import pyonig``
+- ``compile`` - importing pyonig and searching with a compiled pattern
+- ``highlight`` - importing pyonig and highlighting a JSON snippet
+- ``cli-version`` - ``po --version``
+- ``cli-highlight`` - ``po -l json`` on a JSON snippet from stdin
+
+Each case is timed as the best wall time of its process, less the best
+time of a bare interpreter, so only pyonig's share is reported.  A run
+under ``-X importtime`` lists the modules the case loads and the slowest
+of them.  Each case also lists modules it must not load, the highlighting
+stack for the regex API and the CLI's list commands, ``curses`` and
+``asyncio`` everywhere.  The run fails when one is loaded, so an eager
+import regressing the startup time fails like a test.
+
+Usage::
+
+    python benchmarks/import_time.py --output import_time.json
+    python benchmarks/import_time.py --case import --case cli-version --repeat 20
+"""
+from __future__ import annotations
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+from pathlib import Path
+from typing import Any
+from typing import NamedTuple
+from typing import Optional
+
+
+#: Modules only the highlighting stack imports
+HIGHLIGHTING = ("pyonig.api", "pyonig.colorize", "pyonig.tm_tokenize")
+
+#: Modules no case needs
+NEVER = ("curses", "asyncio")
+
+_SNIPPET = '{"name": "pyonig", "tags": ["regex", "textmate"], "size": 1}\n'
+
+
+class Case(NamedTuple):
+    """A startup to time.
+
+    Attributes:
+        name: The name of the case
+        args: The interpreter arguments
+        stdin: The input of the process
+        forbidden: The modules the case must not load, with their submodules
+    """
+
+    name: str
+    args: tuple[str, ...]
+    stdin: str
+    forbidden: tuple[str, ...]
+
+
+CASES = {
+    case.name: case
+    for case in (
+        Case("import", ("-c", "import pyonig"), "", HIGHLIGHTING + NEVER),
+        Case(
+            "compile",
+            ("-c", "import pyonig; pyonig.compile(r'\\d+').search('abc 123', 0)"),
+            "",
+            HIGHLIGHTING + NEVER,
+        ),
+        Case(
+            "highlight",
+            ("-c", f"import pyonig; pyonig.highlight({_SNIPPET!r}, language='json', cache=False)"),
+            "",
+            NEVER,
+        ),
+        Case("cli-version", ("-m", "pyonig.cli", "--version"), "", HIGHLIGHTING + NEVER),
+        Case("cli-highlight", ("-m", "pyonig.cli", "-l", "json"), _SNIPPET, NEVER),
+    )
+}
+
+#: The slowest modules listed per case
+TOP_MODULES = 10
+
+
+class Startup(NamedTuple):
+    """The startup cost of a case.
+
+    Attributes:
+        case: The name of the case
+        seconds: The best wall time, less a bare interpreter's
+        modules: The number of modules imported beyond a bare interpreter
+        top: The slowest modules and their cumulative import microseconds
+        forbidden: The forbidden packages the case loaded
+    """
+
+    case: str
+    seconds: float
+    modules: int
+    top: list[tuple[str, int]]
+    forbidden: list[str]
+
+
+def _env() -> dict[str, str]:
+    """Get the environment of the children, importing this pyonig."""
+    import pyonig
+
+    env = dict(os.environ)
+    root = str(Path(pyonig.__file__).resolve().parent.parent)
+    env["PYTHONPATH"] = os.pathsep.join(filter(None, (root, env.get("PYTHONPATH"))))
+    return env
+
+
+def _run(args: tuple[str, ...], stdin: str, env: dict[str, str]) -> subprocess.CompletedProcess[str]:
+    return subprocess.run(
+        [sys.executable, *args],
+        input=stdin,
+        capture_output=True,
+        text=True,
+        env=env,
+        check=True,
+    )
+
+
+def wall_time(args: tuple[str, ...], stdin: str = "", repeat: int = 10) -> float:
+    """Get the best wall time of an interpreter run.
+
+    Args:
+        args: The interpreter arguments
+        stdin: The input of the process
+        repeat: The number of runs, the best is kept
+
+    Returns:
+        The best time in seconds
+    """
+    env = _env()
+    best = float("inf")
+    for _ in range(repeat):
+        began = time.perf_counter()
+        _run(args, stdin, env)
+        best = min(best, time.perf_counter() - began)
+    return best
+
+
+def import_times(args: tuple[str, ...], stdin: str = "") -> dict[str, int]:
+    """Get the modules an interpreter run imports.
+
+    Args:
+        args: The interpreter arguments
+        stdin: The input of the process
+
+    Returns:
+        The cumulative import microseconds of each module
+    """
+    proc = _run(("-X", "importtime", *args), stdin, _env())
+    found = {}
+    for line in proc.stderr.splitlines():
+        # import time: self [us] | cumulative | imported package
+        if not line.startswith("import time:"):
+            continue
+        _, cumulative, name = line[len("import time:"):].split("|")
+        if cumulative.strip().isdigit():
+            found[name.strip()] = int(cumulative)
+    return found
+
+
+def _is_under(module: str, package: str) -> bool:
+    return module == package or module.startswith(package + ".")
+
+
+def measure(case: Case, repeat: int = 10) -> Startup:
+    """Measure the startup cost of a case.
+
+    Args:
+        case: The case
+        repeat: The number of timed runs, the best is kept
+
+    Returns:
+        The startup cost
+    """
+    bare = ("-c", "pass")
+    baseline = import_times(bare)
+    modules = import_times(case.args, case.stdin)
+    own = {name: us for name, us in modules.items() if name not in baseline}
+    top = sorted(own.items(), key=lambda item: -item[1])[:TOP_MODULES]
+    forbidden = [package for package in case.forbidden if any(_is_under(name, package) for name in own)]
+    seconds = wall_time(case.args, case.stdin, repeat) - wall_time(bare, "", repeat)
+    return Startup(case.name, max(seconds, 0.0), len(own), top, forbidden)
+
+
+def main(argv: Optional[list[str]] = None) -> int:
+    """Run the benchmark."""
+    parser = argparse.ArgumentParser(description="Time pyonig's import and CLI startup")
+    parser.add_argument("--case", action="append", choices=list(CASES), help="Only run some cases, all by default")
+    parser.add_argument("--repeat", type=int, default=10, help="Timed runs, the best is kept (default: %(default)s)")
+    parser.add_argument("-o", "--output", help="Write the results as JSON")
+    args = parser.parse_args(argv)
+
+    results = []
+    for name in args.case or CASES:
+        startup = measure(CASES[name], args.repeat)
+        results.append(startup)
+        slowest = ", ".join(f"{module} {us / 1000:.1f}" for module, us in startup.top[:3])
+        print(f"{name:<14} {startup.seconds * 1000:7.1f} ms {startup.modules:>4} modules  slowest: {slowest}")
+        if startup.forbidden:
+            print(f"    loads {', '.join(startup.forbidden)}")
+
+    if args.output:
+        import pyonig
+
+        data: dict[str, Any] = {
+            "pyonig": pyonig.__version__,
+            "python": platform.python_version(),
+            "platform": platform.platform(),
+            "results": [startup._asdict() for startup in results],
+        }
+        Path(args.output).write_text(json.dumps(data, indent=2) + "\n", encoding="utf-8")
+    return 1 if any(startup.forbidden for startup in results) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,355 @@
+#!/usr/bin/env python3
+"""Memory footprint benchmark for pyonig.
+
+Measures the resident and Python heap cost of importing pyonig, loading each
+bundled grammar, compiling its full rule graph, loading each theme, and
+highlighting inputs of 1 MB, 10 MB and 100 MB per language built from the
+``demo/sample.*`` files.  Each case runs in fresh interpreters so earlier
+cases don't hide its cost, once for the resident set and once under
+tracemalloc for the Python heap, as tracing inflates the resident set.
+Results are written as JSON.
+
+With ``--budgets``, each case is checked against its budget and the run
+fails when one is exceeded, so memory regressions in ``tm_tokenize``,
+``colorize`` and the C extension fail like test regressions.
+
+Usage::
+
+    python benchmarks/memory.py --output memory.json
+    python benchmarks/memory.py --sizes 1 --budgets benchmarks/memory_budgets.json
+    python benchmarks/memory.py --sizes 1 --update-budgets benchmarks/memory_budgets.json
+"""
+from __future__ import annotations
+
+import argparse
+import gc
+import json
+import os
+import platform
+import resource
+import subprocess
+import sys
+import time
+import tracemalloc
+
+from pathlib import Path
+from typing import Any
+from typing import Optional
+
+
+DEMO_DIR = Path(__file__).resolve().parent.parent / "demo"
+
+#: Input sizes to highlight, in MB of 1,000,000 bytes
+SIZES = (1, 10, 100)
+
+#: Headroom over the measured cost given by --update-budgets
+BUDGET_HEADROOM = 1.25
+
+# Slack added to budgets, as the resident set grows by pages and arenas
+_BUDGET_SLACK = {"rss_bytes": 1 << 20, "heap_bytes": 64 << 10}
+
+# Measurements each budget entry can limit, by case kind
+_BUDGETED = {
+    "import": ("rss_bytes", "heap_bytes"),
+    "grammar": ("rss_bytes", "heap_bytes"),
+    "compile": ("rss_bytes", "heap_bytes"),
+    "theme": ("rss_bytes", "heap_bytes"),
+    "highlight": ("bytes_per_token", "bytes_per_line"),
+}
+
+
+def _rss() -> int:
+    """Get the resident set size of this process in bytes."""
+    try:
+        with open("/proc/self/statm", encoding="ascii") as f:
+            return int(f.read().split()[1]) * os.sysconf("SC_PAGE_SIZE")
+    except OSError:
+        return _max_rss()
+
+
+def _max_rss() -> int:
+    """Get the peak resident set size of this process in bytes."""
+    peak = resource.getrusage(resource.RUSAGE_SELF).ru_maxrss
+    # kilobytes on Linux, bytes on macOS
+    return peak if sys.platform == "darwin" else peak * 1024
+
+
+def languages() -> list[str]:
+    """Get the languages with a demo sample, by file extension."""
+    from pyonig.api import LANG_TO_SCOPE
+
+    return sorted(
+        path.suffix[1:]
+        for path in DEMO_DIR.glob("sample.*")
+        if path.suffix[1:] in LANG_TO_SCOPE
+    )
+
+
+def scopes() -> list[str]:
+    """Get the scopes of the bundled grammars."""
+    from pyonig.api import LANG_TO_SCOPE
+
+    return sorted(set(LANG_TO_SCOPE.values()))
+
+
+def themes() -> list[str]:
+    """Get the names of the bundled themes."""
+    from pyonig.theme import ThemeManager
+
+    return [name for name, _ in ThemeManager().list_themes()]
+
+
+def make_input(language: str, size: int) -> str:
+    """Repeat a language's demo sample up to a size, ending on a full line.
+
+    Args:
+        language: The extension of the sample
+        size: The size in bytes
+
+    Returns:
+        The input
+    """
+    sample = (DEMO_DIR / f"sample.{language}").read_text(encoding="utf-8")
+    if not sample.endswith("\n"):
+        sample += "\n"
+    text = sample * (size // len(sample.encode("utf-8")) + 1)
+    cut = text.rfind("\n", 0, size)
+    return text[: cut + 1]
+
+
+def _setup(kind: str, args: list[str]) -> Any:
+    """Do the work a case is measured after, e.g. importing pyonig."""
+    import pyonig
+    # import pyonig is lazy, so load the highlighting stack, and the pool
+    # warmup() starts, outside the measured work
+    import concurrent.futures.thread  # noqa: F401
+
+    import pyonig.api  # noqa: F401
+
+    if kind == "highlight":
+        language = args[0]
+        # warm the grammar and colorizer so only highlighting is measured
+        pyonig.warmup([language], max_workers=1)
+        pyonig.highlight(make_input(language, 4096), language=language, output="simple", cache=False)
+        return make_input(language, int(args[1]) * 1_000_000)
+    return None
+
+
+def _run(kind: str, args: list[str], prepared: Any) -> tuple[Any, dict[str, Any]]:
+    """Do the measured work of a case.
+
+    Returns:
+        What the case keeps alive while measured, and its details
+    """
+    if kind == "import":
+        import pyonig
+
+        return pyonig, {}
+
+    from pyonig import api
+
+    if kind == "grammar":
+        grammars = api._grammars()
+        return (grammars, grammars.grammar_for_scope(args[0])), {}
+    if kind == "compile":
+        grammars = api._grammars()
+        compiled = grammars.warmup([args[0]], max_workers=1)
+        return grammars, {"regexes": compiled}
+    if kind == "theme":
+        return api._colorizer(args[0]), {}
+    if kind == "highlight":
+        lines = api.highlight(prepared, language=args[0], output="simple", cache=False)
+        tokens = sum(len(line) for line in lines)
+        return lines, {"input_bytes": len(prepared.encode("utf-8")), "lines": len(lines), "tokens": tokens}
+    raise ValueError(f"Unknown case: {kind}")
+
+
+def measure(case: str, heap: bool) -> dict[str, Any]:
+    """Measure one case in this process.
+
+    Args:
+        case: The case, ``import``, ``grammar:<scope>``, ``compile:<scope>``,
+            ``theme:<name>`` or ``highlight:<language>:<MB>``
+        heap: Measure the Python heap under tracemalloc, what is still
+            allocated after the case and the peak while it ran, rather than
+            the growth of the resident set and its peak
+
+    Returns:
+        The measurements
+    """
+    kind, *args = case.split(":")
+    prepared = _setup(kind, args) if kind != "import" else None
+    gc.collect()
+    rss_before = _rss()
+    if heap:
+        tracemalloc.start()
+    began = time.perf_counter()
+    kept, details = _run(kind, args, prepared)
+    seconds = time.perf_counter() - began
+    gc.collect()
+    if heap:
+        allocated, peak = tracemalloc.get_traced_memory()
+        tracemalloc.stop()
+        measured = {"heap_bytes": allocated, "heap_peak_bytes": peak}
+    else:
+        measured = {
+            "seconds": seconds,
+            "rss_bytes": max(_rss() - rss_before, 0),
+            "rss_peak_bytes": max(_max_rss() - rss_before, 0),
+        }
+    del kept
+    return {"case": case, **measured, **details}
+
+
+def cases(sizes: tuple[int, ...], only: Optional[list[str]] = None) -> list[str]:
+    """Get the cases to measure.
+
+    Args:
+        sizes: The input sizes to highlight, in MB
+        only: Limit to cases of these kinds, or starting with these names
+
+    Returns:
+        The cases, cheapest kinds first
+    """
+    found = ["import"]
+    found += [f"grammar:{scope}" for scope in scopes()]
+    found += [f"compile:{scope}" for scope in scopes()]
+    found += [f"theme:{name}" for name in themes()]
+    found += [f"highlight:{language}:{size}" for size in sizes for language in languages()]
+    if only:
+        found = [case for case in found if any(case == o or case.startswith(f"{o}:") for o in only)]
+    return found
+
+
+def run_case(case: str) -> dict[str, Any]:
+    """Measure a case in fresh interpreters, the resident set then the heap."""
+    result: dict[str, Any] = {}
+    for mode in ("rss", "heap"):
+        proc = subprocess.run(
+            [sys.executable, __file__, "--case", case, "--measure", mode],
+            capture_output=True,
+            text=True,
+            check=False,
+        )
+        if proc.returncode:
+            return {"case": case, "error": proc.stderr.strip().splitlines()[-1:]}
+        result.update(json.loads(proc.stdout))
+    if "tokens" in result:
+        result["bytes_per_token"] = result["heap_peak_bytes"] / max(result["tokens"], 1)
+        result["bytes_per_line"] = result["heap_peak_bytes"] / max(result["lines"], 1)
+    return result
+
+
+def _budget_key(result: dict[str, Any]) -> str:
+    # bytes per token and line are budgeted per language, whatever the size
+    kind, *args = result["case"].split(":")
+    return f"{kind}:{args[0]}" if kind == "highlight" else result["case"]
+
+
+def check_budgets(results: list[dict[str, Any]], budgets: dict[str, dict[str, float]]) -> list[str]:
+    """Compare results with their budgets.
+
+    Args:
+        results: The measurements
+        budgets: The limit of each measurement, by case
+
+    Returns:
+        A message per measurement over its budget
+    """
+    over = []
+    for result in results:
+        budget = budgets.get(_budget_key(result), {})
+        for name, limit in budget.items():
+            value = result.get(name)
+            if value is not None and value > limit:
+                over.append(f"{result['case']}: {name} {value:,.0f} over budget {limit:,.0f}")
+    return over
+
+
+def make_budgets(results: list[dict[str, Any]]) -> dict[str, dict[str, int]]:
+    """Make budgets with headroom over the measured cost of each case."""
+    budgets: dict[str, dict[str, int]] = {}
+    for result in results:
+        if "error" in result:
+            continue
+        kind = result["case"].split(":")[0]
+        budget = budgets.setdefault(_budget_key(result), {})
+        for name in _BUDGETED[kind]:
+            limit = int(result[name] * BUDGET_HEADROOM) + _BUDGET_SLACK.get(name, 1)
+            budget[name] = max(budget.get(name, 0), limit)
+    return budgets
+
+
+def _format(result: dict[str, Any]) -> str:
+    if "error" in result:
+        return f"{result['case']:<40} error: {' '.join(result['error'])}"
+    line = (
+        f"{result['case']:<40} rss {result['rss_bytes'] / 1e6:9.2f} MB"
+        f"  heap {result['heap_bytes'] / 1e6:9.2f} MB"
+        f"  peak {result['heap_peak_bytes'] / 1e6:9.2f} MB"
+    )
+    if "bytes_per_token" in result:
+        line += (
+            f"  rss peak {result['rss_peak_bytes'] / 1e6:9.2f} MB"
+            f"  {result['bytes_per_token']:8.1f} B/token  {result['bytes_per_line']:9.1f} B/line"
+        )
+    return line
+
+
+def main(argv: Optional[list[str]] = None) -> int:
+    """Run the benchmark."""
+    parser = argparse.ArgumentParser(description="Measure the memory footprint of pyonig")
+    parser.add_argument("--case", help=argparse.SUPPRESS)
+    parser.add_argument("--measure", choices=("rss", "heap"), default="rss", help=argparse.SUPPRESS)
+    parser.add_argument(
+        "--sizes",
+        default=",".join(str(size) for size in SIZES),
+        help="Comma separated input sizes to highlight, in MB (default: %(default)s)",
+    )
+    parser.add_argument(
+        "--only",
+        action="append",
+        help="Only measure cases of a kind or name, e.g. import, grammar or highlight:python",
+    )
+    parser.add_argument("-o", "--output", help="Write the results as JSON")
+    parser.add_argument("--budgets", help="Fail if a case is over its budget in this JSON file")
+    parser.add_argument("--update-budgets", metavar="PATH", help="Write budgets from this run")
+    args = parser.parse_args(argv)
+
+    if args.case:
+        print(json.dumps(measure(args.case, heap=args.measure == "heap")))
+        return 0
+
+    sizes = tuple(int(size) for size in args.sizes.split(",") if size)
+    results = []
+    for case in cases(sizes, args.only):
+        result = run_case(case)
+        print(_format(result), flush=True)
+        results.append(result)
+
+    import pyonig
+
+    report = {
+        "pyonig": pyonig.__version__,
+        "oniguruma": pyonig.__onig_version__,
+        "python": platform.python_version(),
+        "platform": platform.platform(),
+        "results": results,
+    }
+    if args.output:
+        Path(args.output).write_text(json.dumps(report, indent=2) + "\n", encoding="utf-8")
+    if args.update_budgets:
+        budgets = make_budgets(results)
+        Path(args.update_budgets).write_text(json.dumps(budgets, indent=2, sort_keys=True) + "\n", encoding="utf-8")
+
+    failed = [result["case"] for result in results if "error" in result]
+    over = check_budgets(results, json.loads(Path(args.budgets).read_text(encoding="utf-8"))) if args.budgets else []
+    for message in over:
+        print(f"OVER BUDGET {message}", file=sys.stderr)
+    for case in failed:
+        print(f"FAILED {case}", file=sys.stderr)
+    return 1 if over or failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+"""Native benchmark of the regex core, next to the same searches from Python.
+
+Builds ``native/onig_bench.c`` against the Oniguruma sources the extension
+is built from, ``onig_sources`` in ``setup.py``, and runs the bundled
+grammars' patterns and regsets on the ``demo/sample.*`` lines straight
+through ``onig_search()`` and ``onig_regset_search()``.  The same searches
+are then made through ``_Pattern.search`` and ``_RegSet.search``, on bytes
+subjects searched in place and on str subjects, so the gap per call is the
+cost of the binding and the Python loop around it.
+
+Usage::
+
+    (cd deps/oniguruma && autoreconf -vfi && ./configure --disable-shared --enable-static)
+    python benchmarks/native.py --output native.json
+
+    # or against an installed Oniguruma
+    python benchmarks/native.py --onig-include /usr/include --onig-lib /usr/lib/libonig.so
+"""
+from __future__ import annotations
+
+import argparse
+import ast
+import json
+import os
+import platform
+import shlex
+import subprocess
+import sys
+import sysconfig
+import tempfile
+import time
+
+from collections.abc import Callable
+from pathlib import Path
+from typing import Any
+from typing import NamedTuple
+from typing import Optional
+
+
+ROOT = Path(__file__).resolve().parent.parent
+BENCH_SOURCE = Path(__file__).resolve().parent / "native" / "onig_bench.c"
+BUILD_DIR = ROOT / "build" / "native-bench"
+
+sys.path.insert(0, str(Path(__file__).resolve().parent))
+
+from parity import Workload  # noqa: E402
+from parity import workloads  # noqa: E402
+
+
+class Timing(NamedTuple):
+    """The time an operation takes natively and from Python.
+
+    Attributes:
+        op: The operation, ``search`` or ``regset``
+        calls: The number of searches
+        matches: The number of searches that matched natively
+        native_ns: The native time per search in nanoseconds
+        bytes_ns: The time per search from Python on bytes subjects
+        str_ns: The time per search from Python on str subjects
+    """
+
+    op: str
+    calls: int
+    matches: int
+    native_ns: float
+    bytes_ns: float
+    str_ns: float
+
+    @property
+    def overhead_ns(self) -> float:
+        """Get the binding overhead per search on bytes subjects."""
+        return self.bytes_ns - self.native_ns
+
+
+def onig_sources(setup_py: Path = ROOT / "setup.py") -> tuple[str, list[str]]:
+    """Get the Oniguruma source directory and sources the extension is built from.
+
+    ``setup.py`` builds the extension when run, so its ``onig_src_dir`` and
+    ``onig_sources`` are read from its syntax tree.
+
+    Args:
+        setup_py: The setup script
+
+    Returns:
+        The source directory and the sources, relative to the repository
+    """
+    tree = ast.parse(setup_py.read_text(encoding="utf-8"))
+    values: dict[str, ast.expr] = {}
+    for node in tree.body:
+        if isinstance(node, ast.Assign) and len(node.targets) == 1 and isinstance(node.targets[0], ast.Name):
+            values[node.targets[0].id] = node.value
+    src_dir = ast.literal_eval(values["onig_src_dir"])
+    sources = values["onig_sources"]
+    # [os.path.join(onig_src_dir, f) for f in [...]]
+    assert isinstance(sources, ast.ListComp)
+    names = ast.literal_eval(sources.generators[0].iter)
+    return src_dir, [os.path.join(src_dir, name) for name in names]
+
+
+def build(onig_include: Optional[str] = None, onig_lib: Optional[str] = None) -> Path:
+    """Build the native benchmark.
+
+    Args:
+        onig_include: The directory of an installed oniguruma.h, None to
+            build the Oniguruma sources of setup.py
+        onig_lib: The installed Oniguruma library to link with
+
+    Returns:
+        The benchmark executable
+    """
+    BUILD_DIR.mkdir(parents=True, exist_ok=True)
+    binary = BUILD_DIR / "onig_bench"
+    # the optimization flags Python extensions are built with
+    opt = shlex.split(sysconfig.get_config_var("OPT") or "-O2")
+    cc = shlex.split(os.environ.get("CC") or sysconfig.get_config_var("CC") or "cc")
+    if onig_include is not None:
+        sources = [str(BENCH_SOURCE), onig_lib or "-lonig"]
+        flags = [f"-I{onig_include}"]
+    else:
+        src_dir, onig = onig_sources()
+        if not (ROOT / src_dir / "config.h").exists():
+            raise RuntimeError(
+                f"{src_dir}/config.h not found, configure Oniguruma first:\n"
+                "  cd deps/oniguruma && autoreconf -vfi && ./configure --disable-shared --enable-static"
+            )
+        sources = [str(BENCH_SOURCE), *(str(ROOT / source) for source in onig)]
+        flags = [f"-I{ROOT / src_dir}", "-DHAVE_CONFIG_H"]
+    subprocess.run([*cc, *opt, *flags, *sources, "-o", str(binary)], check=True)
+    return binary
+
+
+def _compiled_patterns(work: Workload) -> list[str]:
+    """Get a workload's patterns that compile, as the binding would raise on the others."""
+    import pyonig
+
+    valid = []
+    for pattern in work.patterns:
+        try:
+            pyonig.compile(pattern)
+        except pyonig.OnigError:
+            continue
+        valid.append(pattern)
+    return valid
+
+
+def write_workload(work: list[Workload], path: Path) -> None:
+    """Write workloads for the native benchmark.
+
+    Args:
+        work: The workloads
+        path: The workload file
+    """
+    with path.open("wb") as f:
+        for w in work:
+            f.write(f"grammar {w.scope}\n".encode())
+            patterns = _compiled_patterns(w)
+            index = {pattern: i for i, pattern in enumerate(patterns)}
+            for pattern in patterns:
+                data = pattern.encode("utf-8")
+                f.write(b"pattern %d\n%s\n" % (len(data), data))
+            for regset in w.regsets:
+                if all(pattern in index for pattern in regset):
+                    f.write(f"regset {len(regset)} {' '.join(str(index[p]) for p in regset)}\n".encode())
+            for line in w.lines:
+                data = line.encode("utf-8")
+                f.write(b"line %d\n%s\n" % (len(data), data))
+
+
+def run_native(binary: Path, workload: Path, repeat: int) -> dict[str, tuple[int, int, int]]:
+    """Run the native benchmark.
+
+    Returns:
+        The calls, best nanoseconds and matches of each operation
+    """
+    out = subprocess.run([str(binary), str(workload), str(repeat)], capture_output=True, text=True, check=True)
+    results = {}
+    for line in out.stdout.splitlines():
+        op, calls, ns, matches = line.split()
+        results[op] = (int(calls), int(ns), int(matches))
+    return results
+
+
+def _python_runs(work: list[Workload], as_bytes: bool) -> dict[str, Callable[[], tuple[int, int]]]:
+    """Make the searches of the native benchmark through the binding."""
+    import pyonig
+
+    compiled = []
+    for w in work:
+        patterns = _compiled_patterns(w)
+        valid = set(patterns)
+        regexes = [pyonig.compile(pattern) for pattern in patterns]
+        regsets = [pyonig.compile_regset(*r) for r in w.regsets if all(p in valid for p in r)]
+        lines = [line.encode("utf-8") for line in w.lines] if as_bytes else list(w.lines)
+        compiled.append((regexes, regsets, lines))
+
+    def search() -> tuple[int, int]:
+        calls = matches = 0
+        for regexes, _, lines in compiled:
+            for regex in regexes:
+                find = regex.search
+                for line in lines:
+                    matches += find(line, 0) is not None
+                calls += len(lines)
+        return calls, matches
+
+    def regset() -> tuple[int, int]:
+        calls = matches = 0
+        for _, regsets, lines in compiled:
+            for rs in regsets:
+                find = rs.search
+                for line in lines:
+                    matches += find(line, 0)[0] >= 0
+                calls += len(lines)
+        return calls, matches
+
+    return {"search": search, "regset": regset}
+
+
+def _best_ns(run: Callable[[], tuple[int, int]], repeat: int) -> int:
+    best = None
+    for _ in range(repeat):
+        began = time.perf_counter_ns()
+        run()
+        elapsed = time.perf_counter_ns() - began
+        best = elapsed if best is None else min(best, elapsed)
+    return best or 0
+
+
+def compare(binary: Path, work: list[Workload], repeat: int = 3) -> list[Timing]:
+    """Time the searches natively and through the binding.
+
+    Args:
+        binary: The native benchmark
+        work: The workloads
+        repeat: The number of timed runs, the best is kept
+
+    Returns:
+        The timing of each operation
+    """
+    with tempfile.TemporaryDirectory() as tmp:
+        workload = Path(tmp) / "workload"
+        write_workload(work, workload)
+        native = run_native(binary, workload, repeat)
+    on_bytes = _python_runs(work, as_bytes=True)
+    on_str = _python_runs(work, as_bytes=False)
+    timings = []
+    for op, (calls, ns, matches) in native.items():
+        python_calls, python_matches = on_bytes[op]()
+        if (python_calls, python_matches) != (calls, matches):
+            raise RuntimeError(
+                f"{op}: {python_calls} calls and {python_matches} matches from Python, "
+                f"{calls} and {matches} natively"
+            )
+        per_call = max(calls, 1)
+        timings.append(Timing(
+            op,
+            calls,
+            matches,
+            ns / per_call,
+            _best_ns(on_bytes[op], repeat) / per_call,
+            _best_ns(on_str[op], repeat) / per_call,
+        ))
+    return timings
+
+
+def main(argv: Optional[list[str]] = None) -> int:
+    """Build and run the native benchmark, then the same searches from Python."""
+    parser = argparse.ArgumentParser(description="Compare the regex core natively and through the binding")
+    parser.add_argument("--language", action="append", help="Only use some demo samples, by extension")
+    parser.add_argument("--lines", type=int, help="Sample lines per grammar, all by default")
+    parser.add_argument("--repeat", type=int, default=3, help="Timed runs, the best is kept (default: %(default)s)")
+    parser.add_argument("--onig-include", help="Use an installed Oniguruma, the directory of oniguruma.h")
+    parser.add_argument("--onig-lib", help="The installed Oniguruma library to link with (default: -lonig)")
+    parser.add_argument("-o", "--output", help="Write the results as JSON")
+    args = parser.parse_args(argv)
+
+    binary = build(args.onig_include, args.onig_lib)
+    timings = compare(binary, workloads(args.lines, args.language), args.repeat)
+
+    print(f"{'op':<8} {'calls':>10} {'native':>10} {'bytes':>10} {'str':>10} {'overhead':>10}   ns per search")
+    for t in timings:
+        print(
+            f"{t.op:<8} {t.calls:>10,} {t.native_ns:>10.0f} {t.bytes_ns:>10.0f}"
+            f" {t.str_ns:>10.0f} {t.overhead_ns:>10.0f}"
+        )
+    if args.output:
+        import pyonig
+
+        data: dict[str, Any] = {
+            "pyonig": pyonig.__version__,
+            "oniguruma": pyonig.__onig_version__,
+            "python": platform.python_version(),
+            "platform": platform.platform(),
+            "results": [{**t._asdict(), "overhead_ns": t.overhead_ns} for t in timings],
+        }
+        Path(args.output).write_text(json.dumps(data, indent=2) + "\n", encoding="utf-8")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
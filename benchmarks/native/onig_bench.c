@@ -0,0 +1,257 @@
+/* Native benchmark of the regex core, without the Python binding
+ *
+ * Runs the searches of a workload written by benchmarks/native.py straight
+ * through onig_search() and onig_regset_search(), the same calls, options
+ * and regset lead mode as the extension, and prints a line per operation:
+ *
+ *   <op> <calls> <nanoseconds> <matches>
+ *
+ * The time is the best of the repeats.  One region is reused for all the
+ * searches so only the engine is measured.
+ *
+ * Usage: onig_bench WORKLOAD [REPEAT]
+ *
+ * The workload is a sequence of records, lengths in bytes:
+ *
+ *   grammar <name>
+ *   pattern <length>\n<pattern>\n
+ *   regset <count> <pattern index>...
+ *   line <length>\n<line>\n
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "oniguruma.h"
+
+typedef struct {
+    char *data;
+    size_t len;
+} chunk;
+
+typedef struct {
+    chunk *patterns;
+    size_t num_patterns;
+    regex_t **regexes;
+    OnigRegSet **regsets;
+    size_t num_regsets;
+    chunk *lines;
+    size_t num_lines;
+} grammar;
+
+static grammar *grammars;
+static size_t num_grammars;
+
+static void
+die(const char *message)
+{
+    fprintf(stderr, "onig_bench: %s\n", message);
+    exit(1);
+}
+
+static void *
+grow(void *items, size_t count, size_t size)
+{
+    /* Grow by doubling, called with the count before adding an item */
+    if (count & (count - 1)) {
+        return items;
+    }
+    items = realloc(items, (count ? count * 2 : 1) * size);
+    if (items == NULL) {
+        die("out of memory");
+    }
+    return items;
+}
+
+static chunk
+read_chunk(FILE *f, size_t len)
+{
+    chunk c = {malloc(len + 1), len};
+    if (c.data == NULL) {
+        die("out of memory");
+    }
+    if (fread(c.data, 1, len, f) != len || fgetc(f) != '\n') {
+        die("truncated workload");
+    }
+    c.data[len] = '\0';
+    return c;
+}
+
+static regex_t *
+compile(const chunk *pattern)
+{
+    regex_t *regex;
+    OnigErrorInfo err_info;
+    int r = onig_new(&regex,
+                     (const OnigUChar *)pattern->data,
+                     (const OnigUChar *)(pattern->data + pattern->len),
+                     ONIG_OPTION_NONE,
+                     ONIG_ENCODING_UTF8,
+                     ONIG_SYNTAX_ONIGURUMA,
+                     &err_info);
+    if (r != ONIG_NORMAL) {
+        OnigUChar message[ONIG_MAX_ERROR_MESSAGE_LEN];
+        onig_error_code_to_str(message, r, &err_info);
+        fprintf(stderr, "onig_bench: %s: %s\n", pattern->data, message);
+        exit(1);
+    }
+    return regex;
+}
+
+static void
+read_workload(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        die("cannot open workload");
+    }
+    char kind[16];
+    grammar *g = NULL;
+    while (fscanf(f, "%15s", kind) == 1) {
+        if (strcmp(kind, "grammar") == 0) {
+            char name[256];
+            if (fscanf(f, "%255s", name) != 1) {
+                die("bad grammar record");
+            }
+            fgetc(f);
+            grammars = grow(grammars, num_grammars, sizeof(grammar));
+            g = &grammars[num_grammars++];
+            memset(g, 0, sizeof(*g));
+            continue;
+        }
+        if (g == NULL) {
+            die("record before a grammar");
+        }
+        if (strcmp(kind, "pattern") == 0 || strcmp(kind, "line") == 0) {
+            size_t len;
+            if (fscanf(f, "%zu", &len) != 1 || fgetc(f) != '\n') {
+                die("bad length");
+            }
+            chunk c = read_chunk(f, len);
+            if (kind[0] == 'p') {
+                g->patterns = grow(g->patterns, g->num_patterns, sizeof(chunk));
+                g->regexes = grow(g->regexes, g->num_patterns, sizeof(regex_t *));
+                g->patterns[g->num_patterns] = c;
+                g->regexes[g->num_patterns++] = compile(&c);
+            } else {
+                g->lines = grow(g->lines, g->num_lines, sizeof(chunk));
+                g->lines[g->num_lines++] = c;
+            }
+        } else if (strcmp(kind, "regset") == 0) {
+            int count;
+            if (fscanf(f, "%d", &count) != 1 || count <= 0) {
+                die("bad regset record");
+            }
+            /* A regset owns its regexes, compile its own */
+            regex_t **regs = malloc(sizeof(regex_t *) * count);
+            if (regs == NULL) {
+                die("out of memory");
+            }
+            for (int i = 0; i < count; i++) {
+                size_t index;
+                if (fscanf(f, "%zu", &index) != 1 || index >= g->num_patterns) {
+                    die("bad regset index");
+                }
+                regs[i] = compile(&g->patterns[index]);
+            }
+            OnigRegSet *set;
+            if (onig_regset_new(&set, count, regs) != ONIG_NORMAL) {
+                die("cannot make regset");
+            }
+            free(regs);
+            g->regsets = grow(g->regsets, g->num_regsets, sizeof(OnigRegSet *));
+            g->regsets[g->num_regsets++] = set;
+        } else {
+            die("unknown record");
+        }
+    }
+    fclose(f);
+}
+
+static unsigned long long
+now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+/* Search every pattern on every line, from the start */
+static unsigned long long
+run_search(OnigRegion *region, unsigned long long *calls, unsigned long long *matches)
+{
+    unsigned long long began = now_ns();
+    for (size_t i = 0; i < num_grammars; i++) {
+        grammar *g = &grammars[i];
+        for (size_t p = 0; p < g->num_patterns; p++) {
+            for (size_t l = 0; l < g->num_lines; l++) {
+                const OnigUChar *start = (const OnigUChar *)g->lines[l].data;
+                const OnigUChar *end = start + g->lines[l].len;
+                int r = onig_search(g->regexes[p], start, end, start, end, region, ONIG_OPTION_NONE);
+                *calls += 1;
+                *matches += r >= 0;
+            }
+        }
+    }
+    return now_ns() - began;
+}
+
+/* Search every regset on every line, from the start */
+static unsigned long long
+run_regset(unsigned long long *calls, unsigned long long *matches)
+{
+    unsigned long long began = now_ns();
+    for (size_t i = 0; i < num_grammars; i++) {
+        grammar *g = &grammars[i];
+        for (size_t s = 0; s < g->num_regsets; s++) {
+            for (size_t l = 0; l < g->num_lines; l++) {
+                const OnigUChar *start = (const OnigUChar *)g->lines[l].data;
+                const OnigUChar *end = start + g->lines[l].len;
+                int match_pos;
+                int idx = onig_regset_search(g->regsets[s], start, end, start, end,
+                                             ONIG_REGSET_POSITION_LEAD, ONIG_OPTION_NONE,
+                                             &match_pos);
+                *calls += 1;
+                *matches += idx >= 0;
+            }
+        }
+    }
+    return now_ns() - began;
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: onig_bench WORKLOAD [REPEAT]\n");
+        return 2;
+    }
+    int repeat = argc > 2 ? atoi(argv[2]) : 3;
+    if (repeat < 1) {
+        repeat = 1;
+    }
+
+    OnigEncoding encodings[] = {ONIG_ENCODING_UTF8};
+    onig_initialize(encodings, 1);
+    read_workload(argv[1]);
+
+    OnigRegion *region = onig_region_new();
+    unsigned long long best = 0, calls = 0, matches = 0;
+    for (int i = 0; i < repeat; i++) {
+        calls = matches = 0;
+        unsigned long long ns = run_search(region, &calls, &matches);
+        best = i == 0 || ns < best ? ns : best;
+    }
+    printf("search %llu %llu %llu\n", calls, best, matches);
+
+    for (int i = 0; i < repeat; i++) {
+        calls = matches = 0;
+        unsigned long long ns = run_regset(&calls, &matches);
+        best = i == 0 || ns < best ? ns : best;
+    }
+    printf("regset %llu %llu %llu\n", calls, best, matches);
+
+    onig_region_free(region, 1);
+    onig_end();
+    return 0;
+}
@@ -0,0 +1,363 @@
+#!/usr/bin/env python3
+"""Compatibility and performance parity of pyonig against onigurumacffi.
+
+pyonig is a drop-in replacement for onigurumacffi, the tokenizer imports it
+under that name.  This harness runs the same workloads through both, built
+from the bundled grammars' patterns and the ``demo/sample.*`` files:
+
+- ``compile`` - compiling each pattern
+- ``search`` and ``match`` - each pattern on each line of its sample
+- ``regset`` - a regset of each rule's patterns, searched from the start
+  and the middle of each line
+- ``tokenize`` - tokenizing each sample with the tokenizer on the backend,
+  once its rules are compiled
+
+It diffs the results, spans of every group, regset indexes or regions, and
+reports each operation's time on both, so a mismatch or a path where the C
+extension is not faster shows up.  It exits 1 on a mismatch.
+
+Usage::
+
+    pip install onigurumacffi
+    python benchmarks/parity.py --output parity.json
+"""
+from __future__ import annotations
+
+import argparse
+import importlib
+import json
+import platform
+import sys
+import time
+
+from collections.abc import Callable
+from collections.abc import Iterator
+from contextlib import contextmanager
+from pathlib import Path
+from types import ModuleType
+from typing import Any
+from typing import NamedTuple
+from typing import Optional
+
+
+DEMO_DIR = Path(__file__).resolve().parent.parent / "demo"
+
+#: Operations compared, in the order run
+OPERATIONS = ("compile", "search", "match", "regset", "tokenize")
+
+#: Mismatches kept per operation for the report
+MAX_DIFFS = 20
+
+
+class Workload(NamedTuple):
+    """A grammar's patterns and the lines of its sample.
+
+    Attributes:
+        scope: The grammar's scope
+        language: The extension of the sample
+        patterns: The match, begin, end and while patterns, deduplicated
+        regsets: The match or begin patterns of each rule with patterns
+        lines: The lines of the sample, each ending with a newline
+    """
+
+    scope: str
+    language: str
+    patterns: tuple[str, ...]
+    regsets: tuple[tuple[str, ...], ...]
+    lines: tuple[str, ...]
+
+
+class Parity(NamedTuple):
+    """How an operation compares on both backends.
+
+    Attributes:
+        op: The operation
+        cases: The number of results compared
+        mismatches: The number of results that differ
+        seconds: The best time of the operation on pyonig
+        other_seconds: The best time of the operation on the other backend
+        diffs: The first mismatches, as the case and both results
+    """
+
+    op: str
+    cases: int
+    mismatches: int
+    seconds: float
+    other_seconds: float
+    diffs: list[dict[str, Any]]
+
+    @property
+    def speedup(self) -> float:
+        """Get how many times faster pyonig is than the other backend."""
+        return self.other_seconds / self.seconds if self.seconds else 0.0
+
+
+def _walk(node: Any) -> Iterator[dict[str, Any]]:
+    """Get every rule of a grammar, depth first."""
+    if isinstance(node, dict):
+        yield node
+        for value in node.values():
+            yield from _walk(value)
+    elif isinstance(node, list):
+        for value in node:
+            yield from _walk(value)
+
+
+def workloads(limit: Optional[int] = None, languages: Optional[list[str]] = None) -> list[Workload]:
+    """Build a workload per bundled grammar with a demo sample.
+
+    Args:
+        limit: The number of sample lines to use, all if None
+        languages: Limit to these sample extensions, all if None
+
+    Returns:
+        The workloads
+    """
+    from pyonig.api import LANG_TO_SCOPE
+
+    grammar_dir = Path(importlib.import_module("pyonig").__file__).parent / "grammars"
+    found = []
+    for sample in sorted(DEMO_DIR.glob("sample.*")):
+        language = sample.suffix[1:]
+        scope = LANG_TO_SCOPE.get(language)
+        if scope is None or (languages and language not in languages):
+            continue
+        grammar = json.loads((grammar_dir / f"{scope}.json").read_text(encoding="utf-8"))
+        patterns: dict[str, None] = {}
+        regsets: dict[tuple[str, ...], None] = {}
+        for rule in _walk(grammar):
+            for key in ("match", "begin", "end", "while"):
+                if isinstance(rule.get(key), str):
+                    patterns[rule[key]] = None
+            if isinstance(rule.get("patterns"), list):
+                regset = tuple(
+                    p.get("match") or p.get("begin")
+                    for p in rule["patterns"]
+                    if isinstance(p, dict) and isinstance(p.get("match") or p.get("begin"), str)
+                )
+                if regset:
+                    regsets[regset] = None
+        lines = tuple(line + "\n" for line in sample.read_text(encoding="utf-8").splitlines()[:limit])
+        found.append(Workload(scope, language, tuple(patterns), tuple(regsets), lines))
+    return found
+
+
+def _spans(match: Any, groups: int) -> Optional[tuple[tuple[int, int], ...]]:
+    if match is None:
+        return None
+    return tuple(match.span(i) for i in range(groups + 1))
+
+
+def _compile(backend: ModuleType, patterns: tuple[str, ...]) -> dict[str, Any]:
+    """Compile patterns, the invalid ones to None."""
+    compiled = {}
+    for pattern in patterns:
+        try:
+            compiled[pattern] = backend.compile(pattern)
+        except backend.OnigError:
+            compiled[pattern] = None
+    return compiled
+
+
+def _run_compile(backend: ModuleType, work: list[Workload]) -> list[tuple[Any, Any]]:
+    return [
+        (pattern, None if reg is None else reg.number_of_captures())
+        for w in work
+        for pattern, reg in _compile(backend, w.patterns).items()
+    ]
+
+
+def _run_searches(backend: ModuleType, work: list[Workload], op: str) -> Callable[[], list[tuple[Any, Any]]]:
+    compiled = [(w, _compile(backend, w.patterns)) for w in work]
+
+    def run() -> list[tuple[Any, Any]]:
+        results = []
+        for w, regs in compiled:
+            for pattern, reg in regs.items():
+                if reg is None:
+                    continue
+                groups = reg.number_of_captures()
+                method = reg.search if op == "search" else reg.match
+                for i, line in enumerate(w.lines):
+                    results.append(((pattern, i, line), _spans(method(line, 0), groups)))
+        return results
+
+    return run
+
+
+def _run_regsets(backend: ModuleType, work: list[Workload]) -> Callable[[], list[tuple[Any, Any]]]:
+    compiled = []
+    for w in work:
+        groups = {pattern: None if reg is None else reg.number_of_captures()
+                  for pattern, reg in _compile(backend, w.patterns).items()}
+        for patterns in w.regsets:
+            if any(groups.get(p) is None for p in patterns):
+                continue
+            compiled.append((w, patterns, backend.compile_regset(*patterns), [groups[p] for p in patterns]))
+
+    def run() -> list[tuple[Any, Any]]:
+        results = []
+        for w, patterns, regset, groups in compiled:
+            for i, line in enumerate(w.lines):
+                for start in (0, len(line) // 2):
+                    idx, match = regset.search(line, start)
+                    found = (idx, _spans(match, groups[idx])) if idx >= 0 else None
+                    results.append(((patterns, i, start, line), found))
+        return results
+
+    return run
+
+
+@contextmanager
+def tokenizer_backend(backend: ModuleType) -> Iterator[None]:
+    """Run the tokenizer on a backend, with an empty regex cache.
+
+    Args:
+        backend: The onigurumacffi compatible module
+    """
+    from pyonig.tm_tokenize import reg
+
+    original = reg.onigurumacffi
+    reg.REGEX_CACHE.clear()
+    reg.onigurumacffi = backend
+    try:
+        yield
+    finally:
+        reg.onigurumacffi = original
+        reg.REGEX_CACHE.clear()
+
+
+def _run_tokenize(backend: ModuleType, work: list[Workload]) -> Callable[[], list[tuple[Any, Any]]]:
+    from pyonig import api
+    from pyonig.tm_tokenize.tokenize import tokenize
+
+    grammars = api._grammars()
+
+    def run() -> list[tuple[Any, Any]]:
+        results = []
+        with tokenizer_backend(backend):
+            for w in work:
+                compiler = grammars.compiler_for_scope(w.scope)
+                state = compiler.root_state
+                for i, line in enumerate(w.lines):
+                    try:
+                        state, regions = tokenize(compiler, state, line, i == 0)
+                    except Exception as exc:  # noqa: BLE001
+                        results.append(((w.scope, i, line), f"{type(exc).__name__}: {exc}"))
+                        break
+                    results.append(((w.scope, i, line), [tuple(r) for r in regions]))
+        return results
+
+    # the compilers keep the rules compiled on the backend, time them warm
+    run()
+    return run
+
+
+def _runner(op: str, backend: ModuleType, work: list[Workload]) -> Callable[[], list[tuple[Any, Any]]]:
+    if op == "compile":
+        return lambda: _run_compile(backend, work)
+    if op in ("search", "match"):
+        return _run_searches(backend, work, op)
+    if op == "regset":
+        return _run_regsets(backend, work)
+    if op == "tokenize":
+        return _run_tokenize(backend, work)
+    raise ValueError(f"Unknown operation: {op}")
+
+
+def _best(run: Callable[[], list[tuple[Any, Any]]], repeat: int) -> tuple[list[tuple[Any, Any]], float]:
+    """Run repeat times, get the results and the best time."""
+    best = float("inf")
+    for _ in range(repeat):
+        began = time.perf_counter()
+        results = run()
+        best = min(best, time.perf_counter() - began)
+    return results, best
+
+
+def compare(op: str, other: ModuleType, work: list[Workload], repeat: int = 3) -> Parity:
+    """Run an operation on pyonig and another backend and diff the results.
+
+    Args:
+        op: The operation, one of OPERATIONS
+        other: The onigurumacffi compatible module to compare with
+        work: The workloads
+        repeat: The number of timed runs, the best is kept
+
+    Returns:
+        How the operation compares
+    """
+    import pyonig
+
+    ours, seconds = _best(_runner(op, pyonig, work), repeat)
+    theirs, other_seconds = _best(_runner(op, other, work), repeat)
+    diffs = []
+    mismatches = 0
+    for (case, result), (_, other_result) in zip(ours, theirs):
+        if result != other_result:
+            mismatches += 1
+            if len(diffs) < MAX_DIFFS:
+                diffs.append({"case": repr(case), "pyonig": repr(result), "other": repr(other_result)})
+    if len(ours) != len(theirs):
+        mismatches += abs(len(ours) - len(theirs))
+        diffs.append({"case": "result count", "pyonig": len(ours), "other": len(theirs)})
+    return Parity(op, len(ours), mismatches, seconds, other_seconds, diffs)
+
+
+def main(argv: Optional[list[str]] = None) -> int:
+    """Run the harness."""
+    parser = argparse.ArgumentParser(description="Compare pyonig with onigurumacffi")
+    parser.add_argument(
+        "--other",
+        default="onigurumacffi",
+        help="The onigurumacffi compatible module to compare with (default: %(default)s)",
+    )
+    parser.add_argument(
+        "--op",
+        action="append",
+        choices=OPERATIONS,
+        help="Only run some operations, all by default",
+    )
+    parser.add_argument("--language", action="append", help="Only use some demo samples, by extension")
+    parser.add_argument("--lines", type=int, default=100, help="Sample lines per grammar (default: %(default)s)")
+    parser.add_argument("--repeat", type=int, default=3, help="Timed runs, the best is kept (default: %(default)s)")
+    parser.add_argument("-o", "--output", help="Write the results as JSON")
+    args = parser.parse_args(argv)
+
+    try:
+        other = importlib.import_module(args.other)
+    except ImportError:
+        print(f"{args.other} is not installed, nothing to compare with", file=sys.stderr)
+        return 0
+
+    work = workloads(args.lines, args.language)
+    report = []
+    for op in args.op or OPERATIONS:
+        parity = compare(op, other, work, args.repeat)
+        report.append(parity)
+        print(
+            f"{op:<10} {parity.cases:>9,} cases {parity.mismatches:>7,} mismatches"
+            f"  pyonig {parity.seconds:8.3f}s  {args.other} {parity.other_seconds:8.3f}s"
+            f"  {parity.speedup:6.2f}x",
+            flush=True,
+        )
+        for diff in parity.diffs[:3]:
+            print(f"    {diff['case']}\n      pyonig: {diff['pyonig']}\n      {args.other}: {diff['other']}")
+
+    if args.output:
+        import pyonig
+
+        data = {
+            "pyonig": pyonig.__version__,
+            "other": args.other,
+            "other_version": getattr(other, "__version__", None),
+            "python": platform.python_version(),
+            "platform": platform.platform(),
+            "results": [{**parity._asdict(), "speedup": parity.speedup} for parity in report],
+        }
+        Path(args.output).write_text(json.dumps(data, indent=2) + "\n", encoding="utf-8")
+    return 1 if any(parity.mismatches for parity in report) else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -19,6 +19,10 @@ if [ ! -f /io/deps/oniguruma/src/oniguruma.h ]; then
     exit 1
 fi
 
+# <sys/sdt.h> builds the USDT probes into the extension, a header only
+# dependency; without it the probes compile to nothing
+yum install -y systemtap-sdt-devel || echo "systemtap-sdt-devel not available, building without USDT probes"
+
 # Configure oniguruma (required for compilation)
 echo "=================================="
 echo "Configuring Oniguruma"
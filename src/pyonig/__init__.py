@@ -2,6 +2,11 @@
 
 from __future__ import annotations
 
+import importlib
+
+# typing is not imported at runtime, it costs more than the rest of the import
+TYPE_CHECKING = False
+
 __version__ = "0.1.0"
 
 # Re-export main API from C extension
@@ -16,9 +21,75 @@ from pyonig._pyonig import (
     __onig_version__,
 )
 
-# Public API for syntax highlighting
-from pyonig.api import highlight, highlight_file, detect_language
-from pyonig.theme import ThemeManager
+# Public API for syntax highlighting, imported on first use so the regex API
+# does not pay for the tokenizer, themes and asyncio
+_LAZY = {
+    "highlight": "pyonig.api",
+    "highlight_many": "pyonig.api",
+    "highlight_file": "pyonig.api",
+    "highlight_async": "pyonig.api",
+    "highlight_file_async": "pyonig.api",
+    "highlight_lines_async": "pyonig.api",
+    "highlight_file_lines": "pyonig.api",
+    "highlight_bytes": "pyonig.api",
+    "highlight_file_bytes": "pyonig.api",
+    "highlight_follow": "pyonig.api",
+    "warmup": "pyonig.api",
+    "detect_language": "pyonig.api",
+    "ThemeManager": "pyonig.theme",
+    "record_warmup": "pyonig.warmup_profile",
+    "replay_warmup": "pyonig.warmup_profile",
+    "profile_rules": "pyonig.rule_profile",
+    "stats": "pyonig.metrics",
+    "prometheus_text": "pyonig.metrics",
+    "record_trace": "pyonig.trace",
+}
+
+# Submodules the eager imports used to make available as attributes
+_SUBMODULES = frozenset(
+    ("api", "colorize", "detect", "metrics", "rule_profile", "theme", "trace", "warmup_profile")
+)
+
+if TYPE_CHECKING:
+    from typing import Any
+
+    from pyonig.api import (
+        highlight,
+        highlight_many,
+        highlight_file,
+        highlight_async,
+        highlight_file_async,
+        highlight_lines_async,
+        highlight_file_lines,
+        highlight_bytes,
+        highlight_file_bytes,
+        highlight_follow,
+        warmup,
+        detect_language,
+    )
+    from pyonig.theme import ThemeManager
+    from pyonig.warmup_profile import record_warmup, replay_warmup
+    from pyonig.rule_profile import profile_rules
+    from pyonig.metrics import stats, prometheus_text
+    from pyonig.trace import record_trace
+
+
+def __getattr__(name: str) -> Any:
+    """Import the highlighting API and submodules on first access."""
+    module = _LAZY.get(name)
+    if module is not None:
+        value = getattr(importlib.import_module(module), name)
+    elif name in _SUBMODULES:
+        value = importlib.import_module(f"{__name__}.{name}")
+    else:
+        raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
+    globals()[name] = value
+    return value
+
+
+def __dir__() -> list[str]:
+    return sorted(set(globals()) | set(_LAZY))
+
 
 __all__ = [
     # Core regex API
@@ -33,7 +104,22 @@ __all__ = [
     "__version__",
     # Syntax highlighting API
     "highlight",
+    "highlight_many",
     "highlight_file",
+    "highlight_async",
+    "highlight_file_async",
+    "highlight_lines_async",
+    "highlight_file_lines",
+    "highlight_bytes",
+    "highlight_file_bytes",
+    "highlight_follow",
+    "warmup",
+    "record_warmup",
+    "replay_warmup",
+    "profile_rules",
+    "stats",
+    "prometheus_text",
+    "record_trace",
     "detect_language",
     "ThemeManager",
 ]
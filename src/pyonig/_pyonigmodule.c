@@ -1,5 +1,7 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <pythread.h>
+#include <string.h>
 #include "oniguruma.h"
 
 /* Module state */
@@ -27,13 +29,25 @@ typedef struct {
     int *begs;
     int *ends;
     int num_regs;
+    int byte_offsets;        /* Searched bytes: report byte offsets and bytes */
 } PyOnig_Match;
 
+/* A compiled regex shared by every pattern and regset of the same source */
+typedef struct {
+    regex_t *regex;
+    Py_ssize_t refs;
+    PyObject *key;       /* The pattern string, its key in the registry */
+} shared_regex;
+
 /* Pattern object */
 typedef struct {
     PyObject_HEAD
     regex_t *regex;
+    shared_regex *shared;
     PyObject *pattern;
+    PyObject *module;          /* Owns the OnigError raised by searches */
+    int count_retries;         /* Compiled with retry counting callouts */
+    unsigned long long retries;
 } PyOnig_Pattern;
 
 /* RegSet object */
@@ -41,10 +55,138 @@ typedef struct {
     PyObject_HEAD
     OnigRegSet *regset;
     PyObject *patterns;  /* Tuple of pattern strings */
-    regex_t **regexes;   /* Array of regex_t* that regset points to */
+    shared_regex **regexes;  /* The shared regexes the regset points to */
     int num_patterns;
+    /* onig_regset_search() stores its results in regions owned by the
+     * regset, so concurrent searches on the same object must be serialized
+     * once the GIL is released around the search. */
+    PyThread_type_lock lock;
+    /* Retry counting regsets have a match param per regex, which counts
+     * into its entry of retries, both only used under the lock */
+    int count_retries;
+    OnigMatchParam **match_params;
+    unsigned long long *retries;
 } PyOnig_RegSet;
 
+/* Search statistics
+ *
+ * Process wide counters read by pyonig.stats(). They are always on, a
+ * relaxed atomic add per search, so they stay correct when patterns are
+ * searched from several threads, with or without the GIL.
+ */
+typedef struct {
+    unsigned long long searches;
+    unsigned long long matches;
+    unsigned long long bytes_scanned;  /* From the start to the end of the match, or of the subject */
+    unsigned long long compiles;       /* Regexes compiled, not found already shared */
+} search_stats;
+
+static search_stats stats;
+
+#if defined(__GNUC__) || defined(__clang__)
+#define STATS_ADD(field, n) __atomic_fetch_add(&stats.field, (unsigned long long)(n), __ATOMIC_RELAXED)
+#define STATS_GET(field) __atomic_load_n(&stats.field, __ATOMIC_RELAXED)
+#else
+#define STATS_ADD(field, n) (stats.field += (unsigned long long)(n))
+#define STATS_GET(field) (stats.field)
+#endif
+
+/* Count a search from start_byte, end is the end of the match or -1 */
+static inline void
+stats_search(Py_ssize_t start_byte, Py_ssize_t end, Py_ssize_t len)
+{
+    STATS_ADD(searches, 1);
+    if (end >= 0) {
+        STATS_ADD(matches, 1);
+    } else {
+        end = len;
+    }
+    if (end > start_byte) {
+        STATS_ADD(bytes_scanned, end - start_byte);
+    }
+}
+
+static PyObject *
+pyonig_stats(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return Py_BuildValue("{sKsKsKsK}",
+                         "searches", STATS_GET(searches),
+                         "matches", STATS_GET(matches),
+                         "bytes_scanned", STATS_GET(bytes_scanned),
+                         "compiles", STATS_GET(compiles));
+}
+
+/* Static tracepoints
+ *
+ * USDT probes of the pyonig provider, for perf or bpftrace attached to a
+ * running process.  Regexes and regsets are identified by their address:
+ *
+ *   pyonig:compile(regex, pattern_len, result, duration_ns)
+ *   pyonig:match(regex, subject_len, start, result, duration_ns)
+ *   pyonig:search(regex, subject_len, start, result, duration_ns)
+ *   pyonig:regset_search(regset, subject_len, start, index, duration_ns)
+ *   pyonig:match_alloc(regex_or_regset, subject_len, num_regs, copied, duration_ns)
+ *
+ * Results are those of onig_new(), onig_match() and onig_search(), the index
+ * is the regset pattern matched or -1, and copied is the bytes of a str
+ * subject copied into the match.  A probe site is a nop and is only timed
+ * while a tracer has set its semaphore.  Built without <sys/sdt.h>, or with
+ * PYONIG_NO_USDT defined, the probes compile to nothing.
+ */
+#if defined(__linux__) && defined(__has_include) && !defined(PYONIG_NO_USDT)
+#if __has_include(<sys/sdt.h>)
+#define PYONIG_USDT 1
+#endif
+#endif
+
+#ifdef PYONIG_USDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#include <time.h>
+
+#define PROBE_SEMAPHORE(name) \
+    __extension__ unsigned short pyonig_##name##_semaphore \
+    __attribute__((unused, visibility("hidden"), section(".probes")))
+
+PROBE_SEMAPHORE(compile);
+PROBE_SEMAPHORE(match);
+PROBE_SEMAPHORE(search);
+PROBE_SEMAPHORE(regset_search);
+PROBE_SEMAPHORE(match_alloc);
+
+static inline unsigned long long
+probe_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+}
+
+#define PROBE_ENABLED(name) __builtin_expect(pyonig_##name##_semaphore != 0, 0)
+/* The start of a timed probe, 0 when no tracer is attached */
+#define PROBE_BEGIN(name) (PROBE_ENABLED(name) ? probe_now_ns() : 0ULL)
+#define PROBE_ELAPSED(began) ((began) ? probe_now_ns() - (began) : 0ULL)
+#define PROBE4(name, a, b, c, d) do { \
+    if (PROBE_ENABLED(name)) { \
+        DTRACE_PROBE4(pyonig, name, a, b, c, d); \
+    } \
+} while (0)
+#define PROBE5(name, a, b, c, d, e) do { \
+    if (PROBE_ENABLED(name)) { \
+        DTRACE_PROBE5(pyonig, name, a, b, c, d, e); \
+    } \
+} while (0)
+#else
+#define PROBE_BEGIN(name) 0ULL
+#define PROBE_ELAPSED(began) ((void)(began), 0ULL)
+#define PROBE4(name, a, b, c, d) do { \
+    if (0) { (void)(a); (void)(b); (void)(c); (void)(d); } \
+} while (0)
+#define PROBE5(name, a, b, c, d, e) do { \
+    if (0) { (void)(a); (void)(b); (void)(c); (void)(d); (void)(e); } \
+} while (0)
+#endif
+
 /* Error handling */
 static void
 raise_onig_error(PyObject *module, int code, OnigErrorInfo *err_info)
@@ -56,6 +198,127 @@ raise_onig_error(PyObject *module, int code, OnigErrorInfo *err_info)
     PyErr_SetString(state->OnigError, (char *)s);
 }
 
+/* Shared regexes
+ *
+ * Grammars repeat the same pattern across many regsets, every rule that
+ * includes a repository entry gets its patterns, so each source is compiled
+ * once into a registry and shared by reference count. A regex is only read
+ * by a search, the regions are per search or owned by each regset, so
+ * sharing needs no locking. The registry and counts are guarded by the GIL.
+ */
+
+/* Pattern string -> capsule of its shared_regex, which isn't owned */
+static PyObject *regex_registry = NULL;
+
+/* Find a compiled pattern and take a reference to it, NULL if absent or on error */
+static shared_regex *
+shared_regex_lookup(PyObject *key)
+{
+    PyObject *capsule = PyDict_GetItemWithError(regex_registry, key);
+    if (capsule == NULL) {
+        return NULL;
+    }
+    shared_regex *shared = PyCapsule_GetPointer(capsule, NULL);
+    if (shared != NULL) {
+        shared->refs++;
+    }
+    return shared;
+}
+
+/* Register a new compiled pattern and take a reference to it. Another
+ * thread may have compiled the same pattern while the GIL was released,
+ * then the regex is freed and the registered one used. */
+static shared_regex *
+shared_regex_register(PyObject *key, regex_t *regex)
+{
+    shared_regex *shared = shared_regex_lookup(key);
+    if (shared != NULL || PyErr_Occurred()) {
+        onig_free(regex);
+        return shared;
+    }
+    
+    shared = PyMem_Malloc(sizeof(shared_regex));
+    if (shared == NULL) {
+        onig_free(regex);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    PyObject *capsule = PyCapsule_New(shared, NULL, NULL);
+    if (capsule == NULL || PyDict_SetItem(regex_registry, key, capsule) < 0) {
+        Py_XDECREF(capsule);
+        PyMem_Free(shared);
+        onig_free(regex);
+        return NULL;
+    }
+    Py_DECREF(capsule);
+    
+    shared->regex = regex;
+    shared->refs = 1;
+    shared->key = key;
+    Py_INCREF(key);
+    return shared;
+}
+
+/* Drop a reference, freeing the regex with the last one */
+static void
+shared_regex_release(shared_regex *shared)
+{
+    if (--shared->refs > 0) {
+        return;
+    }
+    if (PyDict_DelItem(regex_registry, shared->key) < 0) {
+        PyErr_WriteUnraisable(shared->key);
+    }
+    onig_free(shared->regex);
+    Py_DECREF(shared->key);
+    PyMem_Free(shared);
+}
+
+static PyObject *
+pyonig_shared_regex_count(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return PyLong_FromSsize_t(PyDict_GET_SIZE(regex_registry));
+}
+
+/* Retry counting
+ *
+ * Oniguruma counts the retries, backtracks, of each match attempt but only
+ * reports them to callouts. A counting regex is compiled with a retraction
+ * callout before the pattern, called when an attempt at a start position
+ * fails, and a progress callout after it, called when one succeeds. The
+ * "(?x)\n" ends an extended mode comment at the end of the pattern and is
+ * ignored otherwise.
+ */
+#define RETRY_PREFIX "(?{retries}<)(?:"
+#define RETRY_SUFFIX "(?x)\n)(?{retries})"
+
+static PyObject *
+retry_counting_source(PyObject *pattern)
+{
+    return PyUnicode_FromFormat(RETRY_PREFIX "%U" RETRY_SUFFIX, pattern);
+}
+
+static int
+retry_callout(OnigCalloutArgs *args, void *user_data)
+{
+    *(unsigned long long *)user_data += onig_get_retry_counter_by_callout_args(args);
+    return ONIG_CALLOUT_SUCCESS;
+}
+
+/* A match param counting the retries of a search into counter */
+static OnigMatchParam *
+retry_match_param(unsigned long long *counter)
+{
+    OnigMatchParam *param = onig_new_match_param();
+    if (param == NULL) {
+        return NULL;
+    }
+    onig_set_progress_callout_of_match_param(param, retry_callout);
+    onig_set_retraction_callout_of_match_param(param, retry_callout);
+    onig_set_callout_user_data_of_match_param(param, counter);
+    return param;
+}
+
 /* Match object methods */
 static void
 PyOnig_Match_dealloc(PyOnig_Match *self)
@@ -83,6 +346,12 @@ PyOnig_Match_group(PyOnig_Match *self, PyObject *args)
     int beg = self->begs[n];
     int end = self->ends[n];
     
+    if (self->byte_offsets) {
+        if (beg < 0) {
+            return PyBytes_FromStringAndSize("", 0);
+        }
+        return PyBytes_FromStringAndSize(bytes + beg, end - beg);
+    }
     return PyUnicode_DecodeUTF8(bytes + beg, end - beg, "strict");
 }
 
@@ -102,6 +371,10 @@ PyOnig_Match_start(PyOnig_Match *self, PyObject *args)
     const unsigned char *bytes = (const unsigned char *)PyBytes_AS_STRING(self->string_bytes);
     int beg = self->begs[n];
     
+    if (self->byte_offsets) {
+        return PyLong_FromLong(beg);
+    }
+    
     /* Convert byte offset to character offset */
     Py_ssize_t char_offset = 0;
     for (int i = 0; i < beg; i++) {
@@ -130,6 +403,10 @@ PyOnig_Match_end(PyOnig_Match *self, PyObject *args)
     const unsigned char *bytes = (const unsigned char *)PyBytes_AS_STRING(self->string_bytes);
     int end = self->ends[n];
     
+    if (self->byte_offsets) {
+        return PyLong_FromLong(end);
+    }
+    
     /* Convert byte offset to character offset */
     Py_ssize_t char_offset = 0;
     for (int i = 0; i < end; i++) {
@@ -177,6 +454,9 @@ PyOnig_Match_expand(PyOnig_Match *self, PyObject *args)
 static PyObject *
 PyOnig_Match_get_string(PyOnig_Match *self, void *closure)
 {
+    if (self->byte_offsets) {
+        return Py_NewRef(self->string_bytes);
+    }
     return PyUnicode_DecodeUTF8(
         PyBytes_AS_STRING(self->string_bytes),
         PyBytes_GET_SIZE(self->string_bytes),
@@ -197,16 +477,29 @@ PyOnig_Match_subscript(PyOnig_Match *self, PyObject *key)
         return NULL;
     }
     
-    return PyOnig_Match_group(self, Py_BuildValue("(i)", (int)n));
+    PyObject *args = Py_BuildValue("(i)", (int)n);
+    if (args == NULL) {
+        return NULL;
+    }
+    PyObject *group = PyOnig_Match_group(self, args);
+    Py_DECREF(args);
+    return group;
 }
 
 static PyObject *
 PyOnig_Match_repr(PyOnig_Match *self)
 {
-    PyObject *span = PyOnig_Match_span(self, Py_BuildValue("()"));
-    if (span == NULL) return NULL;
+    PyObject *no_args = PyTuple_New(0);
+    if (no_args == NULL) return NULL;
+    
+    PyObject *span = PyOnig_Match_span(self, no_args);
+    if (span == NULL) {
+        Py_DECREF(no_args);
+        return NULL;
+    }
     
-    PyObject *match = PyOnig_Match_group(self, Py_BuildValue("()"));
+    PyObject *match = PyOnig_Match_group(self, no_args);
+    Py_DECREF(no_args);
     if (match == NULL) {
         Py_DECREF(span);
         return NULL;
@@ -264,15 +557,16 @@ static PyTypeObject PyOnig_MatchType = {
 static void
 PyOnig_Pattern_dealloc(PyOnig_Pattern *self)
 {
-    if (self->regex != NULL) {
-        onig_free(self->regex);
+    if (self->shared != NULL) {
+        shared_regex_release(self->shared);
     }
     Py_XDECREF(self->pattern);
+    Py_XDECREF(self->module);
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
 
 static PyObject *
-create_match_object(PyObject *string_bytes, OnigRegion *region)
+create_match_object(PyObject *string_bytes, OnigRegion *region, int byte_offsets)
 {
     if (region->num_regs == 0) {
         Py_RETURN_NONE;
@@ -285,6 +579,7 @@ create_match_object(PyObject *string_bytes, OnigRegion *region)
     
     match->string_bytes = string_bytes;
     Py_INCREF(string_bytes);
+    match->byte_offsets = byte_offsets;
     
     match->num_regs = region->num_regs;
     match->begs = PyMem_Malloc(sizeof(int) * region->num_regs);
@@ -303,58 +598,153 @@ create_match_object(PyObject *string_bytes, OnigRegion *region)
     return (PyObject *)match;
 }
 
-static PyObject *
-PyOnig_Pattern_match(PyOnig_Pattern *self, PyObject *args, PyObject *kwargs)
-{
+/* Search subjects
+ *
+ * A str subject is searched as UTF-8 and takes and reports character
+ * offsets.  A bytes subject must hold UTF-8; it is searched in place, without
+ * a copy, and takes and reports byte offsets.
+ */
+typedef struct {
+    PyObject *bytes;        /* The bytes subject, borrowed, or NULL for str */
     const char *string;
-    Py_ssize_t string_len;
-    int start = 0;
-    int flags = ONIG_OPTION_NONE;
-    
-    static char *kwlist[] = {"string", "start", "flags", NULL};
+    Py_ssize_t len;
+    Py_ssize_t start_byte;
+} search_subject;
+
+/* Returns 1 to search, 0 if start is at or past the end, -1 on error */
+static int
+parse_subject(PyObject *obj, int start, search_subject *subject)
+{
+    if (PyBytes_Check(obj)) {
+        subject->bytes = obj;
+        subject->string = PyBytes_AS_STRING(obj);
+        subject->len = PyBytes_GET_SIZE(obj);
+        subject->start_byte = start > 0 ? start : 0;
+        return subject->start_byte < subject->len;
+    }
+    if (!PyUnicode_Check(obj)) {
+        PyErr_Format(PyExc_TypeError, "subject must be str or bytes, not %.200s",
+                     Py_TYPE(obj)->tp_name);
+        return -1;
+    }
     
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|ii", kwlist,
-                                      &string, &string_len, &start, &flags)) {
-        return NULL;
+    subject->bytes = NULL;
+    subject->string = PyUnicode_AsUTF8AndSize(obj, &subject->len);
+    if (subject->string == NULL) {
+        return -1;
     }
     
     /* Convert start from character offset to byte offset */
-    int start_byte = 0;
+    subject->start_byte = 0;
     if (start > 0) {
         int char_count = 0;
-        const unsigned char *ubytes = (const unsigned char *)string;
-        for (int i = 0; i < string_len; i++) {
+        const unsigned char *ubytes = (const unsigned char *)subject->string;
+        for (Py_ssize_t i = 0; i < subject->len; i++) {
             /* Count only start bytes of UTF-8 sequences */
             if ((ubytes[i] & 0xC0) != 0x80) {
                 char_count++;
                 if (char_count == start) {
-                    start_byte = i + 1;  /* Start matching AFTER this character */
+                    subject->start_byte = i + 1;  /* Start AFTER this character */
                     break;
                 }
             }
         }
         /* If start is at or beyond string length in characters, no match possible */
         if (char_count < start) {
-            Py_RETURN_NONE;
+            return 0;
         }
     }
     
     /* If start_byte is at or past the end, no match possible */
-    if (start_byte >= string_len) {
+    return subject->start_byte < subject->len;
+}
+
+/* Build a match for a subject, referencing a bytes subject and copying a str
+ * one, id is the regex or regset matched for the match_alloc probe */
+static PyObject *
+subject_match(search_subject *subject, OnigRegion *region, const void *id)
+{
+    unsigned long long began = PROBE_BEGIN(match_alloc);
+    PyObject *match;
+    if (subject->bytes != NULL) {
+        match = create_match_object(subject->bytes, region, 1);
+    } else {
+        PyObject *string_bytes = PyBytes_FromStringAndSize(subject->string, subject->len);
+        if (string_bytes == NULL) {
+            return NULL;
+        }
+        match = create_match_object(string_bytes, region, 0);
+        Py_DECREF(string_bytes);
+    }
+    PROBE5(match_alloc, (uintptr_t)id, subject->len, region->num_regs,
+           subject->bytes != NULL ? 0 : subject->len, PROBE_ELAPSED(began));
+    return match;
+}
+
+static PyObject *
+PyOnig_Pattern_match(PyOnig_Pattern *self, PyObject *args, PyObject *kwargs)
+{
+    PyObject *subject_obj;
+    int start = 0;
+    int flags = ONIG_OPTION_NONE;
+    
+    static char *kwlist[] = {"string", "start", "flags", NULL};
+    
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ii", kwlist,
+                                      &subject_obj, &start, &flags)) {
+        return NULL;
+    }
+    
+    search_subject subject;
+    int searchable = parse_subject(subject_obj, start, &subject);
+    if (searchable < 0) {
+        return NULL;
+    }
+    if (!searchable) {
         Py_RETURN_NONE;
     }
+    const char *string = subject.string;
+    Py_ssize_t string_len = subject.len;
+    Py_ssize_t start_byte = subject.start_byte;
     
     OnigRegion *region = onig_region_new();
     if (region == NULL) {
         return PyErr_NoMemory();
     }
+    unsigned long long retries = 0;
+    OnigMatchParam *param = NULL;
+    if (self->count_retries && (param = retry_match_param(&retries)) == NULL) {
+        onig_region_free(region, 1);
+        return PyErr_NoMemory();
+    }
     
-    int r = onig_match(self->regex,
+    int r;
+    unsigned long long began = PROBE_BEGIN(match);
+    Py_BEGIN_ALLOW_THREADS
+    if (param != NULL) {
+        r = onig_match_with_param(self->regex,
+                                  (const OnigUChar *)string,
+                                  (const OnigUChar *)(string + string_len),
+                                  (const OnigUChar *)(string + start_byte),
+                                  region,
+                                  flags,
+                                  param);
+    } else {
+        r = onig_match(self->regex,
                        (const OnigUChar *)string,
                        (const OnigUChar *)(string + string_len),
                        (const OnigUChar *)(string + start_byte),
                        region,
                        flags);
+    }
+    Py_END_ALLOW_THREADS
+    
+    if (param != NULL) {
+        onig_free_match_param(param);
+        self->retries += retries;
+    }
+    stats_search(start_byte, r >= 0 ? region->end[0] : -1, string_len);
+    PROBE5(match, (uintptr_t)self->regex, string_len, start_byte, r, PROBE_ELAPSED(began));
     
     if (r == ONIG_MISMATCH) {
         onig_region_free(region, 1);
@@ -363,19 +753,11 @@ PyOnig_Pattern_match(PyOnig_Pattern *self, PyObject *args, PyObject *kwargs)
     
     if (r < 0) {
         onig_region_free(region, 1);
-        PyObject *module = PyType_GetModule(Py_TYPE(self));
-        raise_onig_error(module, r, NULL);
-        return NULL;
-    }
-    
-    PyObject *string_bytes = PyBytes_FromStringAndSize(string, string_len);
-    if (string_bytes == NULL) {
-        onig_region_free(region, 1);
+        raise_onig_error(self->module, r, NULL);
         return NULL;
     }
     
-    PyObject *match = create_match_object(string_bytes, region);
-    Py_DECREF(string_bytes);
+    PyObject *match = subject_match(&subject, region, self->regex);
     onig_region_free(region, 1);
     
     return match;
@@ -384,56 +766,78 @@ PyOnig_Pattern_match(PyOnig_Pattern *self, PyObject *args, PyObject *kwargs)
 static PyObject *
 PyOnig_Pattern_search(PyOnig_Pattern *self, PyObject *args, PyObject *kwargs)
 {
-    const char *string;
-    Py_ssize_t string_len;
+    PyObject *subject_obj;
     int start = 0;
     int flags = ONIG_OPTION_NONE;
+    unsigned long retry_limit = 0;
     
-    static char *kwlist[] = {"string", "start", "flags", NULL};
+    static char *kwlist[] = {"string", "start", "flags", "retry_limit", NULL};
     
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|ii", kwlist,
-                                      &string, &string_len, &start, &flags)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ii$k", kwlist,
+                                      &subject_obj, &start, &flags, &retry_limit)) {
         return NULL;
     }
     
-    /* Convert start from character offset to byte offset */
-    int start_byte = 0;
-    if (start > 0) {
-        int char_count = 0;
-        const unsigned char *ubytes = (const unsigned char *)string;
-        for (int i = 0; i < string_len; i++) {
-            /* Count only start bytes of UTF-8 sequences */
-            if ((ubytes[i] & 0xC0) != 0x80) {
-                char_count++;
-                if (char_count == start) {
-                    start_byte = i + 1;  /* Start searching AFTER this character */
-                    break;
-                }
-            }
-        }
-        /* If start is at or beyond string length in characters, no match possible */
-        if (char_count < start) {
-            Py_RETURN_NONE;
-        }
+    search_subject subject;
+    int searchable = parse_subject(subject_obj, start, &subject);
+    if (searchable < 0) {
+        return NULL;
     }
-    
-    /* If start_byte is at or past the end, no match possible */
-    if (start_byte >= string_len) {
+    if (!searchable) {
         Py_RETURN_NONE;
     }
+    const char *string = subject.string;
+    Py_ssize_t string_len = subject.len;
+    Py_ssize_t start_byte = subject.start_byte;
     
     OnigRegion *region = onig_region_new();
     if (region == NULL) {
         return PyErr_NoMemory();
     }
-    
-    int r = onig_search(self->regex,
+    unsigned long long retries = 0;
+    OnigMatchParam *param = NULL;
+    if (self->count_retries && (param = retry_match_param(&retries)) == NULL) {
+        onig_region_free(region, 1);
+        return PyErr_NoMemory();
+    }
+    /* A search giving up after retry_limit retries fails with OnigError */
+    if (retry_limit != 0) {
+        if (param == NULL && (param = onig_new_match_param()) == NULL) {
+            onig_region_free(region, 1);
+            return PyErr_NoMemory();
+        }
+        onig_set_retry_limit_in_search_of_match_param(param, retry_limit);
+    }
+    
+    int r;
+    unsigned long long began = PROBE_BEGIN(search);
+    Py_BEGIN_ALLOW_THREADS
+    if (param != NULL) {
+        r = onig_search_with_param(self->regex,
+                                   (const OnigUChar *)string,
+                                   (const OnigUChar *)(string + string_len),
+                                   (const OnigUChar *)(string + start_byte),
+                                   (const OnigUChar *)(string + string_len),
+                                   region,
+                                   flags,
+                                   param);
+    } else {
+        r = onig_search(self->regex,
                         (const OnigUChar *)string,
                         (const OnigUChar *)(string + string_len),
                         (const OnigUChar *)(string + start_byte),
                         (const OnigUChar *)(string + string_len),
                         region,
                         flags);
+    }
+    Py_END_ALLOW_THREADS
+    
+    if (param != NULL) {
+        onig_free_match_param(param);
+        self->retries += retries;
+    }
+    stats_search(start_byte, r >= 0 ? region->end[0] : -1, string_len);
+    PROBE5(search, (uintptr_t)self->regex, string_len, start_byte, r, PROBE_ELAPSED(began));
     
     if (r == ONIG_MISMATCH) {
         onig_region_free(region, 1);
@@ -442,19 +846,11 @@ PyOnig_Pattern_search(PyOnig_Pattern *self, PyObject *args, PyObject *kwargs)
     
     if (r < 0) {
         onig_region_free(region, 1);
-        PyObject *module = PyType_GetModule(Py_TYPE(self));
-        raise_onig_error(module, r, NULL);
+        raise_onig_error(self->module, r, NULL);
         return NULL;
     }
     
-    PyObject *string_bytes = PyBytes_FromStringAndSize(string, string_len);
-    if (string_bytes == NULL) {
-        onig_region_free(region, 1);
-        return NULL;
-    }
-    
-    PyObject *match = create_match_object(string_bytes, region);
-    Py_DECREF(string_bytes);
+    PyObject *match = subject_match(&subject, region, self->regex);
     onig_region_free(region, 1);
     
     return match;
@@ -473,6 +869,21 @@ PyOnig_Pattern_repr(PyOnig_Pattern *self)
     return PyUnicode_FromFormat("pyonig.compile(%R)", self->pattern);
 }
 
+static PyObject *
+PyOnig_Pattern_get_retries(PyOnig_Pattern *self, void *closure)
+{
+    if (!self->count_retries) {
+        Py_RETURN_NONE;
+    }
+    return PyLong_FromUnsignedLongLong(self->retries);
+}
+
+static PyGetSetDef PyOnig_Pattern_getset[] = {
+    {"retries", (getter)PyOnig_Pattern_get_retries, NULL,
+     "Retries of all searches, None unless compiled with count_retries", NULL},
+    {NULL}
+};
+
 static PyMethodDef PyOnig_Pattern_methods[] = {
     {"match", (PyCFunction)PyOnig_Pattern_match, METH_VARARGS | METH_KEYWORDS,
      "Match pattern at start of string"},
@@ -493,6 +904,7 @@ static PyTypeObject PyOnig_PatternType = {
     .tp_dealloc = (destructor)PyOnig_Pattern_dealloc,
     .tp_repr = (reprfunc)PyOnig_Pattern_repr,
     .tp_methods = PyOnig_Pattern_methods,
+    .tp_getset = PyOnig_Pattern_getset,
 };
 
 /* RegSet object methods */
@@ -500,13 +912,33 @@ static void
 PyOnig_RegSet_dealloc(PyOnig_RegSet *self)
 {
     if (self->regset != NULL) {
-        /* onig_regset_free() frees the individual regexes too */
+        /* onig_regset_free() frees the regexes still in the set, the shared
+         * ones are removed first, last to first so none are moved */
+        for (int i = self->num_patterns - 1; i >= 0; i--) {
+            onig_regset_replace(self->regset, i, NULL);
+        }
         onig_regset_free(self->regset);
     }
-    /* Just free the array pointer, not the regex objects (regset_free does that) */
     if (self->regexes != NULL) {
+        for (int i = 0; i < self->num_patterns; i++) {
+            if (self->regexes[i] != NULL) {
+                shared_regex_release(self->regexes[i]);
+            }
+        }
         PyMem_Free(self->regexes);
     }
+    if (self->match_params != NULL) {
+        for (int i = 0; i < self->num_patterns; i++) {
+            if (self->match_params[i] != NULL) {
+                onig_free_match_param(self->match_params[i]);
+            }
+        }
+        PyMem_Free(self->match_params);
+    }
+    PyMem_Free(self->retries);
+    if (self->lock != NULL) {
+        PyThread_free_lock(self->lock);
+    }
     Py_XDECREF(self->patterns);
     Py_TYPE(self)->tp_free((PyObject *)self);
 }
@@ -514,15 +946,14 @@ PyOnig_RegSet_dealloc(PyOnig_RegSet *self)
 static PyObject *
 PyOnig_RegSet_search(PyOnig_RegSet *self, PyObject *args, PyObject *kwargs)
 {
-    const char *string;
-    Py_ssize_t string_len;
+    PyObject *subject_obj;
     int start = 0;
     int flags = ONIG_OPTION_NONE;
     
     static char *kwlist[] = {"string", "start", "flags", NULL};
     
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|ii", kwlist,
-                                      &string, &string_len, &start, &flags)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ii", kwlist,
+                                      &subject_obj, &start, &flags)) {
         return NULL;
     }
     
@@ -531,61 +962,75 @@ PyOnig_RegSet_search(PyOnig_RegSet *self, PyObject *args, PyObject *kwargs)
         return Py_BuildValue("(iO)", -1, Py_None);
     }
     
-    /* Convert start from character offset to byte offset */
-    int start_byte = 0;
-    if (start > 0) {
-        int char_count = 0;
-        const unsigned char *ubytes = (const unsigned char *)string;
-        for (int i = 0; i < string_len; i++) {
-            /* Count only start bytes of UTF-8 sequences */
-            if ((ubytes[i] & 0xC0) != 0x80) {
-                char_count++;
-                if (char_count == start) {
-                    start_byte = i + 1;  /* Start searching AFTER this character */
-                    break;
-                }
-            }
-        }
-        /* If start is at or beyond string length in characters, no match possible */
-        if (char_count < start) {
-            return Py_BuildValue("(iO)", -1, Py_None);
-        }
+    search_subject subject;
+    int searchable = parse_subject(subject_obj, start, &subject);
+    if (searchable < 0) {
+        return NULL;
     }
-    
-    /* If start_byte is at or past the end, no match possible */
-    if (start_byte >= string_len) {
+    if (!searchable) {
         return Py_BuildValue("(iO)", -1, Py_None);
     }
+    const char *string = subject.string;
+    Py_ssize_t string_len = subject.len;
+    Py_ssize_t start_byte = subject.start_byte;
     
+    OnigRegion *region = onig_region_new();
+    if (region == NULL) {
+        return PyErr_NoMemory();
+    }
+    
+    /* Search without the GIL; the matching region is copied out while the
+     * regset lock is still held since the next search overwrites it. */
     int match_pos;
-    int idx = onig_regset_search(
-        self->regset,
-        (const OnigUChar *)string,
-        (const OnigUChar *)(string + string_len),
-        (const OnigUChar *)(string + start_byte),
-        (const OnigUChar *)(string + string_len),
-        ONIG_REGSET_POSITION_LEAD,
-        flags,
-        &match_pos
-    );
+    int idx;
+    unsigned long long began = PROBE_BEGIN(regset_search);
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    if (self->match_params != NULL) {
+        idx = onig_regset_search_with_param(
+            self->regset,
+            (const OnigUChar *)string,
+            (const OnigUChar *)(string + string_len),
+            (const OnigUChar *)(string + start_byte),
+            (const OnigUChar *)(string + string_len),
+            ONIG_REGSET_POSITION_LEAD,
+            flags,
+            self->match_params,
+            &match_pos
+        );
+    } else {
+        idx = onig_regset_search(
+            self->regset,
+            (const OnigUChar *)string,
+            (const OnigUChar *)(string + string_len),
+            (const OnigUChar *)(string + start_byte),
+            (const OnigUChar *)(string + string_len),
+            ONIG_REGSET_POSITION_LEAD,
+            flags,
+            &match_pos
+        );
+    }
+    if (idx >= 0) {
+        OnigRegion *set_region = onig_regset_get_region(self->regset, idx);
+        if (set_region != NULL) {
+            onig_region_copy(region, set_region);
+        } else {
+            idx = -1;
+        }
+    }
+    PyThread_release_lock(self->lock);
+    Py_END_ALLOW_THREADS
+    stats_search(start_byte, idx >= 0 ? region->end[0] : -1, string_len);
+    PROBE5(regset_search, (uintptr_t)self->regset, string_len, start_byte, idx, PROBE_ELAPSED(began));
     
     if (idx < 0) {
         /* No match */
+        onig_region_free(region, 1);
         return Py_BuildValue("(iO)", -1, Py_None);
     }
     
-    OnigRegion *region = onig_regset_get_region(self->regset, idx);
-    if (region == NULL) {
-        return Py_BuildValue("(iO)", -1, Py_None);
-    }
-    
-    PyObject *string_bytes = PyBytes_FromStringAndSize(string, string_len);
-    if (string_bytes == NULL) {
-        return NULL;
-    }
-    
-    PyObject *match = create_match_object(string_bytes, region);
-    Py_DECREF(string_bytes);
+    PyObject *match = subject_match(&subject, region, self->regset);
+    onig_region_free(region, 1);
     
     if (match == NULL) {
         return NULL;
@@ -609,6 +1054,40 @@ PyOnig_RegSet_repr(PyOnig_RegSet *self)
     return result;
 }
 
+static PyObject *
+PyOnig_RegSet_get_retries(PyOnig_RegSet *self, void *closure)
+{
+    if (!self->count_retries) {
+        Py_RETURN_NONE;
+    }
+    PyObject *ret = PyTuple_New(self->num_patterns);
+    if (ret == NULL || self->num_patterns == 0) {
+        return ret;
+    }
+    
+    /* Searches count under the lock */
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(self->lock, WAIT_LOCK);
+    Py_END_ALLOW_THREADS
+    for (int i = 0; i < self->num_patterns; i++) {
+        PyObject *count = PyLong_FromUnsignedLongLong(self->retries[i]);
+        if (count == NULL) {
+            PyThread_release_lock(self->lock);
+            Py_DECREF(ret);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(ret, i, count);
+    }
+    PyThread_release_lock(self->lock);
+    return ret;
+}
+
+static PyGetSetDef PyOnig_RegSet_getset[] = {
+    {"retries", (getter)PyOnig_RegSet_get_retries, NULL,
+     "Retries of all searches per pattern, None unless compiled with count_retries", NULL},
+    {NULL}
+};
+
 static PyMethodDef PyOnig_RegSet_methods[] = {
     {"search", (PyCFunction)PyOnig_RegSet_search, METH_VARARGS | METH_KEYWORDS,
      "Search for any pattern in the regset"},
@@ -625,16 +1104,21 @@ static PyTypeObject PyOnig_RegSetType = {
     .tp_dealloc = (destructor)PyOnig_RegSet_dealloc,
     .tp_repr = (reprfunc)PyOnig_RegSet_repr,
     .tp_methods = PyOnig_RegSet_methods,
+    .tp_getset = PyOnig_RegSet_getset,
 };
 
 /* Module functions */
 static PyObject *
-pyonig_compile(PyObject *module, PyObject *args)
+pyonig_compile(PyObject *module, PyObject *args, PyObject *kwargs)
 {
     const char *pattern;
     Py_ssize_t pattern_len;
+    int count_retries = 0;
+    
+    static char *kwlist[] = {"pattern", "count_retries", NULL};
     
-    if (!PyArg_ParseTuple(args, "s#", &pattern, &pattern_len)) {
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "s#|$p", kwlist,
+                                      &pattern, &pattern_len, &count_retries)) {
         return NULL;
     }
     
@@ -644,38 +1128,96 @@ pyonig_compile(PyObject *module, PyObject *args)
     }
     
     self->regex = NULL;
+    self->shared = NULL;
+    self->module = Py_NewRef(module);
+    self->count_retries = count_retries;
+    self->retries = 0;
     self->pattern = PyUnicode_FromStringAndSize(pattern, pattern_len);
     if (self->pattern == NULL) {
         Py_DECREF(self);
         return NULL;
     }
     
-    OnigErrorInfo err_info;
-    int r = onig_new(&self->regex,
+    PyObject *key = count_retries ? retry_counting_source(self->pattern) : Py_NewRef(self->pattern);
+    if (key == NULL) {
+        Py_DECREF(self);
+        return NULL;
+    }
+    if (count_retries && (pattern = PyUnicode_AsUTF8AndSize(key, &pattern_len)) == NULL) {
+        Py_DECREF(key);
+        Py_DECREF(self);
+        return NULL;
+    }
+    
+    self->shared = shared_regex_lookup(key);
+    if (self->shared == NULL) {
+        if (PyErr_Occurred()) {
+            Py_DECREF(key);
+            Py_DECREF(self);
+            return NULL;
+        }
+        
+        /* The source stays alive in key, compile without the GIL so other
+         * threads, e.g. a warmup pool, compile at the same time */
+        regex_t *regex;
+        OnigErrorInfo err_info;
+        int r;
+        unsigned long long began = PROBE_BEGIN(compile);
+        Py_BEGIN_ALLOW_THREADS
+        r = onig_new(&regex,
                      (const OnigUChar *)pattern,
                      (const OnigUChar *)(pattern + pattern_len),
                      ONIG_OPTION_NONE,
                      ONIG_ENCODING_UTF8,
                      ONIG_SYNTAX_ONIGURUMA,
                      &err_info);
-    
-    if (r != ONIG_NORMAL) {
-        Py_DECREF(self);
-        raise_onig_error(module, r, &err_info);
-        return NULL;
+        Py_END_ALLOW_THREADS
+        PROBE4(compile, (uintptr_t)(r == ONIG_NORMAL ? regex : NULL), pattern_len, r,
+               PROBE_ELAPSED(began));
+        
+        if (r != ONIG_NORMAL) {
+            Py_DECREF(key);
+            Py_DECREF(self);
+            raise_onig_error(module, r, &err_info);
+            return NULL;
+        }
+        STATS_ADD(compiles, 1);
+        
+        self->shared = shared_regex_register(key, regex);
+        if (self->shared == NULL) {
+            Py_DECREF(key);
+            Py_DECREF(self);
+            return NULL;
+        }
     }
+    Py_DECREF(key);
+    self->regex = self->shared->regex;
     
     return (PyObject *)self;
 }
 
 static PyObject *
-pyonig_compile_regset(PyObject *module, PyObject *args)
+pyonig_compile_regset(PyObject *module, PyObject *args, PyObject *kwargs)
 {
     Py_ssize_t num_patterns = PyTuple_Size(args);
     if (num_patterns < 0) {
         return NULL;
     }
     
+    int count_retries = 0;
+    if (kwargs != NULL) {
+        static char *kwlist[] = {"count_retries", NULL};
+        PyObject *no_args = PyTuple_New(0);
+        if (no_args == NULL) {
+            return NULL;
+        }
+        int parsed = PyArg_ParseTupleAndKeywords(no_args, kwargs, "|$p", kwlist, &count_retries);
+        Py_DECREF(no_args);
+        if (!parsed) {
+            return NULL;
+        }
+    }
+    
     /* Handle empty regset - create a regset that never matches */
     if (num_patterns == 0) {
         PyOnig_RegSet *self = PyObject_New(PyOnig_RegSet, &PyOnig_RegSetType);
@@ -687,99 +1229,604 @@ pyonig_compile_regset(PyObject *module, PyObject *args)
         self->patterns = args;
         Py_INCREF(args);
         self->num_patterns = 0;
+        self->lock = NULL;
+        self->count_retries = count_retries;
+        self->match_params = NULL;
+        self->retries = NULL;
         return (PyObject *)self;
     }
     
-    /* Compile individual regexes */
-    regex_t **regs = PyMem_Malloc(sizeof(regex_t *) * num_patterns);
-    if (regs == NULL) {
-        return PyErr_NoMemory();
-    }
-    
-    for (Py_ssize_t i = 0; i < num_patterns; i++) {
-        PyObject *pattern_obj = PyTuple_GetItem(args, i);
-        if (!PyUnicode_Check(pattern_obj)) {
-            for (Py_ssize_t j = 0; j < i; j++) {
-                onig_free(regs[j]);
+    /* The registry keys and sources, the patterns or their retry counting form */
+    PyObject *keys = args;
+    Py_INCREF(keys);
+    if (count_retries) {
+        Py_SETREF(keys, PyTuple_New(num_patterns));
+        for (Py_ssize_t i = 0; keys != NULL && i < num_patterns; i++) {
+            PyObject *pattern_obj = PyTuple_GET_ITEM(args, i);
+            PyObject *key = NULL;
+            if (!PyUnicode_Check(pattern_obj)) {
+                PyErr_SetString(PyExc_TypeError, "All patterns must be strings");
+            } else {
+                key = retry_counting_source(pattern_obj);
             }
-            PyMem_Free(regs);
-            PyErr_SetString(PyExc_TypeError, "All patterns must be strings");
-            return NULL;
-        }
-        
-        const char *pattern = PyUnicode_AsUTF8(pattern_obj);
-        if (pattern == NULL) {
-            for (Py_ssize_t j = 0; j < i; j++) {
-                onig_free(regs[j]);
+            if (key == NULL) {
+                Py_CLEAR(keys);
+                break;
             }
-            PyMem_Free(regs);
-            return NULL;
+            PyTuple_SET_ITEM(keys, i, key);
         }
-        
-        Py_ssize_t pattern_len = strlen(pattern);
-        OnigErrorInfo err_info;
-        
-        int r = onig_new(&regs[i],
-                         (const OnigUChar *)pattern,
-                         (const OnigUChar *)(pattern + pattern_len),
-                         ONIG_OPTION_NONE,
-                         ONIG_ENCODING_UTF8,
-                         ONIG_SYNTAX_ONIGURUMA,
-                         &err_info);
-        
-        if (r != ONIG_NORMAL) {
-            for (Py_ssize_t j = 0; j < i; j++) {
-                onig_free(regs[j]);
-            }
-            PyMem_Free(regs);
-            raise_onig_error(module, r, &err_info);
+        if (keys == NULL) {
             return NULL;
         }
     }
     
-    /* Create regset */
+    /* Collect the UTF-8 sources, they stay alive in keys, and any
+     * already compiled */
+    regex_t **regs = PyMem_Calloc(num_patterns, sizeof(regex_t *));
+    shared_regex **shared = PyMem_Calloc(num_patterns, sizeof(shared_regex *));
+    const char **sources = PyMem_Malloc(sizeof(const char *) * num_patterns);
+    Py_ssize_t *lengths = PyMem_Malloc(sizeof(Py_ssize_t) * num_patterns);
+    if (regs == NULL || shared == NULL || sources == NULL || lengths == NULL) {
+        PyMem_Free(regs);
+        PyMem_Free(shared);
+        PyMem_Free(sources);
+        PyMem_Free(lengths);
+        Py_DECREF(keys);
+        return PyErr_NoMemory();
+    }
+    
     PyOnig_RegSet *self = PyObject_New(PyOnig_RegSet, &PyOnig_RegSetType);
     if (self == NULL) {
-        for (Py_ssize_t i = 0; i < num_patterns; i++) {
-            onig_free(regs[i]);
-        }
         PyMem_Free(regs);
+        PyMem_Free(shared);
+        PyMem_Free(sources);
+        PyMem_Free(lengths);
+        Py_DECREF(keys);
         return NULL;
     }
     
+    /* The regset releases the shared regexes it holds when deallocated */
     self->regset = NULL;
-    self->regexes = NULL;
+    self->regexes = shared;
     self->patterns = NULL;
-    self->num_patterns = 0;
+    self->num_patterns = (int)num_patterns;
+    self->lock = NULL;
+    self->count_retries = count_retries;
+    self->match_params = NULL;
+    self->retries = NULL;
+    
+    Py_ssize_t collected = 0;
+    for (; collected < num_patterns; collected++) {
+        PyObject *pattern_obj = PyTuple_GET_ITEM(keys, collected);
+        if (!PyUnicode_Check(pattern_obj)) {
+            PyErr_SetString(PyExc_TypeError, "All patterns must be strings");
+            break;
+        }
+        sources[collected] = PyUnicode_AsUTF8AndSize(pattern_obj, &lengths[collected]);
+        if (sources[collected] == NULL) {
+            break;
+        }
+        shared[collected] = shared_regex_lookup(pattern_obj);
+        if (shared[collected] == NULL && PyErr_Occurred()) {
+            break;
+        }
+    }
+    if (collected < num_patterns) {
+        PyMem_Free(regs);
+        PyMem_Free(sources);
+        PyMem_Free(lengths);
+        Py_DECREF(keys);
+        Py_DECREF(self);
+        return NULL;
+    }
     
-    int r = onig_regset_new(&self->regset, num_patterns, regs);
+    /* Compile the new regexes without the GIL */
+    OnigErrorInfo err_info;
+    int r = ONIG_NORMAL;
+    Py_BEGIN_ALLOW_THREADS
+    for (Py_ssize_t i = 0; i < num_patterns; i++) {
+        if (shared[i] != NULL) {
+            continue;
+        }
+        unsigned long long began = PROBE_BEGIN(compile);
+        r = onig_new(&regs[i],
+                     (const OnigUChar *)sources[i],
+                     (const OnigUChar *)(sources[i] + lengths[i]),
+                     ONIG_OPTION_NONE,
+                     ONIG_ENCODING_UTF8,
+                     ONIG_SYNTAX_ONIGURUMA,
+                     &err_info);
+        PROBE4(compile, (uintptr_t)(r == ONIG_NORMAL ? regs[i] : NULL), lengths[i], r,
+               PROBE_ELAPSED(began));
+        if (r != ONIG_NORMAL) {
+            regs[i] = NULL;
+            break;
+        }
+        STATS_ADD(compiles, 1);
+    }
+    Py_END_ALLOW_THREADS
     
-    if (r != ONIG_NORMAL) {
-        /* Clean up on error */
-        for (Py_ssize_t i = 0; i < num_patterns; i++) {
+    PyMem_Free(sources);
+    PyMem_Free(lengths);
+    
+    /* Register the new regexes, the registry owns them from here */
+    int registered = r == ONIG_NORMAL;
+    for (Py_ssize_t i = 0; i < num_patterns; i++) {
+        if (regs[i] == NULL || shared[i] != NULL) {
+            continue;
+        }
+        if (registered) {
+            shared[i] = shared_regex_register(PyTuple_GET_ITEM(keys, i), regs[i]);
+            registered = shared[i] != NULL;
+        } else {
             onig_free(regs[i]);
         }
+    }
+    Py_DECREF(keys);
+    if (!registered) {
         PyMem_Free(regs);
         Py_DECREF(self);
+        if (r != ONIG_NORMAL) {
+            raise_onig_error(module, r, &err_info);
+        }
+        return NULL;
+    }
+    
+    for (Py_ssize_t i = 0; i < num_patterns; i++) {
+        regs[i] = shared[i]->regex;
+    }
+    r = onig_regset_new(&self->regset, (int)num_patterns, regs);
+    PyMem_Free(regs);
+    if (r != ONIG_NORMAL) {
+        self->regset = NULL;
+        Py_DECREF(self);
         raise_onig_error(module, r, NULL);
         return NULL;
     }
     
-    /* Store the regexes array - regset needs these to stay alive */
-    self->regexes = regs;
     self->patterns = args;
     Py_INCREF(args);
-    self->num_patterns = (int)num_patterns;
+    
+    self->lock = PyThread_allocate_lock();
+    if (self->lock == NULL) {
+        Py_DECREF(self);
+        return PyErr_NoMemory();
+    }
+    
+    if (count_retries) {
+        self->retries = PyMem_Calloc(num_patterns, sizeof(unsigned long long));
+        self->match_params = PyMem_Calloc(num_patterns, sizeof(OnigMatchParam *));
+        if (self->retries == NULL || self->match_params == NULL) {
+            Py_DECREF(self);
+            return PyErr_NoMemory();
+        }
+        for (Py_ssize_t i = 0; i < num_patterns; i++) {
+            self->match_params[i] = retry_match_param(&self->retries[i]);
+            if (self->match_params[i] == NULL) {
+                Py_DECREF(self);
+                return PyErr_NoMemory();
+            }
+        }
+    }
     
     return (PyObject *)self;
 }
 
+/* Line index
+ *
+ * Finds the start of every line of a buffer with memchr, which libc
+ * vectorizes, so multi-GB memory-mapped files can be indexed without
+ * creating a Python object per line.
+ */
+
+/* Count or record line starts in data, returns the number of starts */
+static Py_ssize_t
+scan_line_starts(const char *data, Py_ssize_t length, Py_ssize_t *starts)
+{
+    Py_ssize_t count = 0;
+    const char *pos = data;
+    const char *end = data + length;
+    if (length == 0) {
+        return 0;
+    }
+    if (starts != NULL) {
+        starts[count] = 0;
+    }
+    count++;
+    while (pos < end) {
+        const char *newline = memchr(pos, '\n', (size_t)(end - pos));
+        if (newline == NULL || newline + 1 == end) {
+            break;
+        }
+        if (starts != NULL) {
+            starts[count] = newline + 1 - data;
+        }
+        count++;
+        pos = newline + 1;
+    }
+    return count;
+}
+
+static PyObject *
+pyonig_line_index(PyObject *module, PyObject *arg)
+{
+    Py_buffer view;
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0) {
+        return NULL;
+    }
+
+    Py_ssize_t count;
+    Py_BEGIN_ALLOW_THREADS
+    count = scan_line_starts(view.buf, view.len, NULL);
+    Py_END_ALLOW_THREADS
+
+    /* One start per line plus the end of the buffer */
+    PyObject *index = PyBytes_FromStringAndSize(NULL, (count + 1) * (Py_ssize_t)sizeof(Py_ssize_t));
+    if (index == NULL) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    Py_ssize_t *starts = (Py_ssize_t *)PyBytes_AS_STRING(index);
+
+    Py_BEGIN_ALLOW_THREADS
+    scan_line_starts(view.buf, view.len, starts);
+    Py_END_ALLOW_THREADS
+
+    starts[count] = view.len;
+    PyBuffer_Release(&view);
+    return index;
+}
+
+/* ANSI SGR parsing
+ *
+ * Converts text carrying ANSI escape sequences into curses line parts in a
+ * single pass over the whole document.  SGR state (color and attributes)
+ * carries across text and lines the way it does on a terminal, other CSI
+ * sequences are dropped.
+ */
+
+#define SGR_MAX_PARAMS 32
+#define SGR_MAX_ATTRS 9
+
+typedef struct {
+    long color;
+    unsigned int attrs;
+} sgr_state;
+
+/* Round a non-negative value, integer channels never land on a tie */
+#define SGR_ROUND(value) ((long)((value) + 0.5))
+
+/* Map a 24-bit color onto the xterm 256 color cube or gray ramp */
+static long
+sgr_rgb_to_256(long red, long green, long blue)
+{
+    if (red == green && green == blue) {
+        if (red < 8) {
+            return 16;
+        }
+        if (red > 248) {
+            return 231;
+        }
+        return SGR_ROUND(((red - 8) / 247.0) * 24) + 232;
+    }
+    return 16
+        + 36 * SGR_ROUND(red / 255.0 * 5)
+        + 6 * SGR_ROUND(green / 255.0 * 5)
+        + SGR_ROUND(blue / 255.0 * 5);
+}
+
+/* Parse an extended color (5;n or 2;r;g;b) following a 38 or 48,
+ * returns the number of parameters consumed */
+static int
+sgr_extended_color(const long *params, int count, long *color)
+{
+    if (count >= 2 && params[0] == 5) {
+        *color = params[1] < 0 ? 0 : (params[1] > 255 ? 255 : params[1]);
+        return 2;
+    }
+    if (count >= 4 && params[0] == 2) {
+        long rgb[3];
+        for (int i = 0; i < 3; i++) {
+            rgb[i] = params[i + 1] < 0 ? 0 : (params[i + 1] > 255 ? 255 : params[i + 1]);
+        }
+        *color = sgr_rgb_to_256(rgb[0], rgb[1], rgb[2]);
+        return 4;
+    }
+    return count;
+}
+
+static void
+sgr_apply(sgr_state *state, const long *params, int count)
+{
+    if (count == 0) {
+        state->color = 0;
+        state->attrs = 0;
+        return;
+    }
+    for (int i = 0; i < count; i++) {
+        long code = params[i];
+        long ignored;
+        if (code == 0) {
+            state->color = 0;
+            state->attrs = 0;
+        } else if (code >= 1 && code <= 8) {
+            state->attrs |= 1u << code;
+        } else if (code == 21 || code == 22) {
+            state->attrs &= ~((1u << 1) | (1u << 2));
+        } else if (code == 23) {
+            state->attrs &= ~(1u << 3);
+        } else if (code == 24) {
+            state->attrs &= ~(1u << 4);
+        } else if (code == 25) {
+            state->attrs &= ~((1u << 5) | (1u << 6));
+        } else if (code == 27) {
+            state->attrs &= ~(1u << 7);
+        } else if (code == 28) {
+            state->attrs &= ~(1u << 8);
+        } else if (code >= 30 && code <= 37) {
+            state->color = code - 30;
+        } else if (code >= 90 && code <= 97) {
+            state->color = code - 90 + 8;
+        } else if (code == 39) {
+            state->color = 0;
+        } else if (code == 38) {
+            i += sgr_extended_color(params + i + 1, count - i - 1, &state->color);
+        } else if (code == 48) {
+            /* Curses parts carry no background, consume and ignore it */
+            i += sgr_extended_color(params + i + 1, count - i - 1, &ignored);
+        }
+    }
+}
+
+/* Build one part, a (column, string, color, decoration) tuple of part_type */
+static PyObject *
+sgr_make_part(PyTypeObject *part_type, Py_ssize_t column, PyObject *string,
+              long color, long decoration)
+{
+    PyObject *part = part_type->tp_alloc(part_type, 4);
+    if (part == NULL) {
+        Py_DECREF(string);
+        return NULL;
+    }
+    PyObject *items[3] = {
+        PyLong_FromSsize_t(column),
+        PyLong_FromLong(color),
+        PyLong_FromLong(decoration),
+    };
+    if (items[0] == NULL || items[1] == NULL || items[2] == NULL) {
+        Py_XDECREF(items[0]);
+        Py_XDECREF(items[1]);
+        Py_XDECREF(items[2]);
+        Py_DECREF(string);
+        Py_DECREF(part);
+        return NULL;
+    }
+    PyTuple_SET_ITEM(part, 0, items[0]);
+    PyTuple_SET_ITEM(part, 1, string);
+    PyTuple_SET_ITEM(part, 2, items[1]);
+    PyTuple_SET_ITEM(part, 3, items[2]);
+    return part;
+}
+
+/* Append the text doc[start:end] as a part of line, advancing the column */
+static int
+sgr_flush(PyObject *line, PyObject *doc, Py_ssize_t start, Py_ssize_t end,
+          Py_ssize_t *column, const sgr_state *state, const long *decorations,
+          PyTypeObject *part_type)
+{
+    if (end <= start) {
+        return 0;
+    }
+    long decoration = 0;
+    for (int bit = 1; bit <= SGR_MAX_ATTRS; bit++) {
+        if (state->attrs & (1u << bit)) {
+            decoration |= decorations[bit];
+        }
+    }
+    PyObject *string = PyUnicode_Substring(doc, start, end);
+    if (string == NULL) {
+        return -1;
+    }
+    PyObject *part = sgr_make_part(part_type, *column, string, state->color, decoration);
+    if (part == NULL) {
+        return -1;
+    }
+    int r = PyList_Append(line, part);
+    Py_DECREF(part);
+    *column += end - start;
+    return r;
+}
+
+/* Finish a line, an empty line becomes a single empty part */
+static int
+sgr_end_line(PyObject *lines, PyObject *line, int empty, PyTypeObject *part_type)
+{
+    PyObject *parts;
+    if (empty) {
+        PyObject *string = PyUnicode_FromStringAndSize("", 0);
+        if (string == NULL) {
+            return -1;
+        }
+        PyObject *part = sgr_make_part(part_type, 0, string, 0, 0);
+        if (part == NULL) {
+            return -1;
+        }
+        parts = PyTuple_Pack(1, part);
+        Py_DECREF(part);
+    } else {
+        parts = PyList_AsTuple(line);
+    }
+    if (parts == NULL) {
+        return -1;
+    }
+    int r = PyList_Append(lines, parts);
+    Py_DECREF(parts);
+    return r;
+}
+
+static PyObject *
+pyonig_sgr_to_curses(PyObject *module, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"doc", "part_type", "decorations", "split_lines", NULL};
+    PyObject *doc;
+    PyTypeObject *part_type;
+    PyObject *decorations_obj;
+    int split_lines = 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "UO!O|p", kwlist,
+                                     &doc, &PyType_Type, &part_type,
+                                     &decorations_obj, &split_lines)) {
+        return NULL;
+    }
+    if (!PyType_IsSubtype(part_type, &PyTuple_Type) || part_type == &PyTuple_Type) {
+        PyErr_SetString(PyExc_TypeError, "part_type must be a tuple subclass");
+        return NULL;
+    }
+
+    /* Curses decoration for each SGR attribute code */
+    long decorations[SGR_MAX_ATTRS + 1] = {0};
+    PyObject *seq = PySequence_Fast(decorations_obj, "decorations must be a sequence");
+    if (seq == NULL) {
+        return NULL;
+    }
+    Py_ssize_t num_decorations = PySequence_Fast_GET_SIZE(seq);
+    for (Py_ssize_t i = 0; i < num_decorations && i <= SGR_MAX_ATTRS; i++) {
+        PyObject *item = PySequence_Fast_GET_ITEM(seq, i);
+        if (item != Py_None) {
+            decorations[i] = PyLong_AsLong(item);
+            if (decorations[i] == -1 && PyErr_Occurred()) {
+                Py_DECREF(seq);
+                return NULL;
+            }
+        }
+    }
+    Py_DECREF(seq);
+
+    int kind = PyUnicode_KIND(doc);
+    const void *data = PyUnicode_DATA(doc);
+    Py_ssize_t length = PyUnicode_GET_LENGTH(doc);
+
+    PyObject *lines = PyList_New(0);
+    PyObject *line = PyList_New(0);
+    if (lines == NULL || line == NULL) {
+        goto error;
+    }
+
+    sgr_state state = {0, 0};
+    Py_ssize_t line_start = 0;
+    Py_ssize_t text_start = 0;
+    Py_ssize_t column = 0;
+    Py_ssize_t i = 0;
+
+    while (i < length) {
+        Py_UCS4 ch = PyUnicode_READ(kind, data, i);
+
+        if (ch == 0x1b && i + 1 < length && PyUnicode_READ(kind, data, i + 1) == '[') {
+            /* Control Sequence Introducer: parameters, intermediates, final byte */
+            long params[SGR_MAX_PARAMS];
+            int count = 0;
+            int has_digit = 0;
+            int plain = 1;
+            long value = 0;
+            Py_ssize_t j = i + 2;
+            Py_UCS4 final = 0;
+            for (; j < length; j++) {
+                Py_UCS4 c = PyUnicode_READ(kind, data, j);
+                if (c >= '0' && c <= '9') {
+                    if (value < 100000) {
+                        value = value * 10 + (long)(c - '0');
+                    }
+                    has_digit = 1;
+                } else if (c == ';' || c == ':') {
+                    if (count < SGR_MAX_PARAMS) {
+                        params[count++] = value;
+                    }
+                    value = 0;
+                    has_digit = 0;
+                } else if (c >= 0x3c && c <= 0x3f) {
+                    plain = 0;  /* private parameter marker */
+                } else if (c >= 0x20 && c <= 0x2f) {
+                    plain = 0;  /* intermediate byte */
+                } else if (c >= 0x40 && c <= 0x7e) {
+                    final = c;
+                    break;
+                } else {
+                    break;
+                }
+            }
+            if (final == 0) {
+                /* Not a complete sequence, keep it as text */
+                i++;
+                continue;
+            }
+            if (sgr_flush(line, doc, text_start, i, &column, &state,
+                          decorations, part_type) < 0) {
+                goto error;
+            }
+            if (final == 'm' && plain) {
+                if ((has_digit || count > 0) && count < SGR_MAX_PARAMS) {
+                    params[count++] = value;
+                }
+                sgr_apply(&state, params, count);
+            }
+            i = j + 1;
+            text_start = i;
+            continue;
+        }
+
+        if (split_lines && Py_UNICODE_ISLINEBREAK(ch)) {
+            if (sgr_flush(line, doc, text_start, i, &column, &state,
+                          decorations, part_type) < 0
+                || sgr_end_line(lines, line, i == line_start, part_type) < 0) {
+                goto error;
+            }
+            Py_SETREF(line, PyList_New(0));
+            if (line == NULL) {
+                goto error;
+            }
+            if (ch == '\r' && i + 1 < length && PyUnicode_READ(kind, data, i + 1) == '\n') {
+                i++;
+            }
+            i++;
+            line_start = text_start = i;
+            column = 0;
+            continue;
+        }
+        i++;
+    }
+
+    if (!split_lines || line_start < length) {
+        if (sgr_flush(line, doc, text_start, length, &column, &state,
+                      decorations, part_type) < 0
+            || sgr_end_line(lines, line, line_start == length, part_type) < 0) {
+            goto error;
+        }
+    }
+    Py_DECREF(line);
+    Py_SETREF(lines, PyList_AsTuple(lines));
+    return lines;
+
+error:
+    Py_XDECREF(line);
+    Py_XDECREF(lines);
+    return NULL;
+}
+
 /* Module definition */
 static PyMethodDef pyonig_methods[] = {
-    {"compile", pyonig_compile, METH_VARARGS,
+    {"compile", (PyCFunction)pyonig_compile, METH_VARARGS | METH_KEYWORDS,
      "Compile a regex pattern"},
-    {"compile_regset", pyonig_compile_regset, METH_VARARGS,
+    {"compile_regset", (PyCFunction)pyonig_compile_regset, METH_VARARGS | METH_KEYWORDS,
      "Compile a set of regex patterns"},
+    {"sgr_to_curses", (PyCFunction)pyonig_sgr_to_curses,
+     METH_VARARGS | METH_KEYWORDS,
+     "Convert text with ANSI SGR sequences into lines of curses parts"},
+    {"line_index", pyonig_line_index, METH_O,
+     "Index the start offset of every line of a buffer"},
+    {"shared_regex_count", pyonig_shared_regex_count, METH_NOARGS,
+     "Count the compiled regexes shared by patterns and regsets"},
+    {"stats", pyonig_stats, METH_NOARGS,
+     "Get the process wide search and compile counters"},
     {NULL}
 };
 
@@ -796,6 +1843,13 @@ pyonig_exec(PyObject *module)
         return -1;
     }
     
+    if (regex_registry == NULL) {
+        regex_registry = PyDict_New();
+        if (regex_registry == NULL) {
+            return -1;
+        }
+    }
+    
     /* Create exception type */
     state->OnigError = PyErr_NewException("pyonig.OnigError", PyExc_RuntimeError, NULL);
     if (state->OnigError == NULL) {
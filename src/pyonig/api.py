@@ -1,13 +1,26 @@
 """Public API for pyonig library - syntax highlighting for Python applications."""
 from __future__ import annotations
 
+import functools
+import itertools
 import os
+import time
 from pathlib import Path
-from typing import Literal, Optional, Union
+from typing import TYPE_CHECKING, AsyncIterator, BinaryIO, Iterable, Iterator, Literal, Optional, Union
 
 from pyonig.colorize import Colorize, rgb_to_ansi
 from pyonig.detect import detect_scope
+from pyonig.follow import DEFAULT_POLL_INTERVAL, follow_lines, stream_lines
+from pyonig.mapped import MappedLines
+from pyonig.metrics import COUNTERS
 from pyonig.theme import ThemeManager
+from pyonig.tm_tokenize.grammars import Grammars
+from pyonig.trace import TRACES, add_span, span
+
+# asyncio and concurrent.futures are imported where used, most highlighting
+# never needs them and they dominate the import time
+if TYPE_CHECKING:
+    from concurrent.futures import Executor
 
 
 # Language to scope mapping
@@ -33,6 +46,10 @@ LANG_TO_SCOPE = {
     "python": "source.python",
 }
 
+# Number of lines highlighted between yields to the event loop when the
+# async API runs inline on the loop
+YIELD_EVERY = 64
+
 
 def detect_language(filename: Optional[str] = None, content: Optional[bytes] = None) -> Optional[str]:
     """Detect language from filename extension or content.
@@ -68,20 +85,164 @@ def render_to_ansi(colorized: list[list], colors: int = 256) -> str:
     Returns:
         String with ANSI color codes
     """
-    lines = []
-    for line_parts in colorized:
-        line = ""
-        for part in line_parts:
-            text = part.chars
-            if part.color:
-                # Convert RGB to ANSI
-                r, g, b = part.color
-                ansi_color = rgb_to_ansi(r, g, b, colors)
-                line += f"\033[38;5;{ansi_color}m{text}\033[0m"
-            else:
-                line += text
-        lines.append(line.rstrip('\n'))
-    return '\n'.join(lines)
+    began = time.perf_counter_ns()
+    rendered = '\n'.join(render_line_to_ansi(line_parts, colors) for line_parts in colorized)
+    COUNTERS.add(render_ns=time.perf_counter_ns() - began)
+    if TRACES:
+        add_span("render", began, lines=len(colorized))
+    return rendered
+
+
+def render_line_to_ansi(line_parts: list, colors: int = 256) -> str:
+    """Convert one colorized line to ANSI escape sequences.
+    
+    Args:
+        line_parts: One line from Colorize.render()
+        colors: Number of terminal colors (8, 16, or 256)
+    
+    Returns:
+        String with ANSI color codes, without the trailing newline
+    """
+    line = ""
+    for part in line_parts:
+        text = part.chars
+        if part.color:
+            # Convert RGB to ANSI
+            r, g, b = part.color
+            ansi_color = rgb_to_ansi(r, g, b, colors)
+            line += f"\033[38;5;{ansi_color}m{text}\033[0m"
+        else:
+            line += text
+    return line.rstrip('\n')
+
+
+def _render_lines(lines: Iterable[list], output: str, colors: int) -> Iterator[Union[str, list]]:
+    """Pass on colorized lines, converted to ANSI unless output is 'simple'.
+    
+    The conversion is timed per line and counted once the lines stop
+    being consumed.
+    """
+    if output == 'simple':
+        yield from lines
+        return
+    render_ns = 0
+    try:
+        for line_parts in lines:
+            began = time.perf_counter_ns()
+            line = render_line_to_ansi(line_parts, colors)
+            render_ns += time.perf_counter_ns() - began
+            if TRACES:
+                add_span("render", began)
+            yield line
+    finally:
+        COUNTERS.add(render_ns=render_ns)
+
+
+def _render_ansi_bytes(
+    colorizer: Colorize,
+    lines: Iterable[bytes],
+    scope: str,
+    colors: int,
+) -> Iterator[bytes]:
+    """Highlight UTF-8 lines to ANSI without decoding them.
+    
+    The bytes counterpart of render_line_to_ansi(), producing the same
+    output encoded as UTF-8.  Escape sequences are built once per style.
+    
+    Yields:
+        Each line as bytes with ANSI escape codes, without the trailing newline
+    """
+    palette = colorizer.schema.palette
+    prefixes: dict[int, bytes] = {}
+    render_ns = 0
+    try:
+        for line, runs in colorizer.iter_style_runs(lines, scope):
+            began = time.perf_counter_ns()
+            out = []
+            for start, end, style_id in runs:
+                prefix = prefixes.get(style_id)
+                if prefix is None:
+                    color = palette[style_id].color
+                    prefix = b"\033[38;5;%dm" % rgb_to_ansi(*color, colors) if color else b""
+                    prefixes[style_id] = prefix
+                if prefix:
+                    out += (prefix, line[start:end], b"\033[0m")
+                else:
+                    out.append(line[start:end])
+            rendered = b"".join(out).rstrip(b"\n")
+            render_ns += time.perf_counter_ns() - began
+            if TRACES:
+                add_span("render", began)
+            yield rendered
+    finally:
+        COUNTERS.add(render_ns=render_ns)
+
+
+def _decode(content: Union[str, bytes]) -> tuple[str, bytes]:
+    """Get both the text and UTF-8 bytes of some content.
+    
+    Raises:
+        ValueError: If bytes content is not valid UTF-8
+    """
+    if isinstance(content, bytes):
+        try:
+            return content.decode('utf-8'), content
+        except UnicodeDecodeError as e:
+            raise ValueError(f"Content is not valid UTF-8: {e}")
+    return content, content.encode('utf-8')
+
+
+def _resolve_scope(language: Optional[str], content_bytes: bytes) -> str:
+    """Resolve a language alias or scope, detecting it from content if needed.
+    
+    Raises:
+        ValueError: If language cannot be detected
+    """
+    # Detect language if not provided
+    if language is None:
+        with span("detect"):
+            language = detect_language(content=content_bytes)
+        if not language:
+            raise ValueError(
+                "Could not auto-detect language. "
+                "Please specify language explicitly via the 'language' parameter."
+            )
+    
+    # Resolve language alias to scope, otherwise assume it's already a scope name
+    return LANG_TO_SCOPE.get(language, language)
+
+
+def _grammars() -> Grammars:
+    """Create a grammar registry for the bundled grammars."""
+    return Grammars(os.path.join(os.path.dirname(__file__), 'grammars'))
+
+
+def _colorizer(theme: Optional[str]) -> Colorize:
+    """Create a colorizer for the bundled grammars and a theme.
+    
+    Raises:
+        ValueError: If theme not found or cannot be loaded
+    """
+    with span("theme"):
+        theme_manager = ThemeManager()
+        if theme is None:
+            theme = theme_manager.get_default()
+        
+        # Find theme path
+        theme_path = theme_manager.find_path(theme)
+        if theme_path is None:
+            raise ValueError(
+                f"Theme not found: {theme}\n"
+                f"Available themes: {[t[0] for t in theme_manager.list_themes()]}"
+            )
+        
+        # Get grammar directory
+        grammar_dir = os.path.join(os.path.dirname(__file__), 'grammars')
+        
+        try:
+            return Colorize(grammar_dir=grammar_dir, theme_path=str(theme_path))
+        except Exception as e:
+            raise ValueError(f"Error highlighting content: {e}")
 
 
 def highlight(
@@ -90,6 +251,7 @@ def highlight(
     theme: Optional[str] = None,
     output: Literal['simple', 'ansi'] = 'ansi',
     colors: int = 256,
+    cache: bool = True,
 ) -> Union[str, list]:
     """Highlight source code with syntax highlighting.
     
@@ -103,6 +265,8 @@ def highlight(
               If None, uses default (PYONIG_THEME env var, VS Code settings, or 'dark')
         output: Output format - 'ansi' for terminal or 'simple' for structured data
         colors: Number of terminal colors for ANSI output (8, 16, or 256)
+        cache: Keep the rendered document in the shared render cache,
+              pass False for one-shot documents
     
     Returns:
         - If output='ansi': String with ANSI escape codes
@@ -127,61 +291,93 @@ def highlight(
         >>> result = pyonig.highlight(code, output='simple')
         >>> # result is list of lists of SimpleLinePart objects
     """
-    # Convert bytes to string if needed
-    if isinstance(content, bytes):
-        content_bytes = content
+    with span("highlight"):
+        text, content_bytes = _decode(content)
+        scope = _resolve_scope(language, content_bytes)
+        colorizer = _colorizer(theme)
+        
+        # Render
         try:
-            text = content.decode('utf-8')
-        except UnicodeDecodeError as e:
-            raise ValueError(f"Content is not valid UTF-8: {e}")
-    else:
-        text = content
-        content_bytes = content.encode('utf-8')
+            colorized = colorizer.render(text, scope, cache=cache)
+        except Exception as e:
+            raise ValueError(f"Error highlighting content: {e}")
+        
+        # Return in requested format
+        if output == 'simple':
+            return colorized
+        else:  # output == 'ansi'
+            return render_to_ansi(colorized, colors)
+
+
+def highlight_many(
+    snippets: Iterable[Union[str, bytes]],
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    output: Literal['simple', 'ansi'] = 'ansi',
+    colors: int = 256,
+    cache: bool = True,
+    max_workers: Optional[int] = None,
+) -> list:
+    """Highlight many small snippets of the same language and theme.
     
-    # Detect language if not provided
-    if language is None:
-        language = detect_language(content=content_bytes)
-        if not language:
-            raise ValueError(
-                "Could not auto-detect language. "
-                "Please specify language explicitly via the 'language' parameter."
-            )
+    The theme, colorizer and grammar are set up once and the snippets are
+    then rendered back to back, each giving the same result as highlight()
+    without paying its setup per snippet.
     
-    # Resolve language alias to scope
-    if language in LANG_TO_SCOPE:
-        scope = LANG_TO_SCOPE[language]
-    else:
-        # Assume it's already a scope name
-        scope = language
-    
-    # Get theme
-    theme_manager = ThemeManager()
-    if theme is None:
-        theme = theme_manager.get_default()
-    
-    # Find theme path
-    theme_path = theme_manager.find_path(theme)
-    if theme_path is None:
-        raise ValueError(
-            f"Theme not found: {theme}\n"
-            f"Available themes: {[t[0] for t in theme_manager.list_themes()]}"
-        )
+    Args:
+        snippets: The snippets, as strings or bytes
+        language: Language/scope name shared by all snippets, if None it
+                 is detected for each snippet
+        theme: Theme name, alias, or path to theme file
+        output: Output format - 'ansi' for terminal or 'simple' for structured data
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+        cache: Keep the rendered snippets in the shared render cache,
+              repeated snippets are then rendered once
+        max_workers: Split the snippets across this many threads, None
+                    to render them on the calling thread
     
-    # Get grammar directory
-    grammar_dir = os.path.join(os.path.dirname(__file__), 'grammars')
+    Returns:
+        The highlighted snippets, in the order given
     
-    # Create colorizer and render
-    try:
-        colorizer = Colorize(grammar_dir=grammar_dir, theme_path=str(theme_path))
-        colorized = colorizer.render(text, scope)
-    except Exception as e:
-        raise ValueError(f"Error highlighting content: {e}")
+    Raises:
+        ValueError: If language cannot be detected or theme not found
     
-    # Return in requested format
-    if output == 'simple':
-        return colorized
-    else:  # output == 'ansi'
-        return render_to_ansi(colorized, colors)
+    Example:
+        >>> cells = ['{"id": 1}', '{"id": 2}', '[true, null]']
+        >>> highlighted = pyonig.highlight_many(cells, language='json')
+    """
+    snippets = list(snippets)
+    scope = LANG_TO_SCOPE.get(language, language) if language is not None else None
+    colorizer = _colorizer(theme)
+    
+    def _one(content: Union[str, bytes]) -> Union[str, list]:
+        with span("highlight"):
+            if scope is None or isinstance(content, bytes):
+                text, content_bytes = _decode(content)
+                snippet_scope = scope or _resolve_scope(None, content_bytes)
+            else:
+                text, snippet_scope = content, scope
+            try:
+                colorized = colorizer.render(text, snippet_scope, cache=cache)
+            except Exception as e:
+                raise ValueError(f"Error highlighting content: {e}")
+            if output == 'simple':
+                return colorized
+            return render_to_ansi(colorized, colors)
+    
+    def _batch(batch: list) -> list:
+        return [_one(content) for content in batch]
+    
+    if not max_workers or max_workers < 2 or len(snippets) < 2:
+        return _batch(snippets)
+    
+    # One contiguous batch per thread keeps the per-task overhead out of
+    # the per-snippet cost
+    size = -(-len(snippets) // max_workers)
+    batches = [snippets[i:i + size] for i in range(0, len(snippets), size)]
+    from concurrent.futures import ThreadPoolExecutor
+    with ThreadPoolExecutor(max_workers=len(batches)) as pool:
+        return list(itertools.chain.from_iterable(pool.map(_batch, batches)))
 
 
 def highlight_file(
@@ -190,6 +386,7 @@ def highlight_file(
     theme: Optional[str] = None,
     output: Literal['simple', 'ansi'] = 'ansi',
     colors: int = 256,
+    cache: bool = True,
 ) -> Union[str, list]:
     """Highlight a source code file with syntax highlighting.
     
@@ -201,6 +398,7 @@ def highlight_file(
         theme: Theme name, alias, or path to theme file
         output: Output format - 'ansi' for terminal or 'simple' for structured data
         colors: Number of terminal colors for ANSI output (8, 16, or 256)
+        cache: Keep the rendered document in the shared render cache
     
     Returns:
         - If output='ansi': String with ANSI escape codes
@@ -218,32 +416,449 @@ def highlight_file(
         >>> # Auto-detect from filename
         >>> highlighted = pyonig.highlight_file('app.py')  # Detects Python
     """
+    content_bytes = _read_file(path)
+    
+    # Detect language from filename if not provided
+    if language is None:
+        language = detect_language(filename=str(path), content=content_bytes)
+    
+    # Use highlight() with the content
+    return highlight(
+        content=content_bytes,
+        language=language,
+        theme=theme,
+        output=output,
+        colors=colors,
+        cache=cache,
+    )
+
+
+def highlight_file_lines(
+    path: Union[str, Path],
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    output: Literal['simple', 'ansi'] = 'ansi',
+    colors: int = 256,
+) -> Iterator[Union[str, list]]:
+    """Highlight a large file, producing rendered lines as they are ready.
+    
+    The file is memory-mapped and indexed by a native newline scan instead of
+    being read and decoded as a whole, and each line is decoded only when it
+    is tokenized.  Memory use stays at the line index (8 bytes per line) plus
+    the line being highlighted, however large the file.  Invalid UTF-8 is
+    replaced rather than rejected.
+    
+    Args:
+        path: Path to source code file
+        language: Language/scope name (if None, detects from filename and content)
+        theme: Theme name, alias, or path to theme file
+        output: Output format - 'ansi' for terminal or 'simple' for structured data
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+    
+    Yields:
+        - If output='ansi': Each line as a string with ANSI escape codes
+        - If output='simple': Each line as a list of SimpleLinePart objects
+    
+    Raises:
+        FileNotFoundError: If file doesn't exist
+        ValueError: If language cannot be detected or theme not found
+    
+    Example:
+        >>> for line in pyonig.highlight_file_lines('/var/log/huge.log'):
+        ...     sys.stdout.write(line + '\n')
+    """
+    path = Path(path)
+    if not path.exists():
+        raise FileNotFoundError(f"File not found: {path}")
+    
+    with MappedLines(path) as lines:
+        head = lines.head()
+        if language is None:
+            language = detect_language(filename=str(path), content=head)
+        scope = _resolve_scope(language, head)
+        colorizer = _colorizer(theme)
+        yield from _render_lines(colorizer.iter_render(lines, scope), output, colors)
+
+
+def highlight_bytes(
+    content: bytes,
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    colors: int = 256,
+) -> bytes:
+    """Highlight UTF-8 source code to ANSI bytes, without decoding it.
+    
+    Lines are tokenized as bytes so regex offsets are byte offsets end to
+    end, and the output is written as bytes.  The output is the UTF-8
+    encoding of highlight(output='ansi'), except that lines are split on
+    ``\\n``, ``\\r\\n`` and ``\\r`` only, and markdown is not cleaned up.
+    Invalid UTF-8 is replaced.
+    
+    Args:
+        content: Source code as UTF-8 bytes
+        language: Language/scope name, if None attempts auto-detection from content
+        theme: Theme name, alias, or path to theme file
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+    
+    Returns:
+        Bytes with ANSI escape codes
+    
+    Raises:
+        ValueError: If language cannot be detected or theme not found
+    
+    Example:
+        >>> sys.stdout.buffer.write(pyonig.highlight_bytes(data, language='json'))
+    """
+    scope = _resolve_scope(language, content)
+    colorizer = _colorizer(theme)
+    return b"\n".join(_render_ansi_bytes(colorizer, content.splitlines(), scope, colors))
+
+
+def highlight_file_bytes(
+    path: Union[str, Path],
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    colors: int = 256,
+) -> Iterator[bytes]:
+    """Highlight a large file to ANSI bytes, one line at a time.
+    
+    Combines the memory-mapped line access of highlight_file_lines() with
+    the bytes pipeline of highlight_bytes(): lines are copied out of the
+    mapping as bytes but never decoded or re-encoded.
+    
+    Args:
+        path: Path to source code file
+        language: Language/scope name (if None, detects from filename and content)
+        theme: Theme name, alias, or path to theme file
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+    
+    Yields:
+        Each line as bytes with ANSI escape codes, without the trailing newline
+    
+    Raises:
+        FileNotFoundError: If file doesn't exist
+        ValueError: If language cannot be detected or theme not found
+    """
+    path = Path(path)
+    if not path.exists():
+        raise FileNotFoundError(f"File not found: {path}")
+    
+    with MappedLines(path) as lines:
+        head = lines.head()
+        if language is None:
+            language = detect_language(filename=str(path), content=head)
+        scope = _resolve_scope(language, head)
+        colorizer = _colorizer(theme)
+        line_bytes = (bytes(lines.line_bytes(line_idx)) for line_idx in range(len(lines)))
+        yield from _render_ansi_bytes(colorizer, line_bytes, scope, colors)
+
+
+def highlight_follow(
+    source: Union[str, Path, BinaryIO],
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    colors: int = 256,
+    poll_interval: float = DEFAULT_POLL_INTERVAL,
+    idle_timeout: Optional[float] = None,
+) -> Iterator[bytes]:
+    """Highlight a live log, producing each line as soon as it is complete.
+    
+    A file is highlighted from the start and then followed as it grows,
+    through truncation and rotation, like ``tail -F``.  A stream, e.g. a
+    pipe, is read until it ends.  Tokenizer state carries from line to line,
+    so multi-line constructs are colored as in a complete file, and starts
+    afresh with a new file after truncation or rotation.
+    
+    Args:
+        source: Path to a file, or a binary stream such as ``sys.stdin.buffer``
+        language: Language/scope name, if None detected from the file name
+                 and start of the file, or the first line of a stream
+        theme: Theme name, alias, or path to theme file
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+        poll_interval: Seconds between checks at the end of a followed file
+        idle_timeout: Stop following a file after this many seconds without
+                     data, None to follow until the generator is closed
+    
+    Yields:
+        Each line as bytes with ANSI escape codes, without the trailing newline
+    
+    Raises:
+        FileNotFoundError: If file doesn't exist
+        ValueError: If language cannot be detected or theme not found
+    
+    Example:
+        >>> for line in pyonig.highlight_follow('/var/log/app.log', language='log'):
+        ...     sys.stdout.buffer.write(line + b'\n')
+        ...     sys.stdout.buffer.flush()
+    """
+    head = b''
+    if isinstance(source, (str, Path)):
+        path = Path(source)
+        if not path.exists():
+            raise FileNotFoundError(f"File not found: {path}")
+        lines: Iterator[Optional[bytes]] = follow_lines(path, poll_interval, idle_timeout)
+        if language is None:
+            with path.open('rb') as file:
+                head = file.read(2048)
+            language = detect_language(filename=str(path), content=head)
+    else:
+        lines = stream_lines(source)
+        if language is None:
+            head = next(lines, b'')
+            lines = itertools.chain((head,), lines)
+    scope = _resolve_scope(language, head)
+    colorizer = _colorizer(theme)
+    
+    ended = False
+    
+    def _segment() -> Iterator[bytes]:
+        # The lines of one file, up to a truncation or rotation
+        nonlocal ended
+        for line in lines:
+            if line is None:
+                return
+            yield line
+        ended = True
+    
+    while not ended:
+        yield from _render_ansi_bytes(colorizer, _segment(), scope, colors)
+
+
+def _read_file(path: Union[str, Path]) -> bytes:
+    """Read a file to highlight.
+    
+    Raises:
+        FileNotFoundError: If file doesn't exist
+        ValueError: If the file cannot be read
+    """
     path = Path(path)
     
-    # Read file
     if not path.exists():
         raise FileNotFoundError(f"File not found: {path}")
     
     try:
         with open(path, 'rb') as f:
-            content_bytes = f.read()
+            return f.read()
     except OSError as e:
         raise ValueError(f"Error reading file: {e}")
+
+
+async def highlight_async(
+    content: Union[str, bytes],
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    output: Literal['simple', 'ansi'] = 'ansi',
+    colors: int = 256,
+    cache: bool = True,
+    *,
+    inline: bool = False,
+    yield_every: int = YIELD_EVERY,
+    executor: Optional[Executor] = None,
+) -> Union[str, list]:
+    """Highlight source code without blocking the event loop.
+    
+    By default the work runs on ``executor`` (the loop's default executor if
+    None).  The regex engine releases the GIL while searching, so the loop
+    keeps running while the worker is inside oniguruma.
+    
+    With ``inline=True`` the work runs on the event loop itself, handing
+    control back to the loop every ``yield_every`` lines.  This bounds loop
+    latency by the cost of ``yield_every`` lines instead of the whole
+    document, without any thread hand-off.
+    
+    Args:
+        content: Source code as string or bytes
+        language: Language/scope name, if None attempts auto-detection from content
+        theme: Theme name, alias, or path to theme file
+        output: Output format - 'ansi' for terminal or 'simple' for structured data
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+        cache: Keep the rendered document in the shared render cache, only
+            used off-loop since inline highlighting renders line by line
+        inline: Run on the event loop, yielding periodically, instead of off-loop
+        yield_every: Lines highlighted between yields when running inline
+        executor: Executor used when not running inline
+    
+    Returns:
+        Same as highlight()
+    
+    Raises:
+        ValueError: If language cannot be detected or theme not found
+    
+    Example:
+        >>> highlighted = await pyonig.highlight_async(code, language='json')
+    """
+    if not inline:
+        import asyncio
+        loop = asyncio.get_running_loop()
+        return await loop.run_in_executor(
+            executor,
+            functools.partial(highlight, content, language, theme, output, colors, cache),
+        )
+    
+    lines = [
+        line
+        async for line in highlight_lines_async(
+            content, language, theme, output, colors,
+            inline=True, yield_every=yield_every,
+        )
+    ]
+    if output == 'simple':
+        return lines
+    return '\n'.join(lines)
+
+
+async def highlight_file_async(
+    path: Union[str, Path],
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    output: Literal['simple', 'ansi'] = 'ansi',
+    colors: int = 256,
+    cache: bool = True,
+    *,
+    inline: bool = False,
+    yield_every: int = YIELD_EVERY,
+    executor: Optional[Executor] = None,
+) -> Union[str, list]:
+    """Highlight a source code file without blocking the event loop.
+    
+    The file is always read off-loop; see highlight_async() for how the
+    highlighting itself is scheduled.
+    
+    Args:
+        path: Path to source code file
+        language: Language/scope name (if None, detects from filename and content)
+        theme: Theme name, alias, or path to theme file
+        output: Output format - 'ansi' for terminal or 'simple' for structured data
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+        cache: Keep the rendered document in the shared render cache
+        inline: Run on the event loop, yielding periodically, instead of off-loop
+        yield_every: Lines highlighted between yields when running inline
+        executor: Executor used for reading the file and when not running inline
+    
+    Returns:
+        Same as highlight_file()
+    
+    Raises:
+        FileNotFoundError: If file doesn't exist
+        ValueError: If language cannot be detected or theme not found
+    """
+    import asyncio
+    loop = asyncio.get_running_loop()
+    content_bytes = await loop.run_in_executor(executor, _read_file, path)
     
-    # Detect language from filename if not provided
     if language is None:
         language = detect_language(filename=str(path), content=content_bytes)
     
-    # Use highlight() with the content
-    return highlight(
-        content=content_bytes,
-        language=language,
-        theme=theme,
-        output=output,
-        colors=colors,
+    return await highlight_async(
+        content_bytes, language, theme, output, colors, cache,
+        inline=inline, yield_every=yield_every, executor=executor,
     )
 
 
+async def highlight_lines_async(
+    content: Union[str, bytes],
+    language: Optional[str] = None,
+    theme: Optional[str] = None,
+    output: Literal['simple', 'ansi'] = 'ansi',
+    colors: int = 256,
+    *,
+    inline: bool = False,
+    yield_every: int = YIELD_EVERY,
+    executor: Optional[Executor] = None,
+) -> AsyncIterator[Union[str, list]]:
+    """Highlight source code, producing rendered lines as they are ready.
+    
+    Lines are highlighted in batches of ``yield_every``, either on
+    ``executor`` or, with ``inline=True``, on the event loop with a yield to
+    the loop between batches.
+    
+    Args:
+        content: Source code as string or bytes
+        language: Language/scope name, if None attempts auto-detection from content
+        theme: Theme name, alias, or path to theme file
+        output: Output format - 'ansi' for terminal or 'simple' for structured data
+        colors: Number of terminal colors for ANSI output (8, 16, or 256)
+        inline: Run on the event loop, yielding periodically, instead of off-loop
+        yield_every: Lines highlighted per batch
+        executor: Executor used when not running inline
+    
+    Yields:
+        - If output='ansi': Each line as a string with ANSI escape codes
+        - If output='simple': Each line as a list of SimpleLinePart objects
+    
+    Raises:
+        ValueError: If language cannot be detected or theme not found
+    
+    Example:
+        >>> async for line in pyonig.highlight_lines_async(code, language='json'):
+        ...     await response.write(line + '\n')
+    """
+    import asyncio
+    loop = asyncio.get_running_loop()
+    yield_every = max(1, yield_every)
+    
+    def _lines() -> Iterator[Union[str, list]]:
+        text, content_bytes = _decode(content)
+        scope = _resolve_scope(language, content_bytes)
+        colorizer = _colorizer(theme)
+        yield from _render_lines(colorizer.iter_render(text, scope), output, colors)
+    
+    def _batch(lines: Iterator[Union[str, list]]) -> list:
+        return list(itertools.islice(lines, yield_every))
+    
+    lines = _lines()
+    while True:
+        if inline:
+            batch = _batch(lines)
+        else:
+            batch = await loop.run_in_executor(executor, _batch, lines)
+        for line in batch:
+            yield line
+        if len(batch) < yield_every:
+            return
+        if inline:
+            await asyncio.sleep(0)
+
+
+def warmup(languages: Iterable[str] = (), max_workers: Optional[int] = None) -> int:
+    """Compile the grammars of some languages ahead of the first highlight.
+    
+    Every regset and every end or while regex reachable from the languages
+    is compiled into the process wide regex cache that all highlight calls
+    share. The regexes are compiled on a thread pool, and compilation runs
+    without the GIL, so the threads run in parallel. Call it at service
+    start so the first requests don't pay for compilation.
+    
+    Args:
+        languages: Language names or scopes, all bundled languages if empty
+        max_workers: The number of threads, one per core (up to 32) if None
+    
+    Returns:
+        The number of regexes compiled, 0 if all were already compiled
+    
+    Example:
+        >>> pyonig.warmup(['python', 'typescript'])
+    """
+    scopes = {LANG_TO_SCOPE.get(language, language) for language in languages}
+    if not scopes:
+        scopes = set(LANG_TO_SCOPE.values())
+    return _grammars().warmup(sorted(scopes), max_workers)
+
+
 # Convenience: Export at package level for easy import
-__all__ = ['highlight', 'highlight_file', 'detect_language', 'ThemeManager']
+__all__ = [
+    'highlight',
+    'highlight_many',
+    'highlight_file',
+    'highlight_async',
+    'highlight_file_async',
+    'highlight_lines_async',
+    'highlight_file_lines',
+    'highlight_bytes',
+    'highlight_file_bytes',
+    'highlight_follow',
+    'warmup',
+    'detect_language',
+    'ThemeManager',
+]
 
@@ -0,0 +1,334 @@
+"""Byte-bounded caches shared across pyonig."""
+from __future__ import annotations
+
+import hashlib
+import os
+import threading
+import weakref
+from collections import OrderedDict
+from typing import Any, Callable, Hashable, Optional
+
+
+# Default capacity of the render cache, overridable with PYONIG_RENDER_CACHE_BYTES
+DEFAULT_RENDER_CACHE_BYTES = 64 * 1024 * 1024
+# Default process wide budget, overridable with PYONIG_MEMORY_BUDGET_BYTES
+DEFAULT_MEMORY_BUDGET_BYTES = 256 * 1024 * 1024
+
+
+def content_digest(text: str) -> bytes:
+    """Digest a document for use in a cache key.
+
+    Keys hold the digest rather than the document so the cache never keeps
+    a reference to the (possibly multi-MB) input text.
+
+    Args:
+        text: The document
+
+    Returns:
+        A 128 bit digest of the UTF-8 encoded document
+    """
+    return hashlib.blake2b(text.encode("utf-8", "surrogatepass"), digest_size=16).digest()
+
+
+class MemoryBudget:
+    """A byte budget shared by several caches, trimmed as one.
+
+    When the caches attached to a budget together go over it, entries are
+    evicted across all of them by GreedyDual-Size priority: the cost of
+    rebuilding an entry divided by its size, plus an inflation value that
+    rises with every eviction so entries not used for a while lose out.
+    The least recently used entry of each cache competes, so cheap bytes,
+    such as a large one-shot render, go before an expensive compiled
+    grammar that is small for the time it took to build.
+    """
+
+    def __init__(self, max_bytes: int) -> None:
+        """Initialize the budget.
+
+        Args:
+            max_bytes: Capacity, the sum of the sizes of all attached caches
+        """
+        # Shared by the attached caches so a trim sees them all consistently
+        self._lock = threading.RLock()
+        self._caches: weakref.WeakSet[ByteBoundedCache] = weakref.WeakSet()
+        self._max_bytes = max_bytes
+        self._bytes = 0
+        self._clock = 0.0
+        # Orders entries of equal priority by use, least recent first
+        self._uses = 0
+        self._evictions = 0
+
+    @property
+    def max_bytes(self) -> int:
+        """The capacity of the budget in bytes."""
+        return self._max_bytes
+
+    @max_bytes.setter
+    def max_bytes(self, value: int) -> None:
+        with self._lock:
+            self._max_bytes = value
+            self._trim()
+
+    @property
+    def clock(self) -> float:
+        """The inflation value, the priority of the last entry evicted."""
+        return self._clock
+
+    def stats(self) -> dict[str, Any]:
+        """Get the budget metrics.
+
+        Returns:
+            Bytes used, capacity, evictions made for the budget and the
+            metrics of the attached caches, summed by cache name
+        """
+        with self._lock:
+            caches: dict[str, dict[str, int]] = {}
+            for cache in list(self._caches):
+                totals = caches.setdefault(cache.name, {})
+                for metric, value in cache.stats().items():
+                    if metric != "max_bytes":
+                        totals[metric] = totals.get(metric, 0) + value
+            return {
+                "bytes": self._bytes,
+                "max_bytes": self._max_bytes,
+                "evictions": self._evictions,
+                "caches": caches,
+            }
+
+    def _attach(self, cache: ByteBoundedCache) -> None:
+        """Attach a cache, the budget lock is shared with it."""
+        self._caches.add(cache)
+        weakref.finalize(cache, self._detach, cache._bytes_box)
+
+    def _detach(self, bytes_box: list[int]) -> None:
+        """Release the bytes of a cache that has been garbage collected."""
+        with self._lock:
+            self._bytes -= bytes_box[0]
+
+    def _trim(self) -> None:
+        """Evict the lowest priority entries until within budget, lock held."""
+        while self._bytes > self._max_bytes:
+            victim: ByteBoundedCache | None = None
+            lowest = (0.0, 0)
+            for cache in list(self._caches):
+                priority = cache._head_priority()
+                if priority is not None and (victim is None or priority < lowest):
+                    victim, lowest = cache, priority
+            if victim is None:
+                return
+            self._clock = max(self._clock, lowest[0])
+            victim._evict_head()
+            self._evictions += 1
+
+
+class ByteBoundedCache:
+    """A thread-safe LRU cache capped by the estimated size of its values."""
+
+    def __init__(
+        self,
+        max_bytes: Optional[int],
+        *,
+        budget: Optional[MemoryBudget] = None,
+        name: str = "cache",
+        on_evict: Optional[Callable[[Hashable, Any], None]] = None,
+    ) -> None:
+        """Initialize the cache.
+
+        Args:
+            max_bytes: Capacity, the sum of the sizes of all stored values,
+                None to be bounded by the budget alone
+            budget: A memory budget shared with other caches
+            name: The name the cache is reported under in budget metrics
+            on_evict: Called with the key and value of each evicted entry
+        """
+        self._lock = budget._lock if budget is not None else threading.Lock()
+        # key: (value, size, cost, priority)
+        self._entries: OrderedDict[Hashable, tuple[Any, int, float, tuple[float, int]]] = OrderedDict()
+        self._max_bytes = max_bytes
+        self._budget = budget
+        self._on_evict = on_evict
+        self.name = name
+        # Boxed so the budget can release it after the cache is collected
+        self._bytes_box = [0]
+        self._hits = 0
+        self._misses = 0
+        self._evictions = 0
+        if budget is not None:
+            budget._attach(self)
+
+    @property
+    def max_bytes(self) -> Optional[int]:
+        """The capacity of the cache in bytes."""
+        return self._max_bytes
+
+    @max_bytes.setter
+    def max_bytes(self, value: Optional[int]) -> None:
+        with self._lock:
+            self._max_bytes = value
+            self._evict()
+
+    def get(self, key: Hashable) -> Optional[Any]:
+        """Look up a value, marking it as most recently used.
+
+        Args:
+            key: The key
+
+        Returns:
+            The cached value or None
+        """
+        with self._lock:
+            entry = self._entries.get(key)
+            if entry is None:
+                self._misses += 1
+                return None
+            value, size, cost, _ = entry
+            self._entries[key] = (value, size, cost, self._priority(size, cost))
+            self._entries.move_to_end(key)
+            self._hits += 1
+            return value
+
+    def __contains__(self, key: Hashable) -> bool:
+        """Check for a value without counting a hit or marking it used.
+
+        Args:
+            key: The key
+
+        Returns:
+            Whether the key is cached
+        """
+        with self._lock:
+            return key in self._entries
+
+    def put(self, key: Hashable, value: Any, size: int, cost: float = 0.0) -> None:
+        """Store a value, evicting least recently used values to make room.
+
+        Values larger than the whole cache or budget are not stored.
+
+        Args:
+            key: The key
+            value: The value
+            size: The estimated size of the value in bytes
+            cost: The time taken to build the value in seconds, under a
+                budget costlier bytes are kept in preference to cheaper ones
+        """
+        with self._lock:
+            old = self._entries.pop(key, None)
+            if old is not None:
+                self._account(-old[1])
+            if size > self._capacity():
+                return
+            self._entries[key] = (value, size, cost, self._priority(size, cost))
+            self._account(size)
+            self._evict()
+
+    def grow(self, key: Hashable, value: Any, size: int, cost: float = 0.0) -> None:
+        """Charge a stored value for memory it has taken on since it was stored.
+
+        Nothing is done if the key no longer holds the value, for example
+        because it has been evicted meanwhile.
+
+        Args:
+            key: The key
+            value: The value
+            size: The additional size in bytes
+            cost: The additional time spent building the value in seconds
+        """
+        with self._lock:
+            entry = self._entries.get(key)
+            if entry is None or entry[0] is not value:
+                return
+            size += entry[1]
+            cost += entry[2]
+            self._entries[key] = (value, size, cost, self._priority(size, cost))
+            self._entries.move_to_end(key)
+            self._account(size - entry[1])
+            self._evict()
+
+    def discard(self, key: Hashable) -> None:
+        """Remove a value if present, it is not counted as an eviction.
+
+        Args:
+            key: The key
+        """
+        with self._lock:
+            entry = self._entries.pop(key, None)
+            if entry is not None:
+                self._account(-entry[1])
+
+    def clear(self) -> None:
+        """Remove all values and reset the metrics."""
+        with self._lock:
+            self._entries.clear()
+            self._account(-self._bytes_box[0])
+            self._hits = self._misses = self._evictions = 0
+
+    def stats(self) -> dict[str, int]:
+        """Get the cache metrics.
+
+        Returns:
+            Hits, misses, evictions, number of entries, bytes used and capacity
+        """
+        with self._lock:
+            return {
+                "hits": self._hits,
+                "misses": self._misses,
+                "evictions": self._evictions,
+                "entries": len(self._entries),
+                "bytes": self._bytes_box[0],
+                "max_bytes": self._capacity(),
+            }
+
+    def _capacity(self) -> int:
+        """The effective capacity, the smaller of the cache and budget caps."""
+        caps = [self._max_bytes] if self._max_bytes is not None else []
+        if self._budget is not None:
+            caps.append(self._budget.max_bytes)
+        return min(caps) if caps else 0
+
+    def _priority(self, size: int, cost: float) -> tuple[float, int]:
+        """The eviction priority of an entry used now, lowest goes first."""
+        if self._budget is None:
+            return (0.0, 0)
+        self._budget._uses += 1
+        return (self._budget.clock + cost / max(size, 1), self._budget._uses)
+
+    def _account(self, delta: int) -> None:
+        """Record a change in bytes used, lock held."""
+        self._bytes_box[0] += delta
+        if self._budget is not None:
+            self._budget._bytes += delta
+
+    def _head_priority(self) -> Optional[tuple[float, int]]:
+        """The priority of the least recently used entry, lock held."""
+        for entry in self._entries.values():
+            return entry[3]
+        return None
+
+    def _evict_head(self) -> None:
+        """Evict the least recently used entry, lock held."""
+        key, (value, size, _, _) = self._entries.popitem(last=False)
+        self._account(-size)
+        self._evictions += 1
+        if self._on_evict is not None:
+            self._on_evict(key, value)
+
+    def _evict(self) -> None:
+        """Drop least recently used values until within capacity, lock held."""
+        if self._max_bytes is not None:
+            while self._bytes_box[0] > self._max_bytes and self._entries:
+                self._evict_head()
+        if self._budget is not None:
+            self._budget._trim()
+
+
+#: The process wide budget shared by the render, regex, grammar and style caches
+MEMORY_BUDGET = MemoryBudget(
+    int(os.environ.get("PYONIG_MEMORY_BUDGET_BYTES", DEFAULT_MEMORY_BUDGET_BYTES)),
+)
+
+#: Rendered documents, keyed by (content digest, scope, theme id)
+RENDER_CACHE = ByteBoundedCache(
+    int(os.environ.get("PYONIG_RENDER_CACHE_BYTES", DEFAULT_RENDER_CACHE_BYTES)),
+    budget=MEMORY_BUDGET,
+    name="render",
+)
@@ -6,8 +6,26 @@ import argparse
 import sys
 
 import pyonig
-from pyonig.api import highlight, highlight_file
-from pyonig.theme import ThemeManager
+
+
+def profile_file(args: argparse.Namespace) -> int:
+    """Highlight a file under the rule profiler and print the slowest rules."""
+    from pyonig.api import highlight_file
+    from pyonig.rule_profile import RETRY_THRESHOLD, profile_rules
+    
+    top = 20 if args.top is None else args.top
+    threshold = RETRY_THRESHOLD if args.threshold is None else args.threshold
+    try:
+        with profile_rules(count_retries=args.retries) as profile:
+            highlight_file(path=args.file, language=args.language, output='simple', cache=False)
+    except (FileNotFoundError, ValueError) as e:
+        print(f"Error: {e}", file=sys.stderr)
+        return 1
+    if args.retries:
+        print(profile.format_retries(threshold=threshold, top=top))
+    else:
+        print(profile.format(top=top))
+    return 0
 
 
 def main() -> int:
@@ -32,6 +50,19 @@ Examples:
   # Specify terminal color support
   pyonig --colors 256 file.json
   
+  # Highlight a file too large to read at once
+  pyonig --mmap --language log huge.log
+  
+  # Follow a live log, like tail -F
+  pyonig --follow --language log /var/log/app.log
+  kubectl logs -f pod | pyonig --follow --language log
+  
+  # List the grammar rules a slow file spends its time in
+  pyonig --profile-rules big.ts
+  
+  # List the grammar patterns that backtrack the most
+  pyonig --profile-rules --retries big.ts
+  
 Supported languages:
   json, yaml, toml, shell/bash, markdown, html, log
         """,
@@ -62,6 +93,21 @@ Supported languages:
         help="Number of terminal colors to use (default: 256)",
     )
     
+    parser.add_argument(
+        "-f", "--follow",
+        action="store_true",
+        help="Print each line as soon as it is complete, following the file as it grows",
+    )
+    
+    parser.add_argument(
+        "--mmap",
+        action="store_true",
+        help=(
+            "Memory-map the file and highlight it line by line as bytes, for files too large "
+            "to read at once. Lines are split on \\n only and markdown is not cleaned up"
+        ),
+    )
+    
     parser.add_argument(
         "--list-languages",
         action="store_true",
@@ -80,8 +126,42 @@ Supported languages:
         version=f"pyonig {pyonig.__version__} (oniguruma {pyonig.__onig_version__})",
     )
     
+    profiling = parser.add_argument_group(
+        "rule profiling",
+        "Print the grammar rules highlighting a file spends its time in, instead of the file",
+    )
+    profiling.add_argument(
+        "--profile-rules",
+        action="store_true",
+        help="Highlight the file under the rule profiler and list the slowest rules",
+    )
+    profiling.add_argument(
+        "-n", "--top",
+        type=int,
+        help="Number of regexes and regsets to list, slowest first (default: 20)",
+    )
+    profiling.add_argument(
+        "--retries",
+        action="store_true",
+        help="Count backtracking and list the patterns retrying the most per character instead",
+    )
+    profiling.add_argument(
+        "--threshold",
+        type=float,
+        help="Retries per character above which --retries lists a pattern (default: 100)",
+    )
+    
     args = parser.parse_args()
     
+    if args.profile_rules:
+        if not args.file:
+            parser.error("--profile-rules needs a file")
+        return profile_file(args)
+    if args.mmap and not args.file:
+        parser.error("--mmap needs a file")
+    if args.top is not None or args.retries or args.threshold is not None:
+        parser.error("--top, --retries and --threshold need --profile-rules")
+    
     # Handle list commands
     if args.list_languages:
         from pyonig.api import LANG_TO_SCOPE
@@ -91,6 +171,8 @@ Supported languages:
         return 0
     
     if args.list_themes:
+        from pyonig.theme import ThemeManager
+
         theme_manager = ThemeManager()
         themes = theme_manager.list_themes()
         
@@ -135,9 +217,33 @@ Supported languages:
         print("         pyonig --theme solarized-dark config.yaml")
         return 0
     
-    # Highlight file or stdin
+    # Highlight file or stdin, the highlighting stack is only imported here
+    # so --help, --version and the list commands start fast
+    from pyonig.api import highlight, highlight_file, highlight_file_bytes, highlight_follow
+
     try:
-        if args.file:
+        if args.follow:
+            # Follow a live file or pipe, flushing line by line
+            out = sys.stdout.buffer
+            for line in highlight_follow(
+                source=args.file if args.file else sys.stdin.buffer,
+                language=args.language,
+                theme=args.theme,
+                colors=args.colors,
+            ):
+                out.write(line + b"\n")
+                out.flush()
+        elif args.mmap:
+            # Stream the file without reading or decoding it as a whole
+            out = sys.stdout.buffer
+            for line in highlight_file_bytes(
+                path=args.file,
+                language=args.language,
+                theme=args.theme,
+                colors=args.colors,
+            ):
+                out.write(line + b"\n")
+        elif args.file:
             # Highlight file
             result = highlight_file(
                 path=args.file,
@@ -145,6 +251,7 @@ Supported languages:
                 theme=args.theme,
                 output='ansi',
                 colors=args.colors,
+                cache=False,
             )
             print(result)
         else:
@@ -156,6 +263,7 @@ Supported languages:
                 theme=args.theme,
                 output='ansi',
                 colors=args.colors,
+                cache=False,
             )
             print(result)
         
@@ -2,7 +2,10 @@
 # Source: https://github.com/ansible/ansible-navigator
 # File: src/ansible_navigator/ui_framework/colorize.py
 # License: Apache-2.0
-# Modifications: Updated imports to use pyonig.tm_tokenize and local vendored modules
+# Modifications: Updated imports to use pyonig.tm_tokenize and local vendored modules,
+#   renders and style memos are held in the shared memory budget,
+#   long lines are tokenized and styled in batches of regions,
+#   tokenize and colorize time is added to pyonig.stats()
 
 # cspell:ignore A_INVIS
 """Tokenize and color text."""
@@ -10,52 +13,128 @@
 from __future__ import annotations
 
 import colorsys
-import copy
-import curses
 import functools
+import hashlib
 import json
 import logging
 import re
+import threading
+import time
+import weakref
 
-from itertools import chain
 from pathlib import Path
 from typing import TYPE_CHECKING
 from typing import Any
+from typing import Iterable
+from typing import Iterator
+from typing import NamedTuple
+from typing import Sequence
 
 from pyonig.tm_tokenize.grammars import Grammars
+from pyonig.tm_tokenize.tokenize import LONG_LINE
+from pyonig.tm_tokenize.tokenize import iter_tokenize
 from pyonig.tm_tokenize.tokenize import tokenize
 
+from ._pyonig import sgr_to_curses
+from .cache import MEMORY_BUDGET
+from .cache import RENDER_CACHE
+from .cache import ByteBoundedCache
+from .cache import content_digest
 from .curses_defs import CursesLine
 from .curses_defs import CursesLinePart
 from .curses_defs import CursesLines
 from .curses_defs import RgbTuple
 from .curses_defs import SimpleLinePart
-from .ui_constants import Color
-from .ui_constants import Decoration
+from .metrics import COUNTERS
+from .trace import TRACES
+from .trace import add_span
 
 
 if TYPE_CHECKING:
+    from pyonig.tm_tokenize.compiler import Compiler
     from pyonig.tm_tokenize.region import Regions
+    from pyonig.tm_tokenize.state import State
     
     # Compatibility type for file paths
     Traversable = str | Path
 
 
-CURSES_STYLES = {
-    0: None,
-    1: getattr(curses, "A_BOLD", None),
-    2: getattr(curses, "A_DIM", None),
-    3: getattr(curses, "A_ITALIC", None),
-    4: getattr(curses, "A_UNDERLINE", None),
-    5: getattr(curses, "A_BLINK", None),
-    6: getattr(curses, "A_BLINK", None),
-    7: getattr(curses, "A_REVERSE", None),
-    8: getattr(curses, "A_INVIS", None),
-}
+# Rough per-object overheads used to estimate the memory held by a rendered
+# document: a line list, a line part and its string
+_LINE_OVERHEAD = 64
+_PART_OVERHEAD = 160
+_ANSI_SCOPE = "<ansi>"
+# Estimated footprint of a memoized scope stack to style ID entry
+_STYLE_MEMO_BYTES = 256
+
+#: The scope stack to style ID memo of each color schema, cleared when evicted
+STYLE_CACHE = ByteBoundedCache(
+    None,
+    budget=MEMORY_BUDGET,
+    name="style",
+    on_evict=lambda _, memo: memo.clear(),
+)
+
+_MD_HEADING = re.compile(r"^(#{1,6}\s)(.*$)")
+_MD_CODE = re.compile(r"`(.*)`")
+_MD_EMPHASIS = re.compile(r"\*(.*)\*")
+
+# Curses attribute name for each SGR attribute code
+_SGR_ATTRIBUTES = (None, "A_BOLD", "A_DIM", "A_ITALIC", "A_UNDERLINE", "A_BLINK", "A_BLINK", "A_REVERSE", "A_INVIS")
+
+
+@functools.lru_cache(maxsize=None)
+def curses_styles() -> dict[int, int | None]:
+    """Get the curses attribute for each SGR attribute code.
+
+    curses is only imported here, highlighting to ANSI or HTML never needs it.
+
+    Returns:
+        The attribute for each code, None where curses does not have it
+    """
+    import curses
+
+    return {code: name and getattr(curses, name, None) for code, name in enumerate(_SGR_ATTRIBUTES)}
+
+
+@functools.lru_cache(maxsize=None)
+def _sgr_decorations() -> tuple[int, ...]:
+    """Get the curses decoration for each SGR attribute code, for the native SGR parser."""
+    return tuple(style or 0 for style in curses_styles().values())
+
+
+def __getattr__(name: str) -> Any:
+    # CURSES_STYLES was a module constant, keep it without importing curses eagerly
+    if name == "CURSES_STYLES":
+        return curses_styles()
+    raise AttributeError(f"module {__name__!r} has no attribute {name!r}")
+
+
+class Style(NamedTuple):
+    """One entry of a theme's style palette."""
+
+    #: The foreground color
+    color: RgbTuple | None
+    #: The background color
+    background: RgbTuple | None
+    #: The font style as given by the theme, e.g. "bold italic"
+    font_style: str | None
+    bold: bool
+    italic: bool
+    underline: bool
+
+
+#: The style of text no theme rule applies to, always palette entry 0
+DEFAULT_STYLE = Style(None, None, None, False, False, False)
 
 
 class ColorSchema:
-    """A storage mechanism for the schema (theme)."""
+    """A storage mechanism for the schema (theme).
+
+    Theme resolution is compiled into a style table: every distinct scope
+    stack is resolved once to an integer style ID, an index into a palette
+    of unique styles.
+    """
 
     def __init__(self, schema: dict[str, str | list[Any] | dict[Any, Any]]) -> None:
         """Initialize the ColorSchema class.
@@ -65,9 +144,55 @@ class ColorSchema:
         """
         self._logger = logging.getLogger(__name__)
         self._schema = schema
+        # The first tokenColors entry naming each selector, i.e. the entry a
+        # linear scan of tokenColors would find
+        self._selectors: dict[str, dict[str, Any]] = {}
+        for token_color in schema.get("tokenColors", []):
+            if isinstance(token_color, dict):
+                for selector in scope_to_list(token_color.get("scope", [])):
+                    if isinstance(selector, str):
+                        self._selectors.setdefault(selector, token_color)
+        #: Unique styles, indexed by style ID
+        self.palette: list[Style] = [DEFAULT_STYLE]
+        self._palette_ids: dict[Style, int] = {DEFAULT_STYLE: 0}
+        self._style_ids: dict[tuple[str, ...], int] = {}
+        # Schemas are shared by highlight_many() workers, IDs are allocated
+        # under the lock so two new styles never get the same one
+        self._palette_lock = threading.Lock()
+        self._memo_key = object()
+        weakref.finalize(self, STYLE_CACHE.discard, self._memo_key)
+
+    def style_id(self, scope: tuple[str, ...]) -> int:
+        """Get the style ID of a scope stack.
+
+        Args:
+            scope: The scope stack, aka format
 
-    @functools.lru_cache(maxsize=128)  # noqa: B019
-    def get_color_and_style(self, scope: str) -> tuple[RgbTuple | None, str | None]:
+        Returns:
+            An index into the palette
+        """
+        try:
+            return self._style_ids[scope]
+        except KeyError:
+            pass
+
+        began = time.perf_counter()
+        style = self._resolve(scope)
+        with self._palette_lock:
+            style_id = self._palette_ids.get(style)
+            if style_id is None:
+                style_id = self._palette_ids[style] = len(self.palette)
+                self.palette.append(style)
+            self._style_ids[scope] = style_id
+            # Style IDs are stable, an evicted memo only costs re-resolving
+            cost = time.perf_counter() - began
+            if len(self._style_ids) == 1:
+                STYLE_CACHE.put(self._memo_key, self._style_ids, _STYLE_MEMO_BYTES, cost)
+            else:
+                STYLE_CACHE.grow(self._memo_key, self._style_ids, _STYLE_MEMO_BYTES, cost)
+        return style_id
+
+    def get_color_and_style(self, scope: tuple[str, ...]) -> tuple[RgbTuple | None, str | None]:
         """Get a color from the schema, traverse all to aggregate color and style.
 
         Args:
@@ -76,28 +201,41 @@ class ColorSchema:
         Returns:
             The color in RGB format or nothing
         """
-        found_color = None
-        found_style = None
+        style = self.palette[self.style_id(scope)]
+        return style.color, style.font_style
+
+    def _resolve(self, scope: tuple[str, ...]) -> Style:
+        """Resolve the style of a scope stack from the theme rules.
+
+        Args:
+            scope: The scope stack, aka format
+
+        Returns:
+            The style, the settings of the last rule found
+        """
+        found: dict[str, Any] | None = None
         for name in scope:
             for parts in range(len(name.split("."))):
                 prop = name.split()[-1].rsplit(".", parts)[0]
-                color = next(
-                    (
-                        token_color
-                        for token_color in self._schema["tokenColors"]
-                        if (
-                            isinstance(token_color, dict)
-                            and prop in scope_to_list(token_color.get("scope", []))
-                        )
-                    ),
-                    None,
-                )
-                if color:
-                    found_color = color.get("settings", {}).get("foreground", None)
-                    found_style = color.get("settings", {}).get("fontStyle", None)
-        if found_color:
-            found_color = hex_to_rgb(found_color)
-        return found_color, found_style
+                token_color = self._selectors.get(prop)
+                if token_color:
+                    found = token_color.get("settings", {})
+        if found is None:
+            return DEFAULT_STYLE
+
+        foreground = found.get("foreground", None)
+        background = found.get("background", None)
+        # A falsy fontStyle leaves the text unstyled
+        font_style = found.get("fontStyle", None) or None
+        font_styles = font_style.split() if font_style else ()
+        return Style(
+            color=hex_to_rgb(foreground) if foreground else None,
+            background=hex_to_rgb(background) if background else None,
+            font_style=font_style,
+            bold="bold" in font_styles,
+            italic="italic" in font_styles,
+            underline="underline" in font_styles,
+        )
 
 
 class Colorize:
@@ -112,81 +250,347 @@ class Colorize:
         """
         self._logger = logging.getLogger(__name__)
         self._schema: ColorSchema
+        self._theme_id: str
         self._grammars = Grammars(str(grammar_dir))
         self._theme_path = Path(str(theme_path))
         self._load()
 
     def _load(self) -> None:
         """Load the color scheme from the file system."""
-        with self._theme_path.open(mode="r", encoding="utf-8") as fh:
-            self._schema = ColorSchema(json.load(fh))
+        raw = self._theme_path.read_bytes()
+        # Identify the theme by content so cached renders follow theme edits
+        self._theme_id = hashlib.blake2b(raw, digest_size=16).hexdigest()
+        self._schema = ColorSchema(json.loads(raw))
 
     @staticmethod
-    @functools.lru_cache(maxsize=100)
-    def render_ansi(doc: str) -> CursesLines:
+    def render_ansi(doc: str, *, cache: bool = True) -> CursesLines:
         """Convert ansi colored text into curses lines.
 
+        The whole document is parsed in one pass by the native SGR parser,
+        color and attributes carry across lines as they would on a terminal.
+
         Args:
             doc: The text to convert
+            cache: Look up and store the result in the shared render cache,
+                pass False for one-shot documents
 
         Returns:
             Lines ready to present using the TUI
         """
-        lines = tuple(ansi_to_curses(line) for line in doc.splitlines())
-        return CursesLines(lines)
+        key = (content_digest(doc), _ANSI_SCOPE, None)
+        if cache:
+            cached = RENDER_CACHE.get(key)
+            if cached is not None:
+                return cached
+
+        began = time.perf_counter()
+        lines = CursesLines(sgr_to_curses(doc, CursesLinePart, _sgr_decorations()))
+        if cache:
+            size = sum(
+                _LINE_OVERHEAD + sum(_PART_OVERHEAD + len(part.string) for part in line)
+                for line in lines
+            )
+            RENDER_CACHE.put(key, lines, size, time.perf_counter() - began)
+        return lines
 
-    @functools.lru_cache(maxsize=100)  # noqa: B019
-    def render(self, doc: str, scope: str) -> list[list[SimpleLinePart]]:
+    def render(self, doc: str, scope: str, *, cache: bool = True) -> list[list[SimpleLinePart]]:
         """Render text lines into lines of columns and colors.
 
+        Results are kept in the process wide, byte-bounded render cache,
+        keyed by a digest of the document, the scope and the theme.
+
         Args:
             doc: The string to split, tokenize and color
             scope: The scope, aka the format of the string
+            cache: Look up and store the result in the shared render cache,
+                pass False for one-shot documents
 
         Returns:
             A list of lines, each a list of dicts
         """
-        try:
-            compiler = self._grammars.compiler_for_scope(scope)
-        except KeyError:
-            compiler = None
+        if not cache:
+            return self._render(doc, scope)
+
+        key = (content_digest(doc), scope, self._theme_id)
+        cached = RENDER_CACHE.get(key)
+        if cached is not None:
+            return cached
+
+        began = time.perf_counter()
+        rendered = self._render(doc, scope)
+        size = sum(
+            _LINE_OVERHEAD + sum(_PART_OVERHEAD + len(part.chars) for part in line)
+            for line in rendered
+        )
+        RENDER_CACHE.put(key, rendered, size, time.perf_counter() - began)
+        return rendered
+
+    def _render(self, doc: str, scope: str) -> list[list[SimpleLinePart]]:
+        """Render text lines into lines of columns and colors, uncached.
 
-        if compiler and scope != "no_color":
+        Args:
+            doc: The string to split, tokenize and color
+            scope: The scope, aka the format of the string
+
+        Returns:
+            A list of lines, each a list of dicts
+        """
+        compiler = self.compiler_for(scope)
+        if compiler is not None:
+            began = time.perf_counter_ns()
             state = compiler.root_state
             lines = []
             for line_idx, line in enumerate(doc.splitlines()):
                 line += "\n"
                 first_line = line_idx == 0
+                line_began = time.perf_counter_ns() if TRACES else 0
                 try:
                     state, regions = tokenize(compiler, state, line, first_line)
                 except Exception as exc:  # noqa: BLE001
-                    self._logger.critical(
-                        (
-                            "An unexpected error occurred within the tokenization"
-                            " subsystem.  Please log an issue with the following:"
-                        ),
-                    )
-                    self._logger.critical(
-                        "  Err: '%s', Scope: '%s', Line follows....",
-                        str(exc),
-                        scope,
-                    )
-                    self._logger.critical("  '%s'", line)
-                    self._logger.critical("  The current content will be rendered without color")
+                    self.log_tokenize_error(exc, scope, line)
                     break
                 else:
                     lines.append((regions, line))
+                    if line_began:
+                        add_span("tokenize", line_began, line=line_idx)
             else:
+                tokenized = time.perf_counter_ns()
                 assembled = columns_and_colors(lines, self._schema)
+                if TRACES:
+                    add_span("colorize", tokenized, lines=len(lines))
                 if scope == "text.html.markdown":
-                    assembled = strip_markdown(assembled)
+                    stripped = time.perf_counter_ns() if TRACES else 0
+                    assembled = list(strip_markdown(assembled))
+                    if stripped:
+                        add_span("strip_markdown", stripped)
+                COUNTERS.add(
+                    lines_tokenized=len(lines),
+                    tokenize_ns=tokenized - began,
+                    colorize_ns=time.perf_counter_ns() - tokenized,
+                )
                 return assembled
+            COUNTERS.add(lines_tokenized=len(lines), tokenize_ns=time.perf_counter_ns() - began)
+
+        return _plain_lines(doc.splitlines())
+
+    def iter_render(
+        self,
+        doc: str | Sequence[str],
+        scope: str,
+    ) -> Iterator[list[SimpleLinePart]]:
+        """Render text lines into lines of columns and colors, one line at a time.
+
+        Lines are tokenized and colored only as they are consumed.  Unlike
+        ``render``, lines already produced cannot be un-colored when the
+        tokenizer fails part way through, so only the remaining lines are
+        rendered without color.
+
+        Args:
+            doc: The string to split, tokenize and color, or its lines
+                without line endings, such as ``MappedLines``
+            scope: The scope, aka the format of the string
+
+        Yields:
+            Each line, as a list of line parts
+        """
+        doc_lines = doc.splitlines() if isinstance(doc, str) else doc
+        compiler = self.compiler_for(scope)
+        if compiler is None:
+            yield from _iter_plain_lines(doc_lines, 0)
+            return
+
+        failed_at = len(doc_lines)
+
+        def colored() -> Iterator[list[SimpleLinePart]]:
+            nonlocal failed_at
+            state = compiler.root_state
+            # Timed per line, counted once the lines stop being consumed
+            tokenize_ns = colorize_ns = tokenized = 0
+            try:
+                for line_idx, line in enumerate(doc_lines):
+                    line += "\n"
+                    began = time.perf_counter_ns()
+                    try:
+                        state, regions = tokenize(compiler, state, line, line_idx == 0)
+                    except Exception as exc:  # noqa: BLE001
+                        self.log_tokenize_error(exc, scope, line)
+                        failed_at = line_idx
+                        return
+                    split = time.perf_counter_ns()
+                    if TRACES:
+                        add_span("tokenize", began, line=line_idx)
+                    colored_line = columns_and_colors([(regions, line)], self._schema)
+                    tokenize_ns += split - began
+                    colorize_ns += time.perf_counter_ns() - split
+                    if TRACES:
+                        add_span("colorize", split, line=line_idx)
+                    tokenized += 1
+                    yield from colored_line
+            finally:
+                COUNTERS.add(lines_tokenized=tokenized, tokenize_ns=tokenize_ns, colorize_ns=colorize_ns)
+
+        lines = colored()
+        if scope == "text.html.markdown":
+            lines = strip_markdown(lines)
+        yield from lines
+        yield from _iter_plain_lines(doc_lines, failed_at)
+
+    def iter_style_runs(
+        self,
+        doc_lines: Iterable[bytes],
+        scope: str,
+    ) -> Iterator[tuple[bytes, list[tuple[int, int, int]]]]:
+        """Tokenize UTF-8 lines without decoding them, one line at a time.
+
+        Lines are tokenized as bytes so regex offsets are byte offsets end to
+        end, with no decoding or offset conversion.  Lines that are not valid
+        UTF-8 have the invalid bytes replaced.  Markdown is not cleaned up.
+        Like ``iter_render``, when the tokenizer fails the remaining lines
+        are not colored.
+
+        Args:
+            doc_lines: The lines, without line endings
+            scope: The scope, aka the format of the lines
+
+        Yields:
+            Each line with its line ending, and its runs of style IDs as
+            byte offsets, for ``schema.palette``
+        """
+        compiler = self.compiler_for(scope)
+        state = compiler.root_state if compiler is not None else None
+        # Timed per line, counted once the lines stop being consumed. Long
+        # lines are styled batch by batch as they are tokenized, that is
+        # counted as tokenizing
+        tokenize_ns = colorize_ns = tokenized = 0
+        try:
+            for line_idx, doc_line in enumerate(doc_lines):
+                line = _valid_utf8(doc_line) + b"\n"
+                if compiler is not None:
+                    began = split = time.perf_counter_ns()
+                    try:
+                        if len(line) >= LONG_LINE:
+                            # Style IDs are held for a batch of regions at a time
+                            batches = iter_tokenize(compiler, state, line, line_idx == 0)
+                            state, runs = batched_style_runs(batches, self._schema)
+                            split = time.perf_counter_ns()
+                            if TRACES:
+                                add_span("tokenize", began, line=line_idx, batched=True)
+                        else:
+                            state, regions = tokenize(compiler, state, line, line_idx == 0)
+                            split = time.perf_counter_ns()
+                            if TRACES:
+                                add_span("tokenize", began, line=line_idx)
+                            runs = style_runs(regions, len(line), self._schema)
+                            if TRACES:
+                                add_span("colorize", split, line=line_idx)
+                    except Exception as exc:  # noqa: BLE001
+                        self.log_tokenize_error(exc, scope, line.decode("utf-8"))
+                        compiler = None
+                    else:
+                        tokenize_ns += split - began
+                        colorize_ns += time.perf_counter_ns() - split
+                        tokenized += 1
+                        yield line, runs
+                        continue
+                yield line, [(0, len(line), 0)]
+        finally:
+            COUNTERS.add(lines_tokenized=tokenized, tokenize_ns=tokenize_ns, colorize_ns=colorize_ns)
+
+    @property
+    def schema(self) -> ColorSchema:
+        """The color schema of the theme."""
+        return self._schema
+
+    def compiler_for(self, scope: str) -> Compiler | None:
+        """Get the grammar compiler for a scope.
+
+        Args:
+            scope: The scope, aka the format of the string
+
+        Returns:
+            The compiler, or None if the text should not be colored
+        """
+        if scope == "no_color":
+            return None
+        try:
+            return self._grammars.compiler_for_scope(scope)
+        except KeyError:
+            return None
+
+    def log_tokenize_error(self, exc: Exception, scope: str, line: str) -> None:
+        """Log a failure within the tokenization subsystem.
+
+        Renderers built on the colorizer, like HighlightedDocument, report
+        their tokenizer failures here too.
+
+        Args:
+            exc: The exception raised by the tokenizer
+            scope: The scope being rendered
+            line: The line that failed to tokenize
+        """
+        self._logger.critical(
+            (
+                "An unexpected error occurred within the tokenization"
+                " subsystem.  Please log an issue with the following:"
+            ),
+        )
+        self._logger.critical(
+            "  Err: '%s', Scope: '%s', Line follows....",
+            str(exc),
+            scope,
+        )
+        self._logger.critical("  '%s'", line)
+        self._logger.critical("  The current content will be rendered without color")
+
 
-        res = [
-            [SimpleLinePart(column=0, chars=doc_line, color=None, style=None)]
-            for doc_line in doc.splitlines()
-        ]
-        return res
+def _plain_lines(doc_lines: list[str]) -> list[list[SimpleLinePart]]:
+    """Wrap lines of text as single, uncolored line parts.
+
+    Args:
+        doc_lines: The lines of text
+
+    Returns:
+        One line part per line
+    """
+    return [
+        [SimpleLinePart(column=0, chars=doc_line, color=None, style=None)]
+        for doc_line in doc_lines
+    ]
+
+
+def _valid_utf8(line: bytes) -> bytes:
+    """Make sure a line is valid UTF-8 before it is searched as bytes.
+
+    Args:
+        line: The line
+
+    Returns:
+        The line, with invalid bytes replaced if there were any
+    """
+    if line.isascii():
+        return line
+    try:
+        line.decode("utf-8")
+    except UnicodeDecodeError:
+        return line.decode("utf-8", "replace").encode("utf-8")
+    return line
+
+
+def _iter_plain_lines(
+    doc_lines: Sequence[str],
+    start: int,
+) -> Iterator[list[SimpleLinePart]]:
+    """Wrap lines of text as uncolored line parts, one line at a time.
+
+    Args:
+        doc_lines: The lines of text
+        start: The first line to wrap
+
+    Yields:
+        One line part per line
+    """
+    for line_idx in range(start, len(doc_lines)):
+        yield [SimpleLinePart(column=0, chars=doc_lines[line_idx], color=None, style=None)]
 
 
 def scope_to_list(scope: str | list[Any]) -> list[Any]:
@@ -293,6 +697,97 @@ def rgb_to_ansi(red: int, green: int, blue: int, colors: int) -> int:
     return ansi
 
 
+def style_runs(regions: Regions, length: int, schema: ColorSchema) -> list[tuple[int, int, int]]:
+    """Group the regions of a line into runs of like style.
+
+    Offsets are those of the regions, characters for str lines and bytes for
+    UTF-8 bytes lines.
+
+    Args:
+        regions: The regions of the line
+        length: The length of the line
+        schema: An instance of the ColorSchema
+
+    Returns:
+        The start, end and style ID of each run, covering the whole line
+    """
+    # One style ID per character, 0 being the default style
+    style_ids = [0] * length
+    _paint(style_ids, 0, regions, schema)
+    runs: list[tuple[int, int, int]] = []
+    _add_runs(runs, style_ids, 0)
+    return runs
+
+
+def batched_style_runs(
+    batches: Iterable[tuple[State, int, Regions]],
+    schema: ColorSchema,
+) -> tuple[State | None, list[tuple[int, int, int]]]:
+    """Group the regions of a long line into runs of like style, batch by batch.
+
+    The same runs as ``style_runs``, but style IDs are only held for the
+    part of the line a batch covers, rather than for every character.
+
+    Args:
+        batches: The batches of ``iter_tokenize``
+        schema: An instance of the ColorSchema
+
+    Returns:
+        The tokenizer state after the line, and the start, end and style ID
+        of each run, covering the whole line
+    """
+    state = None
+    runs: list[tuple[int, int, int]] = []
+    start = 0
+    # Style IDs painted past the end of the last batch, by lookahead captures
+    carry: list[int] = []
+    for state, pos, regions in batches:
+        end = max(pos, start + len(carry), *(region.end for region in regions))
+        style_ids = carry + [0] * (end - start - len(carry))
+        _paint(style_ids, start, regions, schema)
+        _add_runs(runs, style_ids[: pos - start], start)
+        carry = style_ids[pos - start :]
+        start = pos
+    return state, runs
+
+
+def _paint(style_ids: list[int], offset: int, regions: Regions, schema: ColorSchema) -> None:
+    """Paint the style IDs of regions, later regions over earlier ones.
+
+    Args:
+        style_ids: The style ID of each character from the offset
+        offset: The offset of the first style ID
+        regions: The regions
+        schema: An instance of the ColorSchema
+    """
+    for region in regions:
+        style_id = schema.style_id(region.scope)
+        start = max(region.start - offset, 0)
+        end = region.end - offset
+        if style_id and end > start:
+            style_ids[start:end] = [style_id] * (end - start)
+
+
+def _add_runs(runs: list[tuple[int, int, int]], style_ids: list[int], offset: int) -> None:
+    """Compress style IDs into runs of like style, extending the last run.
+
+    Args:
+        runs: The runs so far, added to
+        style_ids: The style ID of each character from the offset
+        offset: The offset of the first style ID
+    """
+    first = 0
+    run_start = offset
+    if runs and runs[-1][1] == offset and style_ids and runs[-1][2] == style_ids[0]:
+        run_start = runs.pop()[0]
+    length = len(style_ids)
+    for end in range(1, length + 1):
+        if end == length or style_ids[end] != style_ids[first]:
+            runs.append((run_start, end + offset, style_ids[first]))
+            first = end
+            run_start = end + offset
+
+
 def columns_and_colors(
     lines: list[tuple[Regions, str]],
     schema: ColorSchema,
@@ -307,43 +802,25 @@ def columns_and_colors(
         Lines of text, each broken into sections
     """
     results: list[list[SimpleLinePart]] = []
-
-    for line in lines:
-        # Break the into 1 character parts, temporarily set the column to 0
-        line_parts = [
-            SimpleLinePart(chars=character, color=None, column=0, style=None)
-            for character in line[1]
-        ]
-
-        # Replace the color with the RgbTuple
-        for region in line[0]:
-            color, style = schema.get_color_and_style(region.scope)
-            if color:
-                for idx in range(region.start, region.end):
-                    line_parts[idx].color = color
-            if style:
-                for idx in range(region.start, region.end):
-                    line_parts[idx].style = style
-
-        # Compress the line, grouping characters of like color and decoration
-        if line_parts:
-            grouped = [line_parts.pop(0)]
-            while line_parts:
-                entry = line_parts.pop(0)
-                if entry.color == grouped[-1].color and entry.style == grouped[-1].style:
-                    grouped[-1].chars += entry.chars
-                else:
-                    grouped.append(entry)
-            results.append(grouped)
-        else:
-            results.append([SimpleLinePart(chars=line[1], color=None, column=0, style=None)])
-
-    # Update the column in each line part, based on the total of the preceding text lengths
-    for result in results:
-        column = 0
-        for line_part in result:
-            line_part.column = column
-            column += len(line_part.chars)
+    palette = schema.palette
+
+    for regions, text in lines:
+        if not text:
+            results.append([SimpleLinePart(chars=text, color=None, column=0, style=None)])
+            continue
+
+        grouped = []
+        for start, end, style_id in style_runs(regions, len(text), schema):
+            style = palette[style_id]
+            grouped.append(
+                SimpleLinePart(
+                    chars=text[start:end],
+                    column=start,
+                    color=style.color,
+                    style=style.font_style,
+                ),
+            )
+        results.append(grouped)
 
     return results
 
@@ -357,126 +834,111 @@ def ansi_to_curses(line: str) -> CursesLine:
     Returns:
         A line ready for presentation in the TUI
     """
-    # pylint: disable=too-many-locals
-    if line == "":
-        line_part = CursesLinePart(
+    return sgr_to_curses(line, CursesLinePart, _sgr_decorations(), split_lines=False)[0]
+
+
+def _full_dash_line() -> list[SimpleLinePart]:
+    """Build a full width line of no-break dashes.
+
+    Returns:
+        A line with a single, gray line part
+    """
+    return [
+        SimpleLinePart(
+            chars=f"{'—' * 132}\n",
             column=0,
-            string="",
-            color=Color.BLACK,
-            decoration=Decoration.NORMAL,
-        )
-        return CursesLine((line_part,))
-
-    printable = []
-    ansi_regex = re.compile(r"(\x1b\[[\d;]*m)")
-    color_regex = re.compile(
-        r"""(?x)
-            \x1b\[                              # Control Sequence Introducer
-            (?P<fg_action>(38;5|39);)?          # optional FG color action
-            (?P<_bg_action>(48;5|49);)?         # optional BG color action
-            (?P<one>\d+)                        # required, one number
-            (;(?P<two>\d+))?                    # optional 2nd number
-            m
-        """,
-    )
-    parts = ansi_regex.split(line)
-    colno = 0
-    color = 0
-    style = 0
-    while parts:
-        part = parts.pop(0)
-        if part:
-            match = color_regex.match(part)
-            if match:
-                cap = match.groupdict()
-                one = cap["one"]
-                two = cap["two"]
-                if cap["fg_action"] == "39;" or (one == "0" and two is None):
-                    pass  # default color
-                elif cap["fg_action"] == "38;5;":
-                    color = int(one)
-                    if two:
-                        style = CURSES_STYLES.get(int(two), None) or 0
-                elif not cap["fg_action"]:
-                    ansi_16 = list(chain(range(30, 38), range(90, 98)))
-                    if two is None:
-                        color = ansi_16.index(int(one)) if int(one) in ansi_16 else int(one)
-                    else:
-                        color = ansi_16.index(int(two)) if int(two) in ansi_16 else int(two)
-                        style = CURSES_STYLES.get(int(one), None) or 0
-            else:
-                curses_line = CursesLinePart(
-                    column=colno,
-                    string=part,
-                    color=color,
-                    decoration=style,
-                )
-                printable.append(curses_line)
-                colno += len(part)
-                color = 0
-                style = 0
-    return CursesLine(tuple(printable))
+            color=(128, 128, 128),
+            style=None,
+        ),
+    ]
 
 
-def strip_markdown(lines: list[list[SimpleLinePart]]) -> list[list[SimpleLinePart]]:
+def _strip_markdown_line(
+    line: list[SimpleLinePart],
+    in_a_code_block: bool,
+) -> tuple[bool, bool, bool]:
+    """Strip some markdown from the parts of a single line, in place.
+
+    Args:
+        line: The parts of the line
+        in_a_code_block: Whether the line starts within a fenced code block
+
+    Returns:
+        Whether the line ends within a code block, whether it is a heading 1
+        and whether it is a ``---`` rule
+    """
+    heading_1 = rule = False
+    for part in line:
+        chars = part.chars
+        if chars.startswith("```"):
+            # Remove ```x from a line
+            part.chars = "\n"
+            in_a_code_block = not in_a_code_block
+            continue
+
+        if in_a_code_block:
+            # Don't modify inside a code block
+            continue
+
+        if chars.startswith("#"):
+            # Remove # headings
+            part.chars = _MD_HEADING.sub(r"\2", chars)
+            heading_1 = heading_1 or chars.startswith("# ")
+            continue
+
+        if chars == "---\n":
+            rule = True
+            continue
+
+        if "`" in chars:
+            # Remove `` from code blocks
+            chars = part.chars = _MD_CODE.sub(r"\1", chars)
+
+        if "*" in chars:
+            # Remove ** from emphasis
+            part.chars = _MD_EMPHASIS.sub(r"\1", chars)
+    return in_a_code_block, heading_1, rule
+
+
+def strip_markdown(lines: Iterable[list[SimpleLinePart]]) -> Iterator[list[SimpleLinePart]]:
     """Strip some markdown from the regions.
 
     This is not a complete removal of markdown, but it removes some of the
     common markdown that is in use.
 
+    Lines are transformed in a single forward pass as they are consumed, the
+    parts of each line are modified in place.  A ``---`` rule is held back
+    until the following line has been seen, so the output trails the input by
+    at most one line.
+
     Args:
         lines: Lines of text and their parts
 
-    Returns:
+    Yields:
         Lines of text and their parts without some markdown
     """
-    full_dash_line = [
-        SimpleLinePart(
-            chars=f"{'—' * 132}\n",
-            column=0,
-            color=(128, 128, 128),
-            style=None,
-        ),
-    ]
     in_a_code_block = False
-    for line_idx, line in reversed(list(enumerate(copy.deepcopy(lines)))):
-        for part_idx, part in enumerate(line):
-            if part.chars.startswith("```"):
-                # Remove ```x from a line
-                lines[line_idx][part_idx].chars = "\n"
-                in_a_code_block = not in_a_code_block
-                continue
-
-            if in_a_code_block:
-                # Don't modify inside a code block
-                continue
-
-            if part.chars.startswith("#"):
-                # Remove # headings
-                lines[line_idx][part_idx].chars = re.sub(r"^(#{1,6}\s)(.*$)", r"\2", part.chars)
-                if part.chars.startswith("# "):
-                    # Insert a full line after a heading 1
-                    lines.insert(line_idx + 1, full_dash_line)
-                continue
-
-            if part.chars == "---\n":
-                # Replace all dash line with no-break dashes if \n before and after
-                try:
-                    if (
-                        lines[line_idx - 1][0].chars == "\n"
-                        and lines[line_idx + 1][0].chars == "\n"
-                    ):
-                        lines[line_idx] = full_dash_line
-                        continue
-                except IndexError:
-                    pass
-
-            if "`" in part.chars:
-                # Remove `` from code blocks
-                lines[line_idx][part_idx].chars = re.sub(r"`(.*)`", r"\1", part.chars)
+    previous_blank = False
+    held: list[SimpleLinePart] | None = None
+    held_after_blank = False
+    for line in lines:
+        blank = bool(line) and line[0].chars == "\n"
+        in_a_code_block, heading_1, rule = _strip_markdown_line(line, in_a_code_block)
 
-            if "*" in part.chars:
-                # Remove `` from code blocks
-                lines[line_idx][part_idx].chars = re.sub(r"\*(.*)\*", r"\1", part.chars)
+        if held is not None:
+            # Replace a dash line with no-break dashes if \n before and after
+            after_blank = bool(line) and line[0].chars == "\n"
+            yield _full_dash_line() if held_after_blank and after_blank else held
+            held = None
 
-    return lines
+        if rule:
+            held, held_after_blank = line, previous_blank
+        else:
+            yield line
+            if heading_1:
+                # Insert a full line after a heading 1
+                yield _full_dash_line()
+        previous_blank = blank
+
+    if held is not None:
+        yield held
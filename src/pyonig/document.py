@@ -0,0 +1,230 @@
+"""Lazily highlighted documents for viewport based presentation."""
+from __future__ import annotations
+
+from collections import OrderedDict
+from collections.abc import Sequence
+from typing import TYPE_CHECKING
+from typing import NamedTuple
+from typing import overload
+
+from pyonig.tm_tokenize.tokenize import tokenize
+
+from .colorize import _plain_lines
+from .colorize import _strip_markdown_line
+from .colorize import columns_and_colors
+from .curses_defs import SimpleLinePart
+
+
+if TYPE_CHECKING:
+    from pyonig.tm_tokenize.state import State
+
+    from .colorize import Colorize
+
+
+# Lines between tokenizer state checkpoints
+DEFAULT_CHECKPOINT_EVERY = 128
+# Rendered blocks of lines kept around for scrolling
+DEFAULT_MAX_BLOCKS = 32
+
+
+class _Checkpoint(NamedTuple):
+    """Everything needed to resume rendering at the start of a block."""
+
+    state: State
+    in_a_code_block: bool
+
+
+class HighlightedDocument(Sequence[list[SimpleLinePart]]):
+    """A document tokenized and colored only as its lines are requested.
+
+    Lines are rendered in blocks of ``checkpoint_every`` lines.  The tokenizer
+    state at the start of each block is kept once it is known, so rendering
+    any block already reached costs at most one block of tokenization, and
+    rendering a block further down only tokenizes, without coloring, the
+    blocks in between.  The most recently used rendered blocks are kept.
+
+    Lines map one to one to the lines of the document, for markdown the
+    in-line clean up of ``strip_markdown`` is applied but no lines are
+    inserted or replaced.
+
+    Like ``Colorize.iter_render``, when the tokenizer fails the lines from the
+    failing one onwards are rendered without color.
+    """
+
+    def __init__(
+        self,
+        colorizer: Colorize,
+        doc: str | Sequence[str],
+        scope: str,
+        *,
+        checkpoint_every: int = DEFAULT_CHECKPOINT_EVERY,
+        max_blocks: int = DEFAULT_MAX_BLOCKS,
+    ) -> None:
+        """Initialize the document, no tokenization is done up front.
+
+        Args:
+            colorizer: The colorizer providing the grammars and theme
+            doc: The text, or its lines without line endings
+            scope: The scope, aka the format of the text
+            checkpoint_every: The number of lines between state checkpoints
+            max_blocks: The number of rendered blocks to keep
+
+        Raises:
+            ValueError: If checkpoint_every or max_blocks is less than 1
+        """
+        if checkpoint_every < 1 or max_blocks < 1:
+            msg = "checkpoint_every and max_blocks must be at least 1"
+            raise ValueError(msg)
+        self._colorizer = colorizer
+        self._lines = doc.splitlines() if isinstance(doc, str) else doc
+        self._scope = scope
+        self._checkpoint_every = checkpoint_every
+        self._max_blocks = max_blocks
+        self._markdown = scope == "text.html.markdown"
+        self._compiler = colorizer.compiler_for(scope)
+        self._checkpoints: list[_Checkpoint] = []
+        if self._compiler is not None:
+            self._checkpoints.append(_Checkpoint(self._compiler.root_state, False))
+        # Lines from here on are not colored
+        self._failed_at = len(self._lines) if self._compiler is not None else 0
+        self._blocks: OrderedDict[int, list[list[SimpleLinePart]]] = OrderedDict()
+        self._tokenized = 0
+
+    def __len__(self) -> int:
+        """Get the number of lines.
+
+        Returns:
+            The number of lines in the document
+        """
+        return len(self._lines)
+
+    @overload
+    def __getitem__(self, index: int) -> list[SimpleLinePart]: ...
+
+    @overload
+    def __getitem__(self, index: slice) -> list[list[SimpleLinePart]]: ...
+
+    def __getitem__(
+        self,
+        index: int | slice,
+    ) -> list[SimpleLinePart] | list[list[SimpleLinePart]]:
+        """Render a line, or a slice of lines.
+
+        Args:
+            index: The line number or a slice of line numbers
+
+        Returns:
+            The line parts of the line, or a list of lines
+
+        Raises:
+            IndexError: If the line number is out of range
+        """
+        if isinstance(index, slice):
+            start, stop, step = index.indices(len(self._lines))
+            if step == 1:
+                return self.viewport(start, stop - start)
+            return [self[line_idx] for line_idx in range(start, stop, step)]
+        if index < 0:
+            index += len(self._lines)
+        if not 0 <= index < len(self._lines):
+            msg = "line index out of range"
+            raise IndexError(msg)
+        block_idx, offset = divmod(index, self._checkpoint_every)
+        return self._block(block_idx)[offset]
+
+    def viewport(self, start: int, height: int) -> list[list[SimpleLinePart]]:
+        """Render the lines visible in a viewport.
+
+        Args:
+            start: The first line in view
+            height: The number of lines in view
+
+        Returns:
+            The rendered lines, fewer than height at the end of the document
+        """
+        stop = min(start + height, len(self._lines))
+        lines: list[list[SimpleLinePart]] = []
+        line_idx = max(start, 0)
+        while line_idx < stop:
+            block_idx, offset = divmod(line_idx, self._checkpoint_every)
+            block = self._block(block_idx)
+            take = min(len(block) - offset, stop - line_idx)
+            lines.extend(block[offset : offset + take])
+            line_idx += take
+        return lines
+
+    @property
+    def tokenized_lines(self) -> int:
+        """The number of lines from the start of the document tokenized so far."""
+        return self._tokenized
+
+    def _block(self, block_idx: int) -> list[list[SimpleLinePart]]:
+        """Get a rendered block of lines, rendering it if necessary.
+
+        Args:
+            block_idx: The block number
+
+        Returns:
+            The rendered lines of the block
+        """
+        block = self._blocks.get(block_idx)
+        if block is not None:
+            self._blocks.move_to_end(block_idx)
+            return block
+
+        # Tokenize up to the start of the block, coloring only when markdown
+        # clean up needs the colored parts to track code blocks
+        while len(self._checkpoints) <= block_idx:
+            checkpoints = len(self._checkpoints)
+            if checkpoints == 0:
+                break
+            self._run(checkpoints - 1, color=self._markdown)
+            if len(self._checkpoints) == checkpoints:
+                break
+
+        block = self._run(block_idx, color=True)
+        self._blocks[block_idx] = block
+        if len(self._blocks) > self._max_blocks:
+            self._blocks.popitem(last=False)
+        return block
+
+    def _run(self, block_idx: int, *, color: bool) -> list[list[SimpleLinePart]]:
+        """Tokenize a block of lines from its checkpoint, recording the next one.
+
+        Args:
+            block_idx: The block number
+            color: Whether to color the lines
+
+        Returns:
+            The rendered lines of the block, empty if not colored
+        """
+        start = block_idx * self._checkpoint_every
+        stop = min(start + self._checkpoint_every, len(self._lines))
+        if block_idx >= len(self._checkpoints):
+            return _plain_lines(list(self._lines[start:stop])) if color else []
+
+        state, in_a_code_block = self._checkpoints[block_idx]
+        lines: list[list[SimpleLinePart]] = []
+        line_idx = start
+        while line_idx < min(stop, self._failed_at):
+            line = self._lines[line_idx] + "\n"
+            try:
+                state, regions = tokenize(self._compiler, state, line, line_idx == 0)
+            except Exception as exc:  # noqa: BLE001
+                self._colorizer.log_tokenize_error(exc, self._scope, line)
+                self._failed_at = line_idx
+                break
+            if color:
+                rendered = columns_and_colors([(regions, line)], self._colorizer.schema)[0]
+                if self._markdown:
+                    in_a_code_block, _, _ = _strip_markdown_line(rendered, in_a_code_block)
+                lines.append(rendered)
+            line_idx += 1
+        self._tokenized = max(self._tokenized, line_idx)
+
+        if line_idx < stop:
+            # The tokenizer failed in or before this block
+            return lines + _plain_lines(list(self._lines[line_idx:stop])) if color else []
+        if block_idx + 1 == len(self._checkpoints) and stop < len(self._lines):
+            self._checkpoints.append(_Checkpoint(state, in_a_code_block))
+        return lines
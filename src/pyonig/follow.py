@@ -0,0 +1,138 @@
+"""Incremental line sources for following growing files and pipes."""
+from __future__ import annotations
+
+import os
+import time
+
+from pathlib import Path
+from typing import BinaryIO
+from typing import Iterator
+from typing import Optional
+from typing import Union
+
+
+# Seconds between checks of a followed file for new data, truncation and rotation
+DEFAULT_POLL_INTERVAL = 0.01
+# Bytes read at a time, whatever is available up to this is used at once
+READ_SIZE = 64 * 1024
+
+
+def _complete_lines(pending: bytearray, chunk: bytes) -> list[bytes]:
+    """Add a chunk to the pending bytes, taking out the lines it completes.
+
+    Args:
+        pending: The bytes of an incomplete line, updated in place
+        chunk: The bytes read
+
+    Returns:
+        The complete lines, without their line endings
+    """
+    pending += chunk
+    if b"\n" not in chunk:
+        return []
+    *lines, rest = bytes(pending).split(b"\n")
+    pending[:] = rest
+    return [line[:-1] if line.endswith(b"\r") else line for line in lines]
+
+
+def stream_lines(stream: BinaryIO) -> Iterator[bytes]:
+    """Get the lines of a pipe or other stream as soon as each is complete.
+
+    Each read takes whatever is available rather than waiting to fill a
+    buffer, so a line is produced as soon as its newline arrives.
+
+    Args:
+        stream: A binary stream, e.g. ``sys.stdin.buffer``
+
+    Yields:
+        Each line without its line ending, a final line without a newline
+        when the stream ends
+    """
+    read = getattr(stream, "read1", stream.read)
+    pending = bytearray()
+    while True:
+        chunk = read(READ_SIZE)
+        if not chunk:
+            break
+        yield from _complete_lines(pending, chunk)
+    if pending:
+        yield bytes(pending)
+
+
+def _rotated(path: Path, fd: int) -> bool:
+    """Check whether the path now names a different file than the one open.
+
+    Args:
+        path: The followed path
+        fd: The open file
+
+    Returns:
+        True if the path names a new file, False while it is missing
+    """
+    try:
+        current = path.stat()
+    except FileNotFoundError:
+        return False
+    opened = os.fstat(fd)
+    return (current.st_ino, current.st_dev) != (opened.st_ino, opened.st_dev)
+
+
+def follow_lines(
+    path: Union[str, Path],
+    poll_interval: float = DEFAULT_POLL_INTERVAL,
+    idle_timeout: Optional[float] = None,
+) -> Iterator[Optional[bytes]]:
+    """Get the lines of a file from the start, then as it grows, like ``tail -F``.
+
+    At the end of the file it is checked every poll interval for data. A
+    file that shrinks, truncated in place, is read again from the start. A
+    path that names a new file, rotated, is reopened once the old file is
+    drained. A line is only produced once its newline is written.
+
+    Args:
+        path: The file
+        poll_interval: Seconds between checks at the end of the file
+        idle_timeout: Stop after this many seconds without data, None to
+            follow until the generator is closed
+
+    Yields:
+        Each line without its line ending, or None when a new file starts,
+        after truncation or rotation
+
+    Raises:
+        FileNotFoundError: If the file doesn't exist
+    """
+    path = Path(path)
+    file = path.open("rb")
+    pending = bytearray()
+    last_data = time.monotonic()
+    try:
+        while True:
+            chunk = file.read1(READ_SIZE)
+            if chunk:
+                yield from _complete_lines(pending, chunk)
+                last_data = time.monotonic()
+                continue
+
+            if _rotated(path, file.fileno()):
+                # The old file is drained, it won't get its last newline
+                if pending:
+                    yield bytes(pending)
+                    pending.clear()
+                file.close()
+                file = path.open("rb")
+                yield None
+                continue
+            if os.fstat(file.fileno()).st_size < file.tell():
+                pending.clear()
+                file.seek(0)
+                yield None
+                continue
+
+            if idle_timeout is not None and time.monotonic() - last_data >= idle_timeout:
+                if pending:
+                    yield bytes(pending)
+                return
+            time.sleep(poll_interval)
+    finally:
+        file.close()
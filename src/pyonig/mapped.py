@@ -0,0 +1,134 @@
+"""Memory-mapped access to the lines of large files."""
+from __future__ import annotations
+
+import mmap
+
+from collections.abc import Sequence
+from pathlib import Path
+from types import TracebackType
+from typing import overload
+
+from ._pyonig import line_index
+
+
+class MappedLines(Sequence[str]):
+    """The lines of a file, memory-mapped and decoded one line at a time.
+
+    The file is never read into memory as a whole.  A native scan records the
+    start offset of every line, 8 bytes per line, and each line is decoded
+    from a zero-copy slice of the mapping only when it is requested, so
+    memory use is the index plus the lines in use regardless of file size.
+
+    Lines are split on ``\\n``, a trailing ``\\r`` is removed, and invalid
+    UTF-8 is replaced rather than failing part way through a large file.
+    """
+
+    def __init__(self, path: str | Path) -> None:
+        """Map and index a file.
+
+        Args:
+            path: The file
+
+        Raises:
+            FileNotFoundError: If the file doesn't exist
+        """
+        self._path = Path(path)
+        with self._path.open("rb") as file:
+            size = self._path.stat().st_size
+            self._map: mmap.mmap | None = (
+                mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ) if size else None
+            )
+        self._view = memoryview(self._map if self._map is not None else b"")
+        self._starts = memoryview(line_index(self._view)).cast("n")
+
+    def __enter__(self) -> MappedLines:
+        """Use the mapping as a context manager.
+
+        Returns:
+            The mapped lines
+        """
+        return self
+
+    def __exit__(
+        self,
+        exc_type: type[BaseException] | None,
+        exc_value: BaseException | None,
+        traceback: TracebackType | None,
+    ) -> None:
+        """Unmap the file on leaving the context."""
+        self.close()
+
+    def close(self) -> None:
+        """Unmap the file, lines can no longer be read."""
+        self._starts.release()
+        self._view.release()
+        if self._map is not None:
+            self._map.close()
+            self._map = None
+
+    @property
+    def size(self) -> int:
+        """The size of the file in bytes."""
+        return self._view.nbytes
+
+    def head(self, size: int = 2048) -> bytes:
+        """Get the start of the file, for content detection.
+
+        Args:
+            size: The number of bytes
+
+        Returns:
+            Up to size bytes from the start of the file
+        """
+        return bytes(self._view[:size])
+
+    def line_bytes(self, index: int) -> memoryview:
+        """Get the raw bytes of a line without copying.
+
+        Args:
+            index: The line number
+
+        Returns:
+            A view of the line in the mapping, without its line ending
+
+        Raises:
+            IndexError: If the line number is out of range
+        """
+        if index < 0:
+            index += len(self)
+        if not 0 <= index < len(self):
+            msg = "line index out of range"
+            raise IndexError(msg)
+        start, end = self._starts[index], self._starts[index + 1]
+        if end > start and self._view[end - 1] == 0x0A:
+            end -= 1
+        if end > start and self._view[end - 1] == 0x0D:
+            end -= 1
+        return self._view[start:end]
+
+    def __len__(self) -> int:
+        """Get the number of lines.
+
+        Returns:
+            The number of lines in the file
+        """
+        return len(self._starts) - 1
+
+    @overload
+    def __getitem__(self, index: int) -> str: ...
+
+    @overload
+    def __getitem__(self, index: slice) -> list[str]: ...
+
+    def __getitem__(self, index: int | slice) -> str | list[str]:
+        """Decode a line, or a slice of lines.
+
+        Args:
+            index: The line number or a slice of line numbers
+
+        Returns:
+            The line without its line ending, or a list of lines
+        """
+        if isinstance(index, slice):
+            return [self[line_idx] for line_idx in range(*index.indices(len(self)))]
+        return str(self.line_bytes(index), "utf-8", "replace")
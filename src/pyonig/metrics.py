@@ -0,0 +1,167 @@
+"""Process wide metrics of pyonig's hot paths, with a Prometheus exposition."""
+from __future__ import annotations
+
+import threading
+
+from typing import Any
+from typing import Optional
+
+from pyonig import _pyonig
+from pyonig.cache import MEMORY_BUDGET
+
+
+class Counters:
+    """Named counters added to from any thread and read as one snapshot.
+
+    Adds are made once per document or compile rather than per line, so
+    the lock stays off the per search path.
+    """
+
+    def __init__(self, *names: str) -> None:
+        """Initialize the counters at zero.
+
+        Args:
+            names: The names of the counters
+        """
+        self._lock = threading.Lock()
+        self._values = dict.fromkeys(names, 0)
+
+    def add(self, **deltas: int) -> None:
+        """Add to some of the counters.
+
+        Args:
+            deltas: The amount to add to each named counter
+        """
+        with self._lock:
+            for name, delta in deltas.items():
+                self._values[name] += delta
+
+    def snapshot(self) -> dict[str, int]:
+        """Get the value of every counter.
+
+        Returns:
+            The counters by name
+        """
+        with self._lock:
+            return dict(self._values)
+
+
+#: Counters of the tokenizer and colorizer, times in nanoseconds
+COUNTERS = Counters(
+    "lines_tokenized",
+    "tokenize_ns",
+    "colorize_ns",
+    "render_ns",
+    "compile_ns",
+)
+
+
+def stats() -> dict[str, Any]:
+    """Get a snapshot of pyonig's process wide metrics.
+
+    The counters are always on and only ever grow. Searches are counted by
+    the C extension, per regex or regset search made by the tokenizer or
+    through compile() and compile_regset().
+
+    Returns:
+        searches, matches and misses, bytes_scanned from each search start
+        to the end of the match or of the subject, regex_compiles made by
+        the engine and compile_seconds spent in the tokenizer's regex cache,
+        lines_tokenized, tokenize_seconds, colorize_seconds for styling the
+        tokens and render_seconds for building ANSI output, the memory budget
+        and, under ``caches``, the hits, misses, hit_ratio, evictions, entries
+        and bytes of each cache by name
+
+    Example:
+        >>> pyonig.highlight(code, language='python')
+        >>> pyonig.stats()['caches']['render']['hit_ratio']
+    """
+    native = _pyonig.stats()
+    counters = COUNTERS.snapshot()
+    budget = MEMORY_BUDGET.stats()
+    caches = {}
+    for name, metrics in sorted(budget["caches"].items()):
+        lookups = metrics.get("hits", 0) + metrics.get("misses", 0)
+        caches[name] = {**metrics, "hit_ratio": metrics.get("hits", 0) / lookups if lookups else 0.0}
+    return {
+        "searches": native["searches"],
+        "matches": native["matches"],
+        "misses": native["searches"] - native["matches"],
+        "bytes_scanned": native["bytes_scanned"],
+        "regex_compiles": native["compiles"],
+        "compile_seconds": counters["compile_ns"] / 1e9,
+        "lines_tokenized": counters["lines_tokenized"],
+        "tokenize_seconds": counters["tokenize_ns"] / 1e9,
+        "colorize_seconds": counters["colorize_ns"] / 1e9,
+        "render_seconds": counters["render_ns"] / 1e9,
+        "memory_bytes": budget["bytes"],
+        "memory_max_bytes": budget["max_bytes"],
+        "memory_evictions": budget["evictions"],
+        "caches": caches,
+    }
+
+
+# Metric name, type and help of each stats() entry, in exposition order
+_PROMETHEUS = (
+    ("searches", "counter", "Regex and regset searches"),
+    ("matches", "counter", "Searches that matched"),
+    ("misses", "counter", "Searches that did not match"),
+    ("bytes_scanned", "counter", "Bytes from each search start to the end of the match or subject"),
+    ("regex_compiles", "counter", "Regexes compiled by the engine"),
+    ("compile_seconds", "counter", "Time compiling the tokenizer's regexes and regsets"),
+    ("lines_tokenized", "counter", "Lines tokenized"),
+    ("tokenize_seconds", "counter", "Time tokenizing lines"),
+    ("colorize_seconds", "counter", "Time styling tokens"),
+    ("render_seconds", "counter", "Time building ANSI output"),
+    ("memory_bytes", "gauge", "Estimated bytes held by the caches of the memory budget"),
+    ("memory_max_bytes", "gauge", "Capacity of the memory budget"),
+    ("memory_evictions", "counter", "Entries evicted to stay within the memory budget"),
+)
+_PROMETHEUS_CACHE = (
+    ("hits", "counter", "Cache lookups that found an entry"),
+    ("misses", "counter", "Cache lookups that found no entry"),
+    ("evictions", "counter", "Cache entries evicted"),
+    ("entries", "gauge", "Cache entries"),
+    ("bytes", "gauge", "Estimated bytes held by the cache"),
+)
+
+
+def prometheus_text(snapshot: Optional[dict[str, Any]] = None, prefix: str = "pyonig") -> str:
+    """Format metrics in the Prometheus text exposition format.
+
+    Counters get a ``_total`` suffix, cache metrics a ``cache`` label.
+
+    Args:
+        snapshot: A snapshot from stats(), None to take one now
+        prefix: The prefix of every metric name
+
+    Returns:
+        The exposition, ending with a newline, e.g. to serve from a
+        ``/metrics`` endpoint
+
+    Example:
+        >>> print(pyonig.prometheus_text())
+        # HELP pyonig_searches_total Regex and regset searches
+        # TYPE pyonig_searches_total counter
+        pyonig_searches_total 1234
+        ...
+    """
+    if snapshot is None:
+        snapshot = stats()
+    lines = []
+
+    def family(name: str, kind: str, help_text: str) -> str:
+        metric = f"{prefix}_{name}_total" if kind == "counter" else f"{prefix}_{name}"
+        lines.append(f"# HELP {metric} {help_text}")
+        lines.append(f"# TYPE {metric} {kind}")
+        return metric
+
+    for name, kind, help_text in _PROMETHEUS:
+        metric = family(name, kind, help_text)
+        lines.append(f"{metric} {snapshot[name]}")
+    caches = snapshot["caches"]
+    for name, kind, help_text in _PROMETHEUS_CACHE:
+        metric = family(f"cache_{name}", kind, help_text)
+        for cache, metrics in caches.items():
+            lines.append(f'{metric}{{cache="{cache}"}} {metrics.get(name, 0)}')
+    return "\n".join(lines) + "\n"
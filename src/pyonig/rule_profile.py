@@ -0,0 +1,358 @@
+"""Per rule profiling of tokenizer searches, attributed to grammar rules."""
+from __future__ import annotations
+
+import re
+
+from collections.abc import Iterator
+from contextlib import contextmanager
+from typing import NamedTuple
+from typing import Union
+
+from pyonig.api import _grammars
+from pyonig.tm_tokenize.compiler import COMPILE_LOGS
+from pyonig.tm_tokenize.compiler import CompileLog
+from pyonig.tm_tokenize.grammars import Grammar
+from pyonig.tm_tokenize.grammars import Grammars
+from pyonig.tm_tokenize.reg import _BACKREF_RE
+from pyonig.tm_tokenize.reg import SEARCH_PROFILES
+from pyonig.tm_tokenize.reg import SearchProfile
+from pyonig.tm_tokenize.reg import _Reg
+from pyonig.tm_tokenize.reg import _RegSet
+from pyonig.tm_tokenize.rules import _Rule
+
+
+# Rule capture fields and their keys in grammar files
+_CAPTURE_KEYS = (
+    ("captures", "captures"),
+    ("begin_captures", "beginCaptures"),
+    ("end_captures", "endCaptures"),
+    ("while_captures", "whileCaptures"),
+)
+
+RegexKey = Union[str, tuple[str, ...]]
+# The grammar, rule path and kind of the rule a regex or regset belongs to
+Owner = tuple[str, str, str]
+
+#: Retries per character scanned above which a pattern is reported as backtracking
+RETRY_THRESHOLD = 100.0
+
+
+class RuleStats(NamedTuple):
+    """The searches of one regex or regset and the grammar rule it belongs to.
+
+    Attributes:
+        grammar: The grammar file name, or its scope, "?" if not found
+        rule: The rule's path in the grammar from its repository key, e.g.
+            ``#string/patterns/0``, ``patterns`` for the top level patterns
+        kind: ``regset`` for the patterns searched inside a rule, ``end`` or
+            ``while`` for its end or while regex, ``regex`` if not found
+        patterns: The number of patterns searched together
+        calls: The number of searches
+        seconds: The time spent in the regex engine
+        scanned: Characters, or bytes of bytes lines, from the search position
+            to the end of the match, or of the line without one
+        matches: The number of searches that matched
+        shared: The number of other rules with the same regex or regset,
+            whose searches are counted here too
+    """
+
+    grammar: str
+    rule: str
+    kind: str
+    patterns: int
+    calls: int
+    seconds: float
+    scanned: int
+    matches: int
+    shared: int
+
+
+class PatternRetries(NamedTuple):
+    """The retries of one pattern of a regex or regset and its grammar rule.
+
+    Attributes:
+        grammar: The grammar file name, or its scope, "?" if not found
+        rule: The rule's path in the grammar, as in RuleStats
+        kind: The kind of the regex or regset, as in RuleStats
+        index: The pattern's index in the regset, 0 for a regex
+        pattern: The pattern
+        retries: The times the regex engine backtracked in the pattern's
+            searches, counted by Oniguruma's retry counter
+        scanned: Characters, or bytes of bytes lines, the regex or regset
+            searched, as in RuleStats
+        per_char: Retries per character scanned
+    """
+
+    grammar: str
+    rule: str
+    kind: str
+    index: int
+    pattern: str
+    retries: int
+    scanned: int
+    per_char: float
+
+
+def _rule_paths(grammar: Grammar) -> dict[_Rule, str]:
+    """Name every rule of a grammar by its path from a repository key.
+
+    Args:
+        grammar: The grammar
+
+    Returns:
+        The path of each rule, repository entries are named before the
+        patterns that include them
+    """
+    paths: dict[_Rule, str] = {}
+
+    def visit(rule: _Rule, path: str, parent_repository: object) -> None:
+        if rule in paths:
+            return
+        paths[rule] = path
+        if rule.repository is not parent_repository:
+            # a rule with a repository starts a new link of the chain
+            for key, sub in rule.repository._mappings[-1].items():
+                visit(sub, f"{path}/repository/{key}", rule.repository)
+        for attribute, json_key in _CAPTURE_KEYS:
+            for n, sub in getattr(rule, attribute):
+                visit(sub, f"{path}/{json_key}/{n}", rule.repository)
+        for i, sub in enumerate(rule.patterns):
+            visit(sub, f"{path}/patterns/{i}", rule.repository)
+
+    repository = grammar.repository
+    if repository._mappings:
+        for key, rule in repository._mappings[-1].items():
+            visit(rule, f"#{key}", repository)
+    for i, rule in enumerate(grammar.patterns):
+        visit(rule, f"patterns/{i}", repository)
+    return paths
+
+
+def _template_re(template: str) -> re.Pattern[str]:
+    """Match the end or while patterns a template with back references expands to."""
+    parts = []
+    last = 0
+    for match in _BACKREF_RE.finditer(template):
+        parts.append(re.escape(template[last : match.start()] + match[1]))
+        parts.append(".*?")
+        last = match.end()
+    parts.append(re.escape(template[last:]))
+    return re.compile("".join(parts), re.DOTALL)
+
+
+class RuleProfile:
+    """Searches made by the tokenizer, per regex and regset, attributed to rules."""
+
+    def __init__(self, count_retries: bool = False) -> None:
+        """Initialize an empty profile, activated by profile_rules().
+
+        Args:
+            count_retries: Count the retries of each pattern searched
+        """
+        self.searches = SearchProfile(count_retries=count_retries)
+        self.log = CompileLog()
+
+    def _owners(
+        self,
+        grammars: Grammars,
+    ) -> tuple[dict[RegexKey, list[Owner]], list[tuple[re.Pattern[str], Owner]]]:
+        """Find the rules of the grammars highlighted by regex cache key.
+
+        Args:
+            grammars: The grammars to walk
+
+        Returns:
+            The rules of each key, and the end and while patterns with back
+            references, which are only known once expanded, and their rules
+        """
+        owners: dict[RegexKey, list[Owner]] = {}
+        templates: list[tuple[re.Pattern[str], Owner]] = []
+        paths: dict[Grammar, dict[_Rule, str]] = {}
+
+        def name(grammar: Grammar) -> str:
+            path = grammars.grammar_file(grammar.scope_name)
+            return grammar.scope_name if path is None else path.name
+
+        for scope in sorted(self.log.scopes):
+            try:
+                compiler = grammars.compiler_for_scope(scope)
+            except KeyError:
+                continue
+            root_grammar = grammars.grammar_for_scope(scope)
+            root_key = compiler.root_state.cur.rule.regset._patterns
+            owners.setdefault(root_key, []).append((name(root_grammar), "patterns", "regset"))
+
+            for rule, patterns in compiler.reachable_regsets().items():
+                grammar = compiler.rule_grammar(rule)
+                if grammar not in paths:
+                    paths[grammar] = _rule_paths(grammar)
+                owner = (name(grammar), paths[grammar].get(rule, "?"))
+                if patterns is not None:
+                    owners.setdefault(patterns, []).append((*owner, "regset"))
+                for kind, template in (("end", rule.end), ("while", rule.while_)):
+                    if template is None:
+                        continue
+                    if _BACKREF_RE.search(template):
+                        templates.append((_template_re(template), (*owner, kind)))
+                    else:
+                        owners.setdefault(template, []).append((*owner, kind))
+        return owners, templates
+
+    @staticmethod
+    def _find_owners(
+        searcher: _Reg | _RegSet,
+        owners: dict[RegexKey, list[Owner]],
+        templates: list[tuple[re.Pattern[str], Owner]],
+    ) -> list[Owner]:
+        """Find the rules of a regex or regset, the first one it is listed under."""
+        key: RegexKey = searcher._patterns if isinstance(searcher, _RegSet) else searcher._pattern
+        found = owners.get(key)
+        if key == ():
+            # the captures of every rule without patterns of their own
+            found = [(found[0][0] if found else "?", "(no patterns)", "regset")]
+        elif found is None and isinstance(searcher, _Reg):
+            found = [owner for regex, owner in templates if regex.fullmatch(key)]
+        if not found:
+            found = [("?", "?", "regset" if isinstance(searcher, _RegSet) else "regex")]
+        return found
+
+    def stats(self) -> list[RuleStats]:
+        """Get the searches of each regex and regset, the slowest first.
+
+        Returns:
+            The statistics of each regex and regset searched
+        """
+        owners, templates = self._owners(_grammars())
+        ret = []
+        for searcher, (calls, elapsed, scanned, matches) in list(self.searches.searches.items()):
+            patterns = len(searcher._patterns) if isinstance(searcher, _RegSet) else 1
+            found = self._find_owners(searcher, owners, templates)
+            grammar, rule, kind = found[0]
+            ret.append(
+                RuleStats(
+                    grammar=grammar,
+                    rule=rule,
+                    kind=kind,
+                    patterns=patterns,
+                    calls=calls,
+                    seconds=elapsed / 1e9,
+                    scanned=scanned,
+                    matches=matches,
+                    shared=len(found) - 1,
+                ),
+            )
+        ret.sort(key=lambda stat: stat.seconds, reverse=True)
+        return ret
+
+    def format(self, top: int = 20) -> str:
+        """Format the slowest regexes and regsets as a table.
+
+        Args:
+            top: The number of rows
+
+        Returns:
+            The table, with a total of all searches
+        """
+        stats = self.stats()
+        lines = [f"{'ms':>9} {'calls':>8} {'scanned':>10} {'matches':>8}  {'kind':<11} rule"]
+        for stat in stats[:top]:
+            kind = f"{stat.kind}({stat.patterns})" if stat.kind == "regset" else stat.kind
+            shared = f" (+{stat.shared} more)" if stat.shared else ""
+            lines.append(
+                f"{stat.seconds * 1000:9.2f} {stat.calls:8} {stat.scanned:10} {stat.matches:8}  "
+                f"{kind:<11} {stat.grammar} {stat.rule}{shared}",
+            )
+        seconds = sum(stat.seconds for stat in stats)
+        calls = sum(stat.calls for stat in stats)
+        lines.append(f"{seconds * 1000:9.2f} {calls:8} total in {len(stats)} regexes and regsets")
+        return "\n".join(lines)
+
+    def retries(self, threshold: float = 0.0) -> list[PatternRetries]:
+        """Get the retries of each pattern searched, the most per character first.
+
+        Retries are only counted by a profile made with count_retries=True.
+
+        Args:
+            threshold: Only the patterns with more retries per character scanned
+
+        Returns:
+            The retries of each pattern above the threshold
+        """
+        owners, templates = self._owners(_grammars())
+        scanned_by = {searcher: stats[2] for searcher, stats in list(self.searches.searches.items())}
+        ret = []
+        for searcher, counts in list(self.searches.retries.items()):
+            grammar, rule, kind = self._find_owners(searcher, owners, templates)[0]
+            patterns = searcher._patterns if isinstance(searcher, _RegSet) else (searcher._pattern,)
+            scanned = scanned_by.get(searcher, 0)
+            for index, (pattern, retries) in enumerate(zip(patterns, counts)):
+                per_char = retries / max(scanned, 1)
+                if per_char > threshold:
+                    ret.append(
+                        PatternRetries(
+                            grammar=grammar,
+                            rule=rule,
+                            kind=kind,
+                            index=index,
+                            pattern=pattern,
+                            retries=retries,
+                            scanned=scanned,
+                            per_char=per_char,
+                        ),
+                    )
+        ret.sort(key=lambda stat: stat.per_char, reverse=True)
+        return ret
+
+    def format_retries(self, threshold: float = RETRY_THRESHOLD, top: int = 20) -> str:
+        """Format the patterns backtracking the most as a table.
+
+        Args:
+            threshold: Only the patterns with more retries per character scanned
+            top: The number of rows
+
+        Returns:
+            The table, with the number of patterns over the threshold
+        """
+        stats = self.retries(threshold)
+        lines = [f"{'per char':>9} {'retries':>10} {'scanned':>10}  {'kind':<11} rule"]
+        for stat in stats[:top]:
+            kind = f"{stat.kind}[{stat.index}]" if stat.kind == "regset" else stat.kind
+            pattern = stat.pattern if len(stat.pattern) <= 60 else f"{stat.pattern[:57]}..."
+            lines.append(
+                f"{stat.per_char:9.1f} {stat.retries:10} {stat.scanned:10}  "
+                f"{kind:<11} {stat.grammar} {stat.rule} {pattern!r}",
+            )
+        lines.append(f"{len(stats)} patterns over {threshold:g} retries per character")
+        return "\n".join(lines)
+
+
+@contextmanager
+def profile_rules(count_retries: bool = False) -> Iterator[RuleProfile]:
+    """Profile the tokenizer's searches, per regex and regset.
+
+    Every search made while the block runs, on any thread, is counted and
+    timed. Each regex and regset is attributed to the grammar file and rule
+    it was compiled for when the statistics are read. Searches are only
+    timed while a profile is active.
+
+    Args:
+        count_retries: Also count how often each pattern backtracks, by
+            searching with copies of the regexes compiled with retry
+            counting callouts. This slows the searches, and so their times
+
+    Yields:
+        The profile being recorded into
+
+    Example:
+        >>> with pyonig.profile_rules() as profile:
+        ...     pyonig.highlight(code, language='typescript')
+        >>> print(profile.format(top=10))
+    """
+    profile = RuleProfile(count_retries=count_retries)
+    COMPILE_LOGS.append(profile.log)
+    SEARCH_PROFILES.append(profile.searches)
+    try:
+        yield profile
+    finally:
+        SEARCH_PROFILES.remove(profile.searches)
+        COMPILE_LOGS.remove(profile.log)
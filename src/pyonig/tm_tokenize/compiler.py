@@ -1,9 +1,11 @@
 from __future__ import annotations
 
-import functools
+import time
 
 from typing import TYPE_CHECKING
+from typing import Any
 
+from .reg import _BACKREF_RE
 from .reg import make_regset
 from .rules import EndRule
 from .rules import Entry
@@ -22,6 +24,42 @@ if TYPE_CHECKING:
     from .rules import _Rule
 
 
+# Estimated footprint of a compiled rule and of a memoized pattern list
+_RULE_BYTES = 512
+_MEMO_BYTES = 256
+
+
+class CompileLog:
+    """The scopes and regexes compiled while the log is active."""
+
+    def __init__(self) -> None:
+        """Initialize an empty log, add it to COMPILE_LOGS to activate it."""
+        self.scopes: set[str] = set()
+        self.regexes: set[str | tuple[str, ...]] = set()
+
+
+#: Active compile logs, recording for profile guided warmup
+COMPILE_LOGS: list[CompileLog] = []
+
+
+def rule_regexes(rule: _Rule, regs: tuple[str, ...] | None) -> list[str | tuple[str, ...]]:
+    """Get the regex cache keys of the regexes a rule needs once compiled.
+
+    Args:
+        rule: The rule
+        regs: The patterns of its regset, None for match rules
+
+    Returns:
+        The regset patterns and the end or while pattern, unless it refers
+        to the begin match and so is only known when tokenizing
+    """
+    ret: list[str | tuple[str, ...]] = [] if regs is None else [regs]
+    for s in (rule.end, rule.while_):
+        if s is not None and not _BACKREF_RE.search(s):
+            ret.append(s)
+    return ret
+
+
 class Compiler:
     def __init__(self, grammar: Grammar, grammars: Grammars) -> None:
         """Initialize the grammar compiler.
@@ -34,6 +72,9 @@ class Compiler:
         self._grammars = grammars
         self._rule_to_grammar: dict[_Rule, Grammar] = {}
         self._c_rules: dict[_Rule, CompiledRule] = {}
+        # Memoized per instance so an evicted compiler is freed with them
+        self._include_memo: dict[tuple[Any, ...], tuple[list[str], tuple[_Rule, ...]]] = {}
+        self._patterns_memo: dict[tuple[Any, ...], tuple[list[str], tuple[_Rule, ...]]] = {}
         root = self._compile_root(grammar)
         self.root_state = State.root(Entry(root.name, root, ("", 0)))
 
@@ -41,12 +82,37 @@ class Compiler:
         self._rule_to_grammar[rule] = grammar
         return rule
 
-    @functools.cache  # noqa: B019
+    @property
+    def root_scope(self) -> str:
+        """The scope name of the grammar compiled."""
+        return self._root_scope
+
+    @property
+    def nbytes(self) -> int:
+        """The estimated size of the compiled rules and memoized patterns."""
+        rules = len(self._c_rules) + len(self._rule_to_grammar)
+        memos = len(self._include_memo) + len(self._patterns_memo)
+        return rules * _RULE_BYTES + memos * _MEMO_BYTES
+
     def _include(
         self,
         grammar: Grammar,
         repository: FChainMap[str, _Rule],
         s: str,
+    ) -> tuple[list[str], tuple[_Rule, ...]]:
+        key = (grammar, repository, s)
+        try:
+            return self._include_memo[key]
+        except KeyError:
+            pass
+        ret = self._include_memo[key] = self._include_uncached(grammar, repository, s)
+        return ret
+
+    def _include_uncached(
+        self,
+        grammar: Grammar,
+        repository: FChainMap[str, _Rule],
+        s: str,
     ) -> tuple[list[str], tuple[_Rule, ...]]:
         if s == "$self":
             return self._patterns(grammar, grammar.patterns)
@@ -62,11 +128,23 @@ class Compiler:
         grammar = self._grammars.grammar_for_scope(scope)
         return self._include(grammar, grammar.repository, f"#{s}")
 
-    @functools.cache  # noqa: B019
     def _patterns(
         self,
         grammar: Grammar,
         rules: tuple[_Rule, ...],
+    ) -> tuple[list[str], tuple[_Rule, ...]]:
+        key = (grammar, rules)
+        try:
+            return self._patterns_memo[key]
+        except KeyError:
+            pass
+        ret = self._patterns_memo[key] = self._patterns_uncached(grammar, rules)
+        return ret
+
+    def _patterns_uncached(
+        self,
+        grammar: Grammar,
+        rules: tuple[_Rule, ...],
     ) -> tuple[list[str], tuple[_Rule, ...]]:
         ret_regs = []
         ret_rules: list[_Rule] = []
@@ -95,6 +173,8 @@ class Compiler:
 
     def _compile_root(self, grammar: Grammar) -> PatternRule:
         regs, rules = self._patterns(grammar, grammar.patterns)
+        for log in COMPILE_LOGS:
+            log.regexes.add(tuple(regs))
         return PatternRule((grammar.scope_name,), make_regset(*regs), rules)
 
     def _compile_rule(self, grammar: Grammar, rule: _Rule) -> CompiledRule:
@@ -127,12 +207,58 @@ class Compiler:
         regs, rules = self._patterns(grammar, rule.patterns)
         return PatternRule(rule.name, make_regset(*regs), rules)
 
+    def reachable_regsets(self) -> dict[_Rule, tuple[str, ...] | None]:
+        """Find the rules reachable from the root without compiling any regex.
+
+        Rules including a grammar that is not available are left out, they
+        fail when reached during tokenization as before.
+
+        Returns:
+            Each rule and the patterns of its regset, None for match rules
+        """
+        ret: dict[_Rule, tuple[str, ...] | None] = {}
+        # The rules of the root regset, visited when the root was compiled
+        todo = list(self._rule_to_grammar)
+        while todo:
+            rule = todo.pop()
+            if rule in ret or rule.include is not None:
+                continue
+            grammar = self._rule_to_grammar[rule]
+            for captures in (
+                rule.captures,
+                rule.begin_captures,
+                rule.end_captures,
+                rule.while_captures,
+            ):
+                todo.extend(capture for _, capture in self._captures_ref(grammar, captures))
+            if rule.match is not None:
+                ret[rule] = None
+                continue
+            try:
+                regs, rules = self._patterns(grammar, rule.patterns)
+            except KeyError:
+                continue
+            ret[rule] = tuple(regs)
+            todo.extend(rules)
+        return ret
+
+    def rule_grammar(self, rule: _Rule) -> Grammar:
+        """Get the grammar of a rule reached from the root."""
+        return self._rule_to_grammar[rule]
+
     def compile_rule(self, rule: _Rule) -> CompiledRule:
         try:
             return self._c_rules[rule]
         except KeyError:
             pass
 
+        nbytes = self.nbytes
+        began = time.perf_counter()
         grammar = self._rule_to_grammar[rule]
         ret = self._c_rules[rule] = self._compile_rule(grammar, rule)
+        self._grammars.compiler_grew(self, self.nbytes - nbytes, time.perf_counter() - began)
+        if COMPILE_LOGS:
+            regs = None if rule.match is not None else tuple(self._patterns(grammar, rule.patterns)[0])
+            for log in COMPILE_LOGS:
+                log.regexes.update(rule_regexes(rule, regs))
         return ret
@@ -2,16 +2,30 @@ from __future__ import annotations
 
 import json
 import os
+import time
 
 from pathlib import Path
 from typing import Any
+from typing import Callable
+from typing import Iterable
 from typing import NamedTuple
 from typing import TypeVar
 
+import pyonig as onigurumacffi
+
+from pyonig.cache import MEMORY_BUDGET
+from pyonig.cache import ByteBoundedCache
+from pyonig.trace import TRACES
+from pyonig.trace import add_span
+
+from .compiler import COMPILE_LOGS
 from .compiler import Compiler
+from .compiler import rule_regexes
 from .fchainmap import FChainMap
+from .reg import REGEX_CACHE
 from .reg import _Reg
 from .reg import make_reg
+from .reg import make_regset
 from .rules import Rule
 from .rules import _Rule
 from .utils import uniquely_constructed
@@ -19,6 +33,10 @@ from .utils import uniquely_constructed
 
 T = TypeVar("T")
 
+# Estimated footprint of a parsed grammar, relative to its JSON and minimum
+_GRAMMAR_BYTES_PER_JSON_BYTE = 4
+_GRAMMAR_MIN_BYTES = 1024
+
 
 @uniquely_constructed
 class Grammar(NamedTuple):
@@ -42,6 +60,18 @@ class Grammar(NamedTuple):
         return cls(scope_name=scope_name, repository=repository, patterns=patterns)
 
 
+def _try_compile(key: str | tuple[str, ...]) -> bool:
+    """Compile a regex or regset into the regex cache, invalid ones fail when used."""
+    try:
+        if isinstance(key, tuple):
+            make_regset(*key)
+        else:
+            make_reg(key)
+    except onigurumacffi.OnigError:
+        return False
+    return True
+
+
 class Grammars:
     def __init__(self, *directories: str) -> None:
         """Initialize an instance of Grammars.
@@ -60,10 +90,13 @@ class Grammars:
 
         unknown_grammar = {"scopeName": "source.unknown", "patterns": []}
         self._raw = {"source.unknown": unknown_grammar}
+        self._raw_sizes: dict[str, int] = {}
+        self._raw_paths: dict[str, Path] = {}
         self._file_types: list[tuple[frozenset[str], str]] = []
         self._first_line: list[tuple[_Reg, str]] = []
-        self._parsed: dict[str, Grammar] = {}
-        self._compiled: dict[str, Compiler] = {}
+        # Parsed and compiled grammars are rebuilt from the raw JSON on demand
+        self._parsed = ByteBoundedCache(None, budget=MEMORY_BUDGET, name="grammar")
+        self._compiled = ByteBoundedCache(None, budget=MEMORY_BUDGET, name="compiler")
 
     def _raw_for_scope(self, scope: str) -> dict[str, Any]:
         try:
@@ -74,6 +107,8 @@ class Grammars:
         grammar_path = Path(self._scope_to_files.pop(scope))
         with grammar_path.open(encoding="UTF-8") as f:
             ret = self._raw[scope] = json.load(f)
+        self._raw_sizes[scope] = grammar_path.stat().st_size
+        self._raw_paths[scope] = grammar_path
 
         file_types = frozenset(ret.get("fileTypes", ()))
         first_line = make_reg(ret.get("firstLineMatch", "$impossible^"))
@@ -83,26 +118,101 @@ class Grammars:
 
         return ret
 
+    def grammar_file(self, scope: str) -> Path | None:
+        """Get the file a loaded grammar was read from, None if not read from one."""
+        return self._raw_paths.get(scope)
+
     def grammar_for_scope(self, scope: str) -> Grammar:
-        try:
-            return self._parsed[scope]
-        except KeyError:
-            pass
+        ret = self._parsed.get(scope)
+        if ret is not None:
+            return ret
 
+        traced = time.perf_counter_ns() if TRACES else 0
         raw = self._raw_for_scope(scope)
-        ret = self._parsed[scope] = Grammar.make(raw)
+        began = time.perf_counter()
+        ret = Grammar.make(raw)
+        if traced:
+            add_span("grammar_load", traced, scope=scope)
+        size = max(
+            _GRAMMAR_MIN_BYTES,
+            self._raw_sizes.get(scope, 0) * _GRAMMAR_BYTES_PER_JSON_BYTE,
+        )
+        self._parsed.put(scope, ret, size, time.perf_counter() - began)
         return ret
 
     def compiler_for_scope(self, scope: str) -> Compiler:
-        try:
-            return self._compiled[scope]
-        except KeyError:
-            pass
+        for log in COMPILE_LOGS:
+            log.scopes.add(scope)
+        ret = self._compiled.get(scope)
+        if ret is not None:
+            return ret
 
         grammar = self.grammar_for_scope(scope)
-        ret = self._compiled[scope] = Compiler(grammar, self)
+        traced = time.perf_counter_ns() if TRACES else 0
+        began = time.perf_counter()
+        ret = Compiler(grammar, self)
+        if traced:
+            add_span("compile", traced, scope=scope)
+        self._compiled.put(scope, ret, ret.nbytes, time.perf_counter() - began)
         return ret
 
+    def compiler_grew(self, compiler: Compiler, size: int, cost: float) -> None:
+        """Account for rules a cached compiler has compiled since it was stored.
+
+        Args:
+            compiler: The compiler
+            size: The estimated size of the rules in bytes
+            cost: The time taken to compile them in seconds
+        """
+        self._compiled.grow(compiler.root_scope, compiler, size, cost)
+
+    def warmup(
+        self,
+        scopes: Iterable[str],
+        max_workers: int | None = None,
+        keep: Callable[[str | tuple[str, ...]], bool] | None = None,
+    ) -> int:
+        """Compile the regexes reachable from some scopes, in parallel.
+
+        The grammars are walked on the calling thread, the regsets and end
+        and while regexes are then compiled on a thread pool, regex
+        compilation releases the GIL, and finally the rules are compiled,
+        finding their regsets cached.
+
+        Args:
+            scopes: The scopes, unknown ones are skipped
+            max_workers: The number of threads, the executor default if None
+            keep: Select the regexes to compile by regex cache key, all if None
+
+        Returns:
+            The number of regexes compiled
+        """
+        reachable = []
+        for scope in scopes:
+            try:
+                compiler = self.compiler_for_scope(scope)
+            except KeyError:
+                continue
+            reachable.append((compiler, compiler.reachable_regsets()))
+
+        pending = {
+            key
+            for _, rules in reachable
+            for rule, patterns in rules.items()
+            for key in rule_regexes(rule, patterns)
+            if key not in REGEX_CACHE and (keep is None or keep(key))
+        }
+        from concurrent.futures import ThreadPoolExecutor
+
+        with ThreadPoolExecutor(max_workers) as pool:
+            compiled = sum(pool.map(_try_compile, pending))
+
+        for compiler, rules in reachable:
+            for rule, patterns in rules.items():
+                if patterns is None or patterns in REGEX_CACHE:
+                    compiler.compile_rule(rule)
+        return compiled
+
     def blank_compiler(self) -> Compiler:
         return self.compiler_for_scope("source.unknown")
 
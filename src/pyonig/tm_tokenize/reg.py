@@ -2,18 +2,34 @@
 # Source: https://github.com/ansible/ansible-navigator
 # Original file: src/ansible_navigator/tm_tokenize/reg.py
 # License: Apache-2.0
-# Modifications: Changed "import onigurumacffi" to "import pyonig as onigurumacffi"
+# Modifications: Changed "import onigurumacffi" to "import pyonig as onigurumacffi",
+#   expand_escaped() accepts matches on UTF-8 bytes lines,
+#   make_reg()/make_regset() cache in the shared memory budget,
+#   long lines are searched as a LineBuffer, a regset one pattern at a time,
+#   searches are timed into any active SearchProfile,
+#   counting retries for profiles counting them,
+#   compile time is added to pyonig.stats() and any active trace
 
 from __future__ import annotations
 
-import functools
+import heapq
 import re
+import threading
+import time
 
+from collections.abc import Sequence
 from re import Match
 from typing import TYPE_CHECKING
+from typing import Any
 
 import pyonig as onigurumacffi
 
+from pyonig.cache import MEMORY_BUDGET
+from pyonig.cache import ByteBoundedCache
+from pyonig.metrics import COUNTERS
+from pyonig.trace import TRACES
+from pyonig.trace import add_span
+
 from .region import Region
 
 
@@ -48,30 +64,143 @@ _FLAGS = {
 }
 
 
+class SearchProfile:
+    """The searches made while the profile is active, per regex and regset."""
+
+    def __init__(self, count_retries: bool = False) -> None:
+        """Initialize an empty profile, add it to SEARCH_PROFILES to activate it.
+
+        Args:
+            count_retries: Search with regexes compiled to count their retries
+                while the profile is active, which slows the searches
+        """
+        self.count_retries = count_retries
+        # calls, nanoseconds searching, characters or bytes scanned, matches
+        self.searches: dict[_Reg | _RegSet, list[int]] = {}
+        # retries of each pattern of the regex or regset, when counted
+        self.retries: dict[_Reg | _RegSet, list[int]] = {}
+        self._lock = threading.Lock()
+
+    def add(
+        self,
+        searcher: _Reg | _RegSet,
+        elapsed: int,
+        scanned: int,
+        matched: bool,
+        retries: Sequence[int] = (),
+    ) -> None:
+        with self._lock:
+            stats = self.searches.get(searcher)
+            if stats is None:
+                stats = self.searches[searcher] = [0, 0, 0, 0]
+            stats[0] += 1
+            stats[1] += elapsed
+            stats[2] += scanned
+            stats[3] += matched
+            if retries:
+                counts = self.retries.get(searcher)
+                if counts is None:
+                    counts = self.retries[searcher] = [0] * len(retries)
+                for i, n in enumerate(retries):
+                    counts[i] += n
+
+
+#: Active search profiles, recording for the rule profiler
+SEARCH_PROFILES: list[SearchProfile] = []
+
+
+def _counting_retries() -> bool:
+    return any(profile.count_retries for profile in SEARCH_PROFILES)
+
+
+def _retries_since(compiled: Any, before: Any) -> Sequence[int]:
+    """Get the retries of each pattern since before, () if not counted."""
+    if before is None:
+        return ()
+    after = compiled.retries
+    if isinstance(after, int):
+        return (after - before,)
+    return tuple(n - m for n, m in zip(after, before))
+
+
+def _record(
+    searcher: _Reg | _RegSet,
+    began: int,
+    line: str,
+    pos: int,
+    match: Match[str] | None,
+    retries: Sequence[int] = (),
+) -> None:
+    elapsed = time.perf_counter_ns() - began
+    scanned = (len(line) if match is None else match.end()) - pos
+    for profile in SEARCH_PROFILES:
+        profile.add(searcher, elapsed, max(scanned, 0), match is not None, retries)
+
+
 class _Reg:
     def __init__(self, s: str) -> None:
         self._pattern = s
         self._reg = onigurumacffi.compile(self._pattern)
+        self._counting_reg: Any = None
+        # a \G match depends on where the search starts
+        self._start_anchored = "\\G" in s
 
     def __repr__(self) -> str:
         return f"{type(self).__name__}({self._pattern!r})"
 
+    def _counting(self) -> Any:
+        """Get the regex compiled to count retries, for profiles counting them."""
+        if self._counting_reg is None:
+            self._counting_reg = onigurumacffi.compile(self._pattern, count_retries=True)
+        return self._counting_reg
+
     def search(self, line: str, pos: int, first_line: bool, boundary: bool) -> Match[str] | None:
-        return self._reg.search(line, pos, flags=_FLAGS[first_line, boundary])
+        began = time.perf_counter_ns() if SEARCH_PROFILES else 0
+        reg = self._counting() if began and _counting_retries() else self._reg
+        before = reg.retries if began else None
+        if type(line) is LineBuffer and not self._start_anchored:
+            match = line.search(self, reg, pos, _FLAGS[first_line, boundary])
+        else:
+            match = reg.search(line, pos, flags=_FLAGS[first_line, boundary])
+        if began:
+            _record(self, began, line, pos, match, _retries_since(reg, before))
+        return match
 
     def match(self, line: str, pos: int, first_line: bool, boundary: bool) -> Match[str] | None:
-        return self._reg.match(line, pos, flags=_FLAGS[first_line, boundary])
+        began = time.perf_counter_ns() if SEARCH_PROFILES else 0
+        reg = self._counting() if began and _counting_retries() else self._reg
+        before = reg.retries if began else None
+        match = reg.match(line, pos, flags=_FLAGS[first_line, boundary])
+        if began:
+            _record(self, began, line, pos, match, _retries_since(reg, before))
+        return match
 
 
 class _RegSet:
     def __init__(self, *s: str) -> None:
         self._patterns = s
         self._set = onigurumacffi.compile_regset(*self._patterns)
+        self._counting_set: Any = None
+        self._regs: tuple[Any, ...] | None = None
+        # the patterns whose \G match depends on where the search starts
+        self._anchored = tuple(i for i, p in enumerate(s) if "\\G" in p)
 
     def __repr__(self) -> str:
         args = ", ".join(repr(s) for s in self._patterns)
         return f"{type(self).__name__}({args})"
 
+    def _counting(self) -> Any:
+        """Get the regset compiled to count retries, for profiles counting them."""
+        if self._counting_set is None:
+            self._counting_set = onigurumacffi.compile_regset(*self._patterns, count_retries=True)
+        return self._counting_set
+
+    def regs(self) -> tuple[Any, ...]:
+        """Get the regex of each pattern, shared with the regset."""
+        if self._regs is None:
+            self._regs = tuple(onigurumacffi.compile(p) for p in self._patterns)
+        return self._regs
+
     def search(
         self,
         line: str,
@@ -79,7 +208,169 @@ class _RegSet:
         first_line: bool,
         boundary: bool,
     ) -> tuple[int, Match[str] | None]:
-        return self._set.search(line, pos, flags=_FLAGS[first_line, boundary])
+        began = time.perf_counter_ns() if SEARCH_PROFILES else 0
+        regset = self._counting() if began and _counting_retries() else self._set
+        before = regset.retries if began else None
+        if type(line) is LineBuffer and regset is self._set and pos < len(line):
+            found = line.search_regset(self, pos, _FLAGS[first_line, boundary])
+        else:
+            found = regset.search(line, pos, flags=_FLAGS[first_line, boundary])
+        if began:
+            _record(self, began, line, pos, found[1], _retries_since(regset, before))
+        return found
+
+
+#: Retries a pattern of a regset may take searching ahead on a long line
+PATTERN_RETRIES = 100_000
+
+#: Searches of a regset on a long line before its patterns are searched one by one
+REGSET_CALLS = 16
+
+
+class _PatternSearches:
+    """The searches of the patterns of a regset along a LineBuffer.
+
+    The next match of each pattern is kept in a heap by (start, index), and
+    a pattern is searched again once the position passes its match.  The
+    regset takes the earliest match, the first pattern on a tie.
+
+    Searching a pattern on its own tries it further ahead than the regset
+    would, which is quadratic for a pattern such as an identifier followed
+    by a lookahead, retried at each start in a long identifier.  A pattern
+    taking more than PATTERN_RETRIES retries is hard: the hard patterns are
+    only matched at each position before the earliest match of the others,
+    the positions the regset would try them at.
+    \\G patterns depend on the search start and are always searched.
+    """
+
+    __slots__ = ("pos", "heap", "matches", "hard", "hard_from", "hard_best")
+
+    def __init__(self, regset: _RegSet, pos: int) -> None:
+        self.pos = pos
+        # the unanchored patterns, all to be searched
+        self.heap = [(-1, idx) for idx in range(len(regset.regs())) if idx not in regset._anchored]
+        self.matches: list[Match[str] | None] = [None] * len(regset.regs())
+        self.hard: tuple[int, ...] = ()
+        # no hard pattern matches from pos to hard_from, and hard_best is
+        # the match of one at hard_from if it was found
+        self.hard_from = pos
+        self.hard_best: tuple[int, int, Match[str]] | None = None
+
+    def search(self, line: LineBuffer, regset: _RegSet, pos: int, flags: int) -> tuple[int, Match[str] | None]:
+        regs = regset.regs()
+        never = len(line) + 1
+        heap, matches = self.heap, self.matches
+        self.pos = pos
+        while heap and heap[0][0] < pos:
+            idx = heap[0][1]
+            try:
+                match = matches[idx] = regs[idx].search(line, pos, flags=flags, retry_limit=PATTERN_RETRIES)
+            except onigurumacffi.OnigError:
+                heapq.heappop(heap)
+                self.hard = tuple(sorted((*self.hard, idx)))
+                self.hard_from, self.hard_best = pos, None
+                continue
+            heapq.heapreplace(heap, (never if match is None else match.start(), idx))
+
+        start, idx = heap[0] if heap else (never, -1)
+        best = matches[idx] if start < never else None
+        if self.hard:
+            found = self._search_hard(line, regset, pos, flags, start)
+            if found is not None and found[:2] < (start, idx):
+                start, idx, best = found
+        for i in regset._anchored:
+            if start == pos and i > idx:
+                break
+            match = regs[i].search(line, pos, flags=flags)
+            if match is not None and (match.start(), i) < (start, idx):
+                start, idx, best = match.start(), i, match
+        return (idx, best) if best is not None else (-1, None)
+
+    def _search_hard(
+        self,
+        line: LineBuffer,
+        regset: _RegSet,
+        pos: int,
+        flags: int,
+        start: int,
+    ) -> tuple[int, int, Match[str]] | None:
+        """Match the hard patterns at each position up to start."""
+        if self.hard_from < pos:
+            self.hard_from, self.hard_best = pos, None
+        regs = regset.regs()
+        while self.hard_best is None and self.hard_from <= start:
+            for idx in self.hard:
+                match = regs[idx].match(line, self.hard_from, flags=flags)
+                if match is not None:
+                    self.hard_best = (self.hard_from, idx, match)
+                    break
+            else:
+                self.hard_from += 1
+        return self.hard_best
+
+
+class LineBuffer(bytes):
+    """A long line as UTF-8 bytes, kept for all the searches of the line.
+
+    A search from a position finds the earliest match at or after it, so
+    the match stays the answer for later positions up to its start, and no
+    match stays the answer to the end of the line.  While a rule is open
+    its end is searched for from every position, and on a long line the end
+    is often far away, so each search would scan the rest of the line.  The
+    last match of each end regex is kept and reused while it is still ahead.
+
+    The patterns of a regset are searched the same way, one by one, see
+    _PatternSearches.  Searching the regset itself scans the rest of the
+    line from every position for a pattern found late or never, but each
+    pattern on its own is tried further ahead than the regset would, a
+    waste for a rule open for a few steps.  So a regset is only searched
+    one pattern at a time after its first REGSET_CALLS searches of a line.
+
+    The boundary flag only changes where \\G matches, so it is left out of
+    the kept searches.  The matches refer back to the buffer, so they must
+    be released with release() once the line is tokenized.
+    """
+
+    def __init__(self, data: bytes) -> None:
+        super().__init__()
+        self._searches: dict[tuple[_Reg, int], tuple[int, int | None, Match[str] | None]] = {}
+        self._regsets: dict[tuple[_RegSet, int], _PatternSearches] = {}
+        self._calls: dict[tuple[_RegSet, int], int] = {}
+
+    def search(self, reg: _Reg, compiled: Any, pos: int, flags: int) -> Match[str] | None:
+        searches = self._searches
+        key = (reg, flags & ~onigurumacffi.ONIG_OPTION_NOT_BEGIN_POSITION)
+        found = searches.get(key)
+        if found is not None and pos < len(self):
+            searched_from, match_start, match = found
+            if searched_from <= pos and (match is None or pos <= match_start):
+                return match
+
+        match = compiled.search(self, pos, flags=flags)
+        searches[key] = (pos, None if match is None else match.start(), match)
+        return match
+
+    def search_regset(self, regset: _RegSet, pos: int, flags: int) -> tuple[int, Match[str] | None]:
+        key = (regset, flags & ~onigurumacffi.ONIG_OPTION_NOT_BEGIN_POSITION)
+        searches = self._regsets.get(key)
+        if searches is None or pos < searches.pos:
+            # a rule open for a few steps is cheaper to search as a regset
+            calls = self._calls[key] = self._calls.get(key, 0) + 1
+            if calls <= REGSET_CALLS:
+                return regset._set.search(self, pos, flags=flags)
+            searches = self._regsets[key] = _PatternSearches(regset, pos)
+        try:
+            return searches.search(self, regset, pos, flags)
+        except onigurumacffi.OnigError:
+            # the regset takes a pattern failing, e.g. over the retry limit
+            # in a match, as no match at all, so it answers for this position
+            del self._regsets[key]
+            return regset._set.search(self, pos, flags=flags)
+
+    def release(self) -> None:
+        self._searches.clear()
+        self._regsets.clear()
+        self._calls.clear()
 
 
 def do_regset(
@@ -104,10 +395,54 @@ def do_regset(
     return state, match.end(), boundary, tuple(ret)
 
 
+def _group_text(match: Match[str], n: int) -> str:
+    group = match[n]
+    # lines tokenized as UTF-8 bytes have bytes groups
+    return group.decode("UTF-8") if isinstance(group, bytes) else group
+
+
 def expand_escaped(match: Match[str], s: str) -> str:
-    return _BACKREF_RE.sub(lambda m: f"{m[1]}{re.escape(match[int(m[2])])}", s)
+    return _BACKREF_RE.sub(lambda m: f"{m[1]}{re.escape(_group_text(match, int(m[2])))}", s)
+
+
+# Estimated footprint of a compiled regex, fixed part and per pattern character.
+# Regsets share the regexes of their patterns, so this over-counts what
+# evicting one frees
+_REG_OVERHEAD = 1024
+_REG_BYTES_PER_CHAR = 64
+
+#: Compiled regexes and regsets, keyed by pattern or tuple of patterns
+REGEX_CACHE = ByteBoundedCache(None, budget=MEMORY_BUDGET, name="regex")
+
+
+def _reg_size(patterns: tuple[str, ...]) -> int:
+    return sum(_REG_OVERHEAD + _REG_BYTES_PER_CHAR * len(s) for s in patterns)
+
+
+def make_reg(s: str) -> _Reg:
+    reg = REGEX_CACHE.get(s)
+    if reg is None:
+        began = time.perf_counter_ns()
+        reg = _Reg(s)
+        elapsed = time.perf_counter_ns() - began
+        COUNTERS.add(compile_ns=elapsed)
+        if TRACES:
+            add_span("compile", began, patterns=1)
+        REGEX_CACHE.put(s, reg, _reg_size((s,)), elapsed / 1e9)
+    return reg
+
+
+def make_regset(*s: str) -> _RegSet:
+    regset = REGEX_CACHE.get(s)
+    if regset is None:
+        began = time.perf_counter_ns()
+        regset = _RegSet(*s)
+        elapsed = time.perf_counter_ns() - began
+        COUNTERS.add(compile_ns=elapsed)
+        if TRACES:
+            add_span("compile", began, patterns=len(s))
+        REGEX_CACHE.put(s, regset, _reg_size(s), elapsed / 1e9)
+    return regset
 
 
-make_reg = functools.cache(_Reg)
-make_regset = functools.cache(_RegSet)
 ERR_REG = make_reg("$ ^")
@@ -157,8 +157,8 @@ class EndRule(NamedTuple):
         # we'll advance the highlighter by one position to get past the loop
         # this appears to be what vs code does as well
         if state.entries[-1].start == (m.string, m.end()):
-            ret.append(Region(m.end(), m.end() + 1, state.cur.scope))
-            end = m.end() + 1
+            end = m.end() + _char_len(m.string, m.end())
+            ret.append(Region(m.end(), end, state.cur.scope))
         else:
             end = m.end()
         return state.pop(), end, False, tuple(ret)
@@ -393,6 +393,13 @@ class WhileRule(NamedTuple):
         return do_regset(idx, match, self, compiler, state, pos)
 
 
+def _char_len(s: str | bytes, pos: int) -> int:
+    # offsets into UTF-8 bytes lines are byte offsets, step a whole character
+    if isinstance(s, str) or pos >= len(s) or s[pos] < 0xC0:
+        return 1
+    return 2 if s[pos] < 0xE0 else 3 if s[pos] < 0xF0 else 4
+
+
 def _captures(
     compiler: Compiler,
     scope: Scope,
@@ -1,37 +1,121 @@
 from __future__ import annotations
 
+from collections.abc import Iterable
+from collections.abc import Iterator
 from typing import TYPE_CHECKING
+from typing import Any
+from typing import Generic
 from typing import NamedTuple
+from typing import TypeVar
 
 
 if TYPE_CHECKING:
     from .rules import Entry
     from .rules import WhileRule
 
+_T = TypeVar("_T")
+
+
+class Stack(Generic[_T]):
+    """An immutable stack sharing the items below its top with the stack it
+    was pushed on.
+
+    Pushing and popping take the same time however deep the stack is, where
+    copying a tuple makes a line opening many nested rules quadratic.  The
+    top, ``[-1]``, and the bottom items, ``[:n]``, are read as from a tuple.
+    """
+
+    __slots__ = ("_cell", "_len")
+
+    def __init__(self, items: Iterable[_T] = ()) -> None:
+        # each cell is (item, the cell below)
+        cell: tuple[Any, Any] | None = None
+        n = 0
+        for item in items:
+            cell, n = (item, cell), n + 1
+        self._cell = cell
+        self._len = n
+
+    @classmethod
+    def _of(cls, cell: tuple[Any, Any] | None, n: int) -> Stack[_T]:
+        stack = cls.__new__(cls)
+        stack._cell = cell
+        stack._len = n
+        return stack
+
+    def push(self, item: _T) -> Stack[_T]:
+        return Stack._of((item, self._cell), self._len + 1)
+
+    def pop(self) -> Stack[_T]:
+        if self._cell is None:
+            raise IndexError("pop from an empty stack")
+        return Stack._of(self._cell[1], self._len - 1)
+
+    def __len__(self) -> int:
+        return self._len
+
+    def __iter__(self) -> Iterator[_T]:
+        items = []
+        cell = self._cell
+        while cell is not None:
+            items.append(cell[0])
+            cell = cell[1]
+        return reversed(items)
+
+    def __getitem__(self, key: Any) -> Any:
+        if key == -1 and self._cell is not None:
+            return self._cell[0]
+        if isinstance(key, slice) and key.start in (None, 0) and key.step is None:
+            cell, n = self._cell, self._len
+            for _ in range(n - len(range(n)[key])):
+                cell, n = cell[1], n - 1  # type: ignore[index]
+            return Stack._of(cell, n)
+        return tuple(self)[key]
+
+    def __eq__(self, other: object) -> bool:
+        if not isinstance(other, Stack):
+            return NotImplemented
+        if self._len != other._len:
+            return False
+        # the cells nest as deep as the stack, so they are not compared
+        # as tuples
+        cell, other_cell = self._cell, other._cell
+        while cell is not other_cell:
+            if cell[0] != other_cell[0]:  # type: ignore[index]
+                return False
+            cell, other_cell = cell[1], other_cell[1]  # type: ignore[index]
+        return True
+
+    def __hash__(self) -> int:
+        return hash(tuple(self))
+
+    def __repr__(self) -> str:
+        return f"{type(self).__name__}({list(self)!r})"
+
 
 class State(NamedTuple):
-    entries: tuple[Entry, ...]
-    while_stack: tuple[tuple[WhileRule, int], ...]
+    entries: Stack[Entry]
+    while_stack: Stack[tuple[WhileRule, int]]
 
     @classmethod
     def root(cls, entry: Entry) -> State:
-        return cls((entry,), ())
+        return cls(Stack((entry,)), Stack())
 
     @property
     def cur(self) -> Entry:
         return self.entries[-1]
 
     def push(self, entry: Entry) -> State:
-        return self._replace(entries=(*self.entries, entry))
+        return self._replace(entries=self.entries.push(entry))
 
     def pop(self) -> State:
-        return self._replace(entries=self.entries[:-1])
+        return self._replace(entries=self.entries.pop())
 
     def push_while(self, rule: WhileRule, entry: Entry) -> State:
-        entries = (*self.entries, entry)
-        while_stack = (*self.while_stack, (rule, len(entries)))
+        entries = self.entries.push(entry)
+        while_stack = self.while_stack.push((rule, len(entries)))
         return self._replace(entries=entries, while_stack=while_stack)
 
     def pop_while(self) -> State:
-        entries, while_stack = self.entries[:-1], self.while_stack[:-1]
+        entries, while_stack = self.entries.pop(), self.while_stack.pop()
         return self._replace(entries=entries, while_stack=while_stack)
@@ -1,32 +1,42 @@
 from __future__ import annotations
 
 from typing import TYPE_CHECKING
+from typing import Iterator
 
+from .reg import LineBuffer
 from .region import Region
 from .region import Regions
+from .state import Stack
 from .state import State
 
 
 if TYPE_CHECKING:
     from .compiler import Compiler
+    from .rules import WhileRule
 
+# Lines at least this long, in characters or bytes, are tokenized as UTF-8
+# bytes in batches of regions
+LONG_LINE = 1024
+# Regions in each batch of a long line
+REGION_BATCH = 4096
 
-def tokenize(
+
+def _continue_while(
     compiler: Compiler,
     state: State,
     line: str,
     first_line: bool,
-) -> tuple[State, Regions]:
-    """Tokenize a string into it's parts."""
-    ret: list[Region] = []
+    ret: list[Region],
+) -> tuple[State, int, bool]:
+    """Match the while rules of the state at the start of a line."""
     pos = 0
     boundary = state.cur.boundary
 
     # this is still a little wasteful
-    while_stack = []
+    while_stack: Stack[tuple[WhileRule, int]] = Stack()
     for while_rule, idx in state.while_stack:
-        while_stack.append((while_rule, idx))
-        while_state = State(state.entries[:idx], tuple(while_stack))
+        while_stack = while_stack.push((while_rule, idx))
+        while_state = State(state.entries[:idx], while_stack)
 
         while_res = while_rule.continues(compiler, while_state, line, pos, first_line, boundary)
         if while_res is None:
@@ -35,6 +45,25 @@ def tokenize(
         pos, boundary, regions = while_res
         ret.extend(regions)
 
+    return state, pos, boundary
+
+
+def tokenize(
+    compiler: Compiler,
+    state: State,
+    line: str,
+    first_line: bool,
+) -> tuple[State, Regions]:
+    """Tokenize a string into it's parts."""
+    if len(line) >= LONG_LINE:
+        regions = []
+        for state, _, batch in iter_tokenize(compiler, state, line, first_line):
+            regions.extend(batch)
+        return state, tuple(regions)
+
+    ret: list[Region] = []
+    state, pos, boundary = _continue_while(compiler, state, line, first_line, ret)
+
     search_res = state.cur.rule.search(compiler, state, line, pos, first_line, boundary)
     while search_res is not None:
         state, pos, boundary, regions = search_res
@@ -46,3 +75,74 @@ def tokenize(
         ret.append(Region(pos, len(line), state.cur.scope))
 
     return state, tuple(ret)
+
+
+class _CharOffsets:
+    """Convert byte offsets into a UTF-8 line to character offsets.
+
+    Characters are counted from a cursor that follows the regions along the
+    line, so converting all of them is linear in the length of the line.
+    """
+
+    def __init__(self, data: bytes) -> None:
+        self._data = memoryview(data)
+        self._byte = 0
+        self._char = 0
+
+    def __call__(self, offset: int) -> int:
+        if offset > self._byte:
+            self._char += len(str(self._data[self._byte : offset], "UTF-8"))
+        elif offset < self._byte:
+            self._char -= len(str(self._data[offset : self._byte], "UTF-8"))
+        self._byte = offset
+        return self._char
+
+
+def iter_tokenize(
+    compiler: Compiler,
+    state: State,
+    line: str | bytes,
+    first_line: bool,
+    batch_size: int = REGION_BATCH,
+) -> Iterator[tuple[State, int, Regions]]:
+    """Tokenize a long line, producing its regions in batches as they are found.
+
+    The line is held as UTF-8 bytes in a LineBuffer for all of its searches,
+    which are made from a byte offset cursor.  The offsets of each batch of
+    a str line are converted back to characters.  Searching the str itself
+    converts the start offset and copies the line for every match, which is
+    quadratic in its length.
+
+    Yields the state and position after each batch, and its regions.
+    Regions later in the line never start before the position a batch ends
+    at, so a batch can be colored once the batches before it are.
+    """
+    data = LineBuffer(line.encode("UTF-8") if isinstance(line, str) else line)
+    to_char = None if isinstance(line, bytes) or line.isascii() else _CharOffsets(data)
+
+    def _batch(regions: list[Region]) -> Regions:
+        if to_char is None:
+            return tuple(regions)
+        return tuple(Region(to_char(r.start), to_char(r.end), r.scope) for r in regions)
+
+    ret: list[Region] = []
+    try:
+        state, pos, boundary = _continue_while(compiler, state, data, first_line, ret)
+
+        search_res = state.cur.rule.search(compiler, state, data, pos, first_line, boundary)
+        while search_res is not None:
+            state, pos, boundary, regions = search_res
+            ret.extend(regions)
+            if len(ret) >= batch_size:
+                regions = _batch(ret)
+                yield state, pos if to_char is None else to_char(pos), regions
+                ret = []
+
+            search_res = state.cur.rule.search(compiler, state, data, pos, first_line, boundary)
+    finally:
+        data.release()
+
+    if pos < len(data):
+        ret.append(Region(pos, len(data), state.cur.scope))
+
+    yield state, len(line), _batch(ret)
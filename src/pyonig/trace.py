@@ -0,0 +1,165 @@
+"""Chrome trace-event output for the highlight pipeline.
+
+While a trace is recording, the stages of highlighting add spans to it:
+``highlight``, ``detect``, ``theme``, ``grammar_load``, ``compile``,
+``tokenize`` for each line, ``colorize``, ``strip_markdown`` and ``render``.
+The trace is written as Chrome trace-event JSON, which chrome://tracing and
+https://ui.perfetto.dev open as a timeline with a track per thread.
+"""
+from __future__ import annotations
+
+import json
+import os
+import threading
+import time
+
+from collections.abc import Iterator
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Any
+from typing import Optional
+from typing import Union
+
+
+class Trace:
+    """The spans recorded while the trace is active, from any thread."""
+
+    def __init__(self) -> None:
+        """Initialize an empty trace, add it to TRACES to activate it."""
+        # name, start and end in perf_counter_ns(), thread ID, arguments
+        self.spans: list[tuple[str, int, int, int, dict[str, Any]]] = []
+        self.thread_names: dict[int, str] = {}
+        self._lock = threading.Lock()
+
+    def add(self, name: str, began: int, ended: int, args: dict[str, Any]) -> None:
+        """Add a span of the current thread.
+
+        Args:
+            name: The stage
+            began: The start, a perf_counter_ns() value
+            ended: The end, a perf_counter_ns() value
+            args: Details shown with the span
+        """
+        tid = threading.get_native_id()
+        with self._lock:
+            self.spans.append((name, began, ended, tid, args))
+            if tid not in self.thread_names:
+                self.thread_names[tid] = threading.current_thread().name
+
+    def events(self) -> list[dict[str, Any]]:
+        """Get the spans as trace events.
+
+        Returns:
+            A complete event per span, timed in microseconds, and a metadata
+            event naming each thread
+        """
+        pid = os.getpid()
+        with self._lock:
+            spans = list(self.spans)
+            thread_names = dict(self.thread_names)
+        events: list[dict[str, Any]] = [
+            {"name": "thread_name", "ph": "M", "pid": pid, "tid": tid, "args": {"name": name}}
+            for tid, name in thread_names.items()
+        ]
+        for name, began, ended, tid, args in spans:
+            event = {
+                "name": name,
+                "cat": "pyonig",
+                "ph": "X",
+                "ts": began / 1000,
+                "dur": (ended - began) / 1000,
+                "pid": pid,
+                "tid": tid,
+            }
+            if args:
+                event["args"] = args
+            events.append(event)
+        return events
+
+    def save(self, path: Union[str, Path]) -> None:
+        """Write the trace as Chrome trace-event JSON.
+
+        Args:
+            path: The trace file
+        """
+        data = {"traceEvents": self.events(), "displayTimeUnit": "ms"}
+        Path(path).write_text(json.dumps(data) + "\n", encoding="utf-8")
+
+
+#: Active traces, recording the spans of the highlight pipeline
+TRACES: list[Trace] = []
+
+
+def add_span(name: str, began: int, **args: Any) -> None:
+    """Add a span from began to now to the active traces.
+
+    Callers take ``began = time.perf_counter_ns() if TRACES else 0`` and
+    only add the span if began, so stages cost a list check when no trace
+    is recording.
+
+    Args:
+        name: The stage
+        began: The start, a perf_counter_ns() value
+        args: Details shown with the span
+    """
+    ended = time.perf_counter_ns()
+    for trace in TRACES:
+        trace.add(name, began, ended, args)
+
+
+class span:
+    """Add a span for the block to the active traces, if any.
+
+    Example:
+        >>> with span("detect"):
+        ...     scope = detect_scope(content)
+    """
+
+    __slots__ = ("_name", "_args", "_began")
+
+    def __init__(self, name: str, **args: Any) -> None:
+        """Initialize the span.
+
+        Args:
+            name: The stage
+            args: Details shown with the span
+        """
+        self._name = name
+        self._args = args
+        self._began = 0
+
+    def __enter__(self) -> None:
+        self._began = time.perf_counter_ns() if TRACES else 0
+
+    def __exit__(self, *exc_info: object) -> None:
+        if self._began:
+            add_span(self._name, self._began, **self._args)
+
+
+@contextmanager
+def record_trace(path: Optional[Union[str, Path]] = None) -> Iterator[Trace]:
+    """Record the highlight pipeline as a timeline.
+
+    Every stage run while the block runs, on any thread, is recorded with
+    the ID of its thread, so threaded and batch runs show when threads
+    wait on each other.
+
+    Args:
+        path: The Chrome trace-event JSON file written when the block
+            exits, None to only keep the spans in the trace
+
+    Yields:
+        The trace being recorded into
+
+    Example:
+        >>> with pyonig.record_trace('highlight.trace.json'):
+        ...     pyonig.highlight_many(snippets, language='json', max_workers=4)
+    """
+    trace = Trace()
+    TRACES.append(trace)
+    try:
+        yield trace
+    finally:
+        TRACES.remove(trace)
+    if path is not None:
+        trace.save(path)
@@ -0,0 +1,167 @@
+"""Profile guided warmup, precompiling only the regexes a workload uses."""
+from __future__ import annotations
+
+import hashlib
+import json
+
+from collections.abc import Iterator
+from concurrent.futures import Future
+from concurrent.futures import ThreadPoolExecutor
+from contextlib import contextmanager
+from pathlib import Path
+from typing import Iterable
+from typing import Optional
+from typing import Union
+
+from pyonig.api import _grammars
+from pyonig.tm_tokenize.compiler import COMPILE_LOGS
+from pyonig.tm_tokenize.compiler import CompileLog
+
+
+# Bumped when the digests or file layout change, older profiles are ignored
+PROFILE_VERSION = 1
+
+
+def regex_digest(key: Union[str, tuple[str, ...]]) -> str:
+    """Digest a regex cache key, a pattern or the patterns of a regset.
+
+    Args:
+        key: The key
+
+    Returns:
+        A 64 bit hex digest, distinct for a pattern and a regset of it
+    """
+    digest = hashlib.blake2b(digest_size=8)
+    digest.update(b"set" if isinstance(key, tuple) else b"reg")
+    for pattern in key if isinstance(key, tuple) else (key,):
+        digest.update(b"\0" + pattern.encode("utf-8", "surrogatepass"))
+    return digest.hexdigest()
+
+
+class WarmupProfile:
+    """The scopes and regexes a workload compiled, to precompile at startup.
+
+    Regexes are stored as digests rather than patterns, which keeps the
+    profile small. On replay the grammars are walked to find the patterns
+    again, so regexes the grammars no longer contain are skipped.
+    """
+
+    def __init__(self, scopes: Iterable[str] = (), regexes: Iterable[str] = ()) -> None:
+        """Initialize the profile.
+
+        Args:
+            scopes: The scopes highlighted
+            regexes: The digests of the regexes compiled
+        """
+        self.scopes = sorted(set(scopes))
+        self.regexes = frozenset(regexes)
+
+    @classmethod
+    def from_log(cls, log: CompileLog) -> WarmupProfile:
+        """Create a profile from what was compiled while a log was active.
+
+        Args:
+            log: The compile log
+
+        Returns:
+            The profile
+        """
+        return cls(log.scopes, (regex_digest(key) for key in log.regexes))
+
+    @classmethod
+    def load(cls, path: Union[str, Path]) -> WarmupProfile:
+        """Load a profile saved by save().
+
+        Args:
+            path: The profile file
+
+        Returns:
+            The profile, empty if it was saved by an incompatible version
+
+        Raises:
+            FileNotFoundError: If the file doesn't exist
+        """
+        data = json.loads(Path(path).read_text(encoding="utf-8"))
+        if data.get("version") != PROFILE_VERSION:
+            return cls()
+        return cls(data.get("scopes", ()), data.get("regexes", ()))
+
+    def save(self, path: Union[str, Path]) -> None:
+        """Save the profile as JSON.
+
+        Args:
+            path: The profile file
+        """
+        data = {"version": PROFILE_VERSION, "scopes": self.scopes, "regexes": sorted(self.regexes)}
+        Path(path).write_text(json.dumps(data, indent=1) + "\n", encoding="utf-8")
+
+    def replay(self, max_workers: Optional[int] = None) -> int:
+        """Compile the regexes of the profile into the shared regex cache.
+
+        Args:
+            max_workers: The number of threads, the executor default if None
+
+        Returns:
+            The number of regexes compiled
+        """
+        if not self.regexes:
+            return 0
+        return _grammars().warmup(
+            self.scopes,
+            max_workers,
+            keep=lambda key: regex_digest(key) in self.regexes,
+        )
+
+
+@contextmanager
+def record_warmup(path: Union[str, Path]) -> Iterator[CompileLog]:
+    """Record the regexes compiled by a workload into a warmup profile.
+
+    Regexes already compiled into a grammar compiler before recording
+    started are not seen again, so record from a fresh process, or through
+    the highlight functions, which compile for each call from the shared
+    regex cache.
+
+    Args:
+        path: The profile file written when the block exits
+
+    Yields:
+        The compile log being recorded into
+
+    Example:
+        >>> with pyonig.record_warmup('warmup.json'):
+        ...     run_representative_workload()
+    """
+    log = CompileLog()
+    COMPILE_LOGS.append(log)
+    try:
+        yield log
+    finally:
+        COMPILE_LOGS.remove(log)
+    WarmupProfile.from_log(log).save(path)
+
+
+def replay_warmup(path: Union[str, Path], max_workers: Optional[int] = None) -> Future[int]:
+    """Precompile the regexes of a warmup profile in the background.
+
+    A missing or unreadable profile is not an error, there is nothing to
+    precompile and the future's result is 0.
+
+    Args:
+        path: The profile file written by record_warmup()
+        max_workers: The number of compile threads, the executor default if None
+
+    Returns:
+        A future for the number of regexes compiled
+
+    Example:
+        >>> pyonig.replay_warmup('warmup.json')  # at startup, doesn't block
+    """
+    try:
+        profile = WarmupProfile.load(path)
+    except (OSError, ValueError):
+        profile = WarmupProfile()
+    executor = ThreadPoolExecutor(1, thread_name_prefix="pyonig-warmup")
+    future = executor.submit(profile.replay, max_workers)
+    executor.shutdown(wait=False)
+    return future
@@ -39,3 +39,13 @@ def enable_subprocess_coverage(tmp_path_factory):
     else:
         yield
 
+
+
+@pytest.fixture(autouse=True)
+def clear_render_cache():
+    """Isolate each test from renders cached by previous tests."""
+    from pyonig.cache import RENDER_CACHE
+
+    RENDER_CACHE.clear()
+    yield
+    RENDER_CACHE.clear()
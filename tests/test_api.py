@@ -1,4 +1,6 @@
 """Tests for the public pyonig API."""
+import asyncio
+
 import pytest
 from pathlib import Path
 import tempfile
@@ -113,6 +115,30 @@ class TestHighlight:
             pyonig.highlight(code, language='json', theme='nonexistent')
 
 
+class TestHighlightMany:
+    """Test highlighting batches of snippets with highlight_many()."""
+    
+    SNIPPETS = ['{"id": %d, "ok": true}' % n for n in range(40)] + ['[1, "two", null]', '']
+    
+    def test_matches_highlight(self):
+        """Test each result is what highlight() gives for the snippet."""
+        expected = [pyonig.highlight(s, language='json', theme='dark') for s in self.SNIPPETS]
+        assert pyonig.highlight_many(self.SNIPPETS, language='json', theme='dark') == expected
+    
+    def test_threads_keep_order(self):
+        """Test results come back in order when split across threads."""
+        expected = pyonig.highlight_many(self.SNIPPETS, language='json', cache=False)
+        result = pyonig.highlight_many(self.SNIPPETS, language='json', cache=False, max_workers=4)
+        assert result == expected
+    
+    def test_simple_bytes_and_detection(self):
+        """Test simple output, bytes snippets and per-snippet detection."""
+        result = pyonig.highlight_many([b'{"a": 1}', 'key: value\n'], output='simple')
+        assert result[0] == pyonig.highlight('{"a": 1}', language='json', output='simple')
+        assert result[1] == pyonig.highlight('key: value\n', language='yaml', output='simple')
+        assert pyonig.highlight_many([], language='json') == []
+
+
 class TestHighlightFile:
     """Test the highlight_file() function."""
     
@@ -178,6 +204,184 @@ class TestHighlightFile:
             Path(filepath).unlink()
 
 
+class TestHighlightFileLines:
+    """Test the memory-mapped highlight_file_lines() function."""
+    
+    def test_matches_highlight_file(self, tmp_path):
+        """Test streamed lines match highlight_file()."""
+        filepath = tmp_path / 'config.yaml'
+        filepath.write_text('key: value\nlist:\n  - 1\n  - "two"\n')
+        
+        lines = list(pyonig.highlight_file_lines(filepath, theme='dark'))
+        assert '\n'.join(lines) == pyonig.highlight_file(filepath, theme='dark', cache=False)
+    
+    def test_simple_output(self, tmp_path):
+        """Test simple output yields line parts."""
+        filepath = tmp_path / 'data.json'
+        filepath.write_bytes(b'{"key": "value"}\r\n[]\r\n')
+        
+        lines = list(pyonig.highlight_file_lines(filepath, output='simple', theme='dark'))
+        assert len(lines) == 2
+        assert ''.join(part.chars for part in lines[1]) == '[]\n'
+    
+    def test_empty_file(self, tmp_path):
+        """Test an empty file has no lines."""
+        filepath = tmp_path / 'empty.json'
+        filepath.write_bytes(b'')
+        assert list(pyonig.highlight_file_lines(filepath)) == []
+    
+    def test_not_found(self):
+        """Test error for non-existent file."""
+        with pytest.raises(FileNotFoundError):
+            list(pyonig.highlight_file_lines('/nonexistent/file.json'))
+
+
+class TestHighlightBytes:
+    """Test the bytes pipeline, highlight_bytes() and highlight_file_bytes()."""
+    
+    CONTENT = '{"名前": "値 ✓", "list": [1, "😀"]}\n# not json\n'.encode('utf-8')
+    
+    def test_matches_highlight(self):
+        """Test the output is highlight() encoded as UTF-8."""
+        expected = pyonig.highlight(self.CONTENT, language='json', theme='dark', cache=False)
+        assert pyonig.highlight_bytes(self.CONTENT, language='json', theme='dark') == expected.encode('utf-8')
+    
+    def test_python_multibyte(self):
+        """Test a grammar with begin/end rules over multibyte text."""
+        content = 'def f(ä="ü"):\n    return f"{ä}✓"  # ü\n'.encode('utf-8')
+        expected = pyonig.highlight(content, language='python', theme='dark', cache=False)
+        assert pyonig.highlight_bytes(content, language='python', theme='dark') == expected.encode('utf-8')
+    
+    def test_invalid_utf8_replaced(self):
+        """Test invalid UTF-8 is replaced rather than searched."""
+        result = pyonig.highlight_bytes(b'{"a": "\xff"}', language='json', theme='dark')
+        assert '\ufffd'.encode('utf-8') in result
+    
+    def test_file_bytes(self, tmp_path):
+        """Test a memory-mapped file gives the same bytes."""
+        filepath = tmp_path / 'data.json'
+        filepath.write_bytes(self.CONTENT)
+        lines = list(pyonig.highlight_file_bytes(filepath, theme='dark'))
+        assert b'\n'.join(lines) == pyonig.highlight_bytes(self.CONTENT, language='json', theme='dark')
+
+
+class TestWarmup:
+    """Test compiling grammars ahead of the first highlight with warmup()."""
+    
+    def test_compiles_reachable_regsets(self, monkeypatch):
+        """Test regsets are compiled once into the shared regex cache."""
+        from pyonig.tm_tokenize import reg
+        
+        reg.REGEX_CACHE.clear()
+        assert pyonig.warmup(['yaml', 'json'], max_workers=4) > 0
+        assert pyonig.warmup(['yaml', 'json']) == 0
+        
+        # Highlighting finds every regset it needs compiled
+        monkeypatch.setattr(reg, '_RegSet', None)
+        result = pyonig.highlight('a: [1, "two"]\nb: {"c": null}\n', language='yaml', cache=False)
+        assert '\033[' in result
+    
+    def test_output_unchanged(self):
+        """Test highlighting after warmup gives the same output."""
+        code = 'def f(x: int) -> str:\n    return f"{x}"  # done\n'
+        expected = pyonig.highlight(code, language='python', theme='dark', cache=False)
+        pyonig.warmup(['python'])
+        assert pyonig.highlight(code, language='python', theme='dark', cache=False) == expected
+    
+    def test_unknown_and_embedded_missing(self):
+        """Test unknown scopes and includes of missing grammars are skipped."""
+        assert pyonig.warmup(['source.nonexistent']) == 0
+        pyonig.warmup(['markdown'])
+
+
+class TestHighlightAsync:
+    """Test the asyncio highlight API."""
+    
+    CODE = '{\n  "key": "value",\n  "list": [1, 2, 3]\n}\n'
+    
+    def test_highlight_async_matches_sync(self):
+        """Test off-loop highlighting gives the same result as highlight()."""
+        expected = pyonig.highlight(self.CODE, language='json', theme='monokai')
+        result = asyncio.run(
+            pyonig.highlight_async(self.CODE, language='json', theme='monokai')
+        )
+        assert result == expected
+    
+    def test_highlight_async_inline_matches_sync(self):
+        """Test inline highlighting gives the same result as highlight()."""
+        expected = pyonig.highlight(self.CODE, language='json', theme='monokai')
+        result = asyncio.run(
+            pyonig.highlight_async(
+                self.CODE, language='json', theme='monokai', inline=True, yield_every=1
+            )
+        )
+        assert result == expected
+    
+    def test_highlight_async_simple_output(self):
+        """Test structured output from the async API."""
+        result = asyncio.run(
+            pyonig.highlight_async(self.CODE, language='json', output='simple', inline=True)
+        )
+        assert isinstance(result, list)
+        assert "".join(part.chars for line in result for part in line) == self.CODE
+    
+    def test_highlight_async_inline_yields_to_loop(self):
+        """Test inline highlighting lets other tasks run between batches."""
+        code = '{"key": "value"}\n' * 50
+        
+        async def main():
+            ticks = 0
+            done = False
+            
+            async def ticker():
+                nonlocal ticks
+                while not done:
+                    ticks += 1
+                    await asyncio.sleep(0)
+            
+            task = asyncio.create_task(ticker())
+            await pyonig.highlight_async(code, language='json', inline=True, yield_every=5)
+            done = True
+            await task
+            return ticks
+        
+        assert asyncio.run(main()) >= 10
+    
+    def test_highlight_lines_async(self):
+        """Test async iteration of rendered lines."""
+        expected = pyonig.highlight(self.CODE, language='json', theme='dark').split('\n')
+        
+        async def collect(inline):
+            return [
+                line
+                async for line in pyonig.highlight_lines_async(
+                    self.CODE, language='json', theme='dark', inline=inline, yield_every=2
+                )
+            ]
+        
+        assert asyncio.run(collect(False)) == expected
+        assert asyncio.run(collect(True)) == expected
+    
+    def test_highlight_async_invalid_theme(self):
+        """Test errors propagate from the async API."""
+        with pytest.raises(ValueError, match="Theme not found"):
+            asyncio.run(pyonig.highlight_async(self.CODE, language='json', theme='nonexistent'))
+    
+    def test_highlight_file_async(self, tmp_path):
+        """Test highlighting a file asynchronously."""
+        path = tmp_path / 'test.json'
+        path.write_text(self.CODE)
+        
+        expected = pyonig.highlight_file(path, theme='monokai')
+        result = asyncio.run(pyonig.highlight_file_async(path, theme='monokai'))
+        assert result == expected
+    
+    def test_highlight_file_async_not_found(self):
+        """Test error for nonexistent file."""
+        with pytest.raises(FileNotFoundError):
+            asyncio.run(pyonig.highlight_file_async('/nonexistent/file.json'))
+
+
 class TestDetectLanguage:
     """Test the detect_language() function."""
     
@@ -0,0 +1,248 @@
+"""Smoke tests for the benchmark harnesses in benchmarks/."""
+from __future__ import annotations
+
+import importlib.util
+import sys
+
+from pathlib import Path
+from types import ModuleType
+from types import SimpleNamespace
+
+import pytest
+
+import pyonig
+
+
+BENCHMARKS = Path(__file__).resolve().parent.parent / "benchmarks"
+
+
+def _load(name: str) -> ModuleType:
+    spec = importlib.util.spec_from_file_location(f"benchmarks_{name}", BENCHMARKS / f"{name}.py")
+    module = importlib.util.module_from_spec(spec)
+    sys.modules[spec.name] = module
+    spec.loader.exec_module(module)
+    return module
+
+
+memory = _load("memory")
+parity = _load("parity")
+fuzz = _load("fuzz")
+native = _load("native")
+import_time = _load("import_time")
+
+
+class TestMemory:
+    """Test the memory footprint benchmark."""
+
+    def test_make_input(self):
+        """Test inputs are repeated samples cut at a line end within the size."""
+        text = memory.make_input("json", 10_000)
+        assert 9_000 < len(text.encode()) <= 10_000
+        assert text.endswith("\n")
+
+    def test_cases(self):
+        """Test every grammar, theme and sample language gets a case."""
+        found = memory.cases((1, 10))
+        assert found[0] == "import"
+        assert "compile:source.python" in found
+        assert "highlight:py:10" in found
+        assert memory.cases((1,), only=["grammar"]) == [f"grammar:{s}" for s in memory.scopes()]
+
+    def test_run_case(self):
+        """Test a case is measured for both the resident set and the heap."""
+        result = memory.run_case("grammar:source.json")
+        assert "error" not in result
+        assert result["heap_bytes"] > 0
+        assert result["heap_peak_bytes"] >= result["heap_bytes"]
+        assert result["rss_bytes"] >= 0
+
+    def test_budgets(self):
+        """Test budgets made from results pass them, and catch growth."""
+        results = [
+            {"case": "import", "rss_bytes": 10_000_000, "heap_bytes": 5_000_000},
+            {"case": "highlight:py:1", "bytes_per_token": 500.0, "bytes_per_line": 1500.0},
+            {"case": "highlight:py:10", "bytes_per_token": 520.0, "bytes_per_line": 1400.0},
+        ]
+        budgets = memory.make_budgets(results)
+        assert set(budgets) == {"import", "highlight:py"}
+        assert memory.check_budgets(results, budgets) == []
+        results[0]["heap_bytes"] *= 2
+        over = memory.check_budgets(results, budgets)
+        assert len(over) == 1 and over[0].startswith("import: heap_bytes")
+
+
+class TestParity:
+    """Test the parity harness against onigurumacffi."""
+
+    def test_workloads(self):
+        """Test a grammar's patterns, regsets and sample lines are collected."""
+        (work,) = parity.workloads(limit=5, languages=["json"])
+        assert work.scope == "source.json"
+        assert len(work.lines) == 5 and all(line.endswith("\n") for line in work.lines)
+        assert work.patterns and work.regsets
+        assert all(pattern in work.patterns for regset in work.regsets for pattern in regset)
+
+    def test_same_backend(self):
+        """Test every operation matches when compared with pyonig itself."""
+        work = parity.workloads(limit=5, languages=["json", "py"])
+        for op in parity.OPERATIONS:
+            result = parity.compare(op, pyonig, work, repeat=1)
+            assert result.cases > 0, op
+            assert result.mismatches == 0, (op, result.diffs)
+            assert result.seconds > 0 and result.other_seconds > 0
+
+    def test_mismatch(self):
+        """Test results that differ are counted and kept for the report."""
+        wrapped = SimpleNamespace(
+            OnigError=pyonig.OnigError,
+            compile=lambda pattern: pyonig.compile(f"({pattern})"),
+        )
+        work = parity.workloads(limit=5, languages=["json"])
+        result = parity.compare("compile", wrapped, work, repeat=1)
+        assert result.mismatches > 0
+        assert len(result.diffs) == min(result.mismatches, parity.MAX_DIFFS)
+
+    def test_not_installed(self, capsys):
+        """Test a missing backend is reported without failing the run."""
+        assert parity.main(["--other", "no_such_onig_backend"]) == 0
+        assert "not installed" in capsys.readouterr().err
+
+
+class _CostTokenizer:
+    """A tokenizer taking a synthetic time, growing with the text as given."""
+
+    def __init__(self, cost):
+        self.cost = cost
+
+    def seconds(self, language, text):
+        return self.cost(text)
+
+
+class TestFuzz:
+    """Test the superlinear input fuzzer."""
+
+    def test_mutation(self):
+        """Test a mutation repeats its unit between the prefix and suffix."""
+        mutation = fuzz.Mutation("json", "{", '"', "}\n")
+        assert mutation.text(0) == "{}\n"
+        assert mutation.text(3) == '{"""}\n'
+        assert mutation.name == fuzz.Mutation("json", "{", '"', "}\n").name
+        assert mutation.name != mutation._replace(unit="'").name
+
+    def test_measure(self):
+        """Test linear and quadratic costs are told apart."""
+        mutation = fuzz.Mutation("json", "{", "(", "}\n")
+        linear = fuzz.measure(_CostTokenizer(lambda text: 1e-6 * len(text)), mutation)
+        quadratic = fuzz.measure(_CostTokenizer(lambda text: 1e-8 * len(text) ** 2), mutation)
+        assert abs(linear.exponent - 1) < 0.1 and not linear.superlinear()
+        assert abs(quadratic.exponent - 2) < 0.1 and quadratic.superlinear()
+
+    def test_minimize(self):
+        """Test the unit, prefix and suffix shrink to what is superlinear."""
+        tokenizer = _CostTokenizer(lambda text: 1e-8 * text.count("(") ** 2 + 1e-6 * len(text))
+        mutation = fuzz.Mutation("json", "a\nb\nc\n", "x(y", "d\ne\n")
+        assert fuzz.minimize(tokenizer, mutation) == fuzz.Mutation("json", "", "(", "")
+
+    def test_usable_seed(self):
+        """Test a seed the tokenizer fails on is cut before the failing line."""
+        tokenizer = fuzz.Tokenizer()
+        seed = fuzz.usable_seed(tokenizer, "json")
+        assert seed == (fuzz.DEMO_DIR / "sample.json").read_text()
+        tokenizer.seconds("md", fuzz.usable_seed(tokenizer, "md"))
+
+    def test_corpus(self, tmp_path):
+        """Test saved mutations load back and are checked again."""
+        quadratic = fuzz.Mutation("json", "", "(", "")
+        linear = fuzz.Mutation("json", "", "a", "")
+        growth = fuzz.Growth(1, 0.1, 1.6, 2.0)
+        paths = [fuzz.save(quadratic, growth, tmp_path), fuzz.save(linear, growth, tmp_path)]
+        assert fuzz.load(paths[0]) == quadratic
+        assert fuzz.load_growths(paths[0]) == (growth, None)
+        tokenizer = _CostTokenizer(lambda text: 1e-8 * text.count("(") ** 2 + 1e-6 * len(text))
+        assert fuzz.check(paths, tokenizer=tokenizer) == []
+
+        fuzz.check(paths, tokenizer=tokenizer, record_fixed=True)
+        assert fuzz.load_growths(paths[0])[1] is None
+        assert not fuzz.load_growths(paths[1])[1].superlinear()
+
+    def test_verdict(self):
+        """Test only fixed entries regressing and open ones growing fail."""
+        found = fuzz.Growth(1, 0.1, 1.6, 2.0)
+        linear = fuzz.Growth(1, 0.1, 0.4, 1.0)
+        assert fuzz.verdict(linear, found, linear) == "ok"
+        assert fuzz.verdict(found, found, linear) == "regressed"
+        assert fuzz.verdict(linear, found, None) == "linear"
+        assert fuzz.verdict(found._replace(exponent=2.1), found, None) == "open"
+        assert fuzz.verdict(found._replace(exponent=2.5), found, None) == "grew"
+        assert fuzz.verdict(found._replace(error="retry-limit-in-match over"), found, None) == "grew"
+
+    def test_check_fails_on_regressed_entry(self, tmp_path):
+        """Test a fixed entry superlinear again fails the check."""
+        path = fuzz.save(fuzz.Mutation("json", "", "(", ""), fuzz.Growth(1, 0.1, 1.6, 2.0), tmp_path)
+        fuzz.mark_fixed(path, fuzz.Growth(1, 0.1, 0.4, 1.0))
+        tokenizer = _CostTokenizer(lambda text: 1e-8 * text.count("(") ** 2 + 1e-6 * len(text))
+        assert [failed for failed, _ in fuzz.check([path], tokenizer=tokenizer)] == [path]
+
+
+class TestNative:
+    """Test the native benchmark of the regex core."""
+
+    def test_onig_sources(self):
+        """Test the Oniguruma sources are read from setup.py."""
+        src_dir, sources = native.onig_sources()
+        assert src_dir == "deps/oniguruma/src"
+        assert "deps/oniguruma/src/regexec.c" in sources
+        assert all(source.endswith(".c") for source in sources)
+
+    def test_workload(self, tmp_path):
+        """Test the workload holds each grammar's patterns, regsets and lines."""
+        work = parity.workloads(limit=3, languages=["json"])
+        path = tmp_path / "workload"
+        native.write_workload(work, path)
+        data = path.read_bytes()
+        assert data.startswith(b"grammar source.json\n")
+        assert data.count(b"\nline ") == 3
+        assert data.count(b"pattern ") == len(native._compiled_patterns(work[0]))
+        assert b"\nregset " in data
+
+    def test_python_runs(self):
+        """Test the searches from Python are those of the native benchmark."""
+        work = parity.workloads(limit=3, languages=["json"])
+        runs = native._python_runs(work, as_bytes=True)
+        calls, matches = runs["search"]()
+        assert calls == 3 * len(native._compiled_patterns(work[0]))
+        assert 0 < matches <= calls
+        assert native._python_runs(work, as_bytes=False)["search"]() == (calls, matches)
+
+    def test_compare(self):
+        """Test native and Python searches agree, when Oniguruma is configured."""
+        src_dir, _ = native.onig_sources()
+        if not (native.ROOT / src_dir / "config.h").exists():
+            pytest.skip("Oniguruma sources not configured")
+        binary = native.build()
+        timings = native.compare(binary, parity.workloads(limit=3, languages=["json"]), repeat=1)
+        assert [t.op for t in timings] == ["search", "regset"]
+        assert all(t.calls > 0 and t.native_ns > 0 for t in timings)
+
+
+class TestImportTime:
+    """Test the import and startup time benchmark."""
+
+    def test_import_times(self):
+        """Test the modules of a run are read from -X importtime."""
+        modules = import_time.import_times(("-c", "import json"))
+        assert "json" in modules
+        assert all(us >= 0 for us in modules.values())
+
+    def test_regex_api_startup(self):
+        """Test importing pyonig loads none of the forbidden modules."""
+        startup = import_time.measure(import_time.CASES["import"], repeat=1)
+        assert startup.forbidden == []
+        assert startup.seconds >= 0
+        assert any(module == "pyonig" for module, _ in startup.top)
+
+    def test_cli_startup(self):
+        """Test the CLI highlights without curses or asyncio."""
+        startup = import_time.measure(import_time.CASES["cli-highlight"], repeat=1)
+        assert startup.forbidden == []
+        assert any(module == "pyonig.api" for module, _ in startup.top)
@@ -0,0 +1,235 @@
+"""Tests for the byte-bounded caches and the memory budget."""
+from __future__ import annotations
+
+import gc
+import shutil
+from pathlib import Path
+
+import pyonig
+from pyonig.cache import MEMORY_BUDGET, RENDER_CACHE, ByteBoundedCache, MemoryBudget, content_digest
+from pyonig.colorize import STYLE_CACHE, Colorize
+from pyonig.tm_tokenize.reg import REGEX_CACHE, make_reg
+
+
+GRAMMAR_DIR = Path(__file__).parent.parent / "src" / "pyonig" / "grammars"
+THEME_DIR = Path(__file__).parent.parent / "src" / "pyonig" / "themes"
+
+
+class TestByteBoundedCache:
+    """Test the cache container itself."""
+
+    def test_hit_and_miss_metrics(self):
+        """Test hits and misses are counted."""
+        cache = ByteBoundedCache(max_bytes=100)
+        assert cache.get("a") is None
+        cache.put("a", [1], 10)
+        assert cache.get("a") == [1]
+
+        stats = cache.stats()
+        assert stats["hits"] == 1
+        assert stats["misses"] == 1
+        assert stats["entries"] == 1
+        assert stats["bytes"] == 10
+
+    def test_evicts_least_recently_used(self):
+        """Test the byte cap evicts the least recently used values."""
+        cache = ByteBoundedCache(max_bytes=100)
+        cache.put("a", "a", 40)
+        cache.put("b", "b", 40)
+        cache.get("a")
+        cache.put("c", "c", 40)
+
+        assert cache.get("b") is None
+        assert cache.get("a") == "a"
+        assert cache.get("c") == "c"
+        assert cache.stats()["evictions"] == 1
+        assert cache.stats()["bytes"] == 80
+
+    def test_oversized_value_not_stored(self):
+        """Test a value larger than the cache is not stored."""
+        cache = ByteBoundedCache(max_bytes=100)
+        cache.put("a", "a", 101)
+        assert cache.get("a") is None
+        assert cache.stats()["bytes"] == 0
+
+    def test_replace_and_shrink(self):
+        """Test replacing a key and lowering the capacity."""
+        cache = ByteBoundedCache(max_bytes=100)
+        cache.put("a", "a", 30)
+        cache.put("a", "A", 50)
+        cache.put("b", "b", 40)
+        assert cache.stats()["bytes"] == 90
+
+        cache.max_bytes = 45
+        assert cache.get("a") is None
+        assert cache.get("b") == "b"
+
+    def test_content_digest(self):
+        """Test digests are fixed size and content sensitive."""
+        assert len(content_digest("x" * 1_000_000)) == 16
+        assert content_digest("a") != content_digest("b")
+        assert content_digest("\udcff") == content_digest("\udcff")
+
+
+class TestMemoryBudget:
+    """Test eviction across the caches sharing a budget."""
+
+    def test_evicts_across_caches(self):
+        """Test the budget evicts from whichever cache holds the oldest entry."""
+        budget = MemoryBudget(max_bytes=100)
+        first = ByteBoundedCache(None, budget=budget, name="first")
+        second = ByteBoundedCache(None, budget=budget, name="second")
+        first.put("a", "a", 40)
+        second.put("b", "b", 40)
+        second.put("c", "c", 40)
+
+        assert first.get("a") is None
+        assert second.get("b") == "b"
+        assert budget.stats()["bytes"] == 80
+        assert budget.stats()["evictions"] == 1
+
+    def test_equal_priority_evicted_least_recent_first(self):
+        """Test entries of equal priority are evicted by use across caches."""
+        budget = MemoryBudget(max_bytes=100)
+        first = ByteBoundedCache(None, budget=budget, name="first")
+        second = ByteBoundedCache(None, budget=budget, name="second")
+        first.put("a1", "a1", 30)
+        second.put("b1", "b1", 30)
+        first.put("a2", "a2", 30)
+        assert first.get("a1") == "a1"
+
+        # b1 is now the least recently used and a2 the next, whatever the
+        # order the caches are compared in
+        second.put("b2", "b2", 30)
+        first.put("a3", "a3", 30)
+
+        assert budget.stats()["evictions"] == 2
+        assert second.get("b1") is None
+        assert first.get("a2") is None
+        assert [first.get("a1"), first.get("a3"), second.get("b2")] == ["a1", "a3", "b2"]
+
+    def test_costly_entries_survive(self):
+        """Test cheap bytes are evicted before expensive ones."""
+        budget = MemoryBudget(max_bytes=100)
+        compiled = ByteBoundedCache(None, budget=budget, name="compiled")
+        rendered = ByteBoundedCache(None, budget=budget, name="rendered")
+        compiled.put("grammar", "grammar", 20, cost=1.0)
+        for key in "abcde":
+            rendered.put(key, key, 30, cost=0.001)
+
+        assert compiled.get("grammar") == "grammar"
+        assert rendered.stats()["entries"] == 2
+
+    def test_grow_and_discard(self):
+        """Test growing a stored value and discarding it update the budget."""
+        budget = MemoryBudget(max_bytes=100)
+        cache = ByteBoundedCache(None, budget=budget)
+        value = ["compiler"]
+        cache.put("k", value, 10)
+        cache.grow("k", value, 30)
+        cache.grow("k", ["other"], 30)
+        assert budget.stats()["bytes"] == 40
+
+        cache.discard("k")
+        assert budget.stats()["bytes"] == 0
+        assert cache.stats()["evictions"] == 0
+
+    def test_on_evict_and_shrink(self):
+        """Test lowering the budget evicts and notifies the owner."""
+        budget = MemoryBudget(max_bytes=100)
+        evicted = []
+        cache = ByteBoundedCache(None, budget=budget, on_evict=lambda k, v: evicted.append(k))
+        cache.put("a", "a", 40)
+        cache.put("b", "b", 40)
+
+        budget.max_bytes = 50
+        assert evicted == ["a"]
+        assert cache.stats()["max_bytes"] == 50
+
+    def test_collected_cache_releases_bytes(self):
+        """Test a garbage collected cache no longer counts against the budget."""
+        budget = MemoryBudget(max_bytes=100)
+        cache = ByteBoundedCache(None, budget=budget)
+        cache.put("a", "a", 40)
+        del cache
+        gc.collect()
+        assert budget.stats()["bytes"] == 0
+
+    def test_tokenizer_caches_attached(self):
+        """Test regexes, grammars, compilers and styles are held in the budget."""
+        colorizer = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=THEME_DIR / "dark_vs.json")
+        colorizer.render('{"a": 1}', "source.json", cache=False)
+        caches = MEMORY_BUDGET.stats()["caches"]
+        for name in ("regex", "grammar", "compiler", "style", "render"):
+            assert name in caches
+        assert caches["compiler"]["bytes"] > 0
+        assert STYLE_CACHE.stats()["bytes"] > 0
+
+    def test_render_correct_under_tight_budget(self):
+        """Test rendering rebuilds transparently when nothing can be cached."""
+        colorizer = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=THEME_DIR / "dark_vs.json")
+        doc = 'a: "b"\nlist:\n  - 1\n  - "two"\n'
+        expected = colorizer.render(doc, "source.yaml", cache=False)
+        reg = make_reg("evicted[0-9]+")
+
+        max_bytes = MEMORY_BUDGET.max_bytes
+        MEMORY_BUDGET.max_bytes = 0
+        try:
+            assert REGEX_CACHE.get("evicted[0-9]+") is None
+            assert MEMORY_BUDGET.stats()["bytes"] == 0
+            fresh = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=THEME_DIR / "dark_vs.json")
+            assert fresh.render(doc, "source.yaml", cache=False) == expected
+            assert colorizer.render(doc, "source.yaml", cache=False) == expected
+        finally:
+            MEMORY_BUDGET.max_bytes = max_bytes
+        assert make_reg("evicted[0-9]+") is not reg
+
+
+class TestRenderCache:
+    """Test Colorize renders go through the shared cache."""
+
+    def test_render_hits_across_instances(self):
+        """Test a second colorizer with the same theme reuses the render."""
+        theme = THEME_DIR / "dark_vs.json"
+        first = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=theme).render('{"a": 1}', "source.json")
+        second = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=theme).render('{"a": 1}', "source.json")
+
+        assert second is first
+        assert RENDER_CACHE.stats()["hits"] == 1
+
+    def test_render_keyed_by_theme_content(self, tmp_path):
+        """Test editing the theme file changes the cache key."""
+        theme = tmp_path / "theme.json"
+        shutil.copy(THEME_DIR / "dark_vs.json", theme)
+        first = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=theme).render('{"a": 1}', "source.json")
+
+        shutil.copy(THEME_DIR / "monokai-color-theme.json", theme)
+        second = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=theme).render('{"a": 1}', "source.json")
+
+        assert second is not first
+        assert RENDER_CACHE.stats()["entries"] == 2
+
+    def test_render_bypass(self):
+        """Test one-shot renders leave the cache untouched."""
+        colorizer = Colorize(grammar_dir=GRAMMAR_DIR, theme_path=THEME_DIR / "dark_vs.json")
+        colorizer.render('{"a": 1}', "source.json", cache=False)
+        pyonig.highlight('{"a": 1}', language="json", theme="dark", cache=False)
+        Colorize.render_ansi("\x1b[31mred\x1b[0m", cache=False)
+
+        stats = RENDER_CACHE.stats()
+        assert stats["entries"] == 0
+        assert stats["hits"] == stats["misses"] == 0
+
+    def test_render_ansi_cached(self):
+        """Test ANSI conversion results are cached."""
+        first = Colorize.render_ansi("\x1b[31mred\x1b[0m\nplain")
+        second = Colorize.render_ansi("\x1b[31mred\x1b[0m\nplain")
+        assert second is first
+        assert RENDER_CACHE.stats()["hits"] == 1
+
+    def test_highlight_uses_cache(self):
+        """Test repeated highlight() calls hit the cache."""
+        first = pyonig.highlight('{"a": 1}', language="json", theme="dark")
+        second = pyonig.highlight('{"a": 1}', language="json", theme="dark")
+        assert first == second
+        assert RENDER_CACHE.stats()["hits"] == 1
@@ -1,6 +1,7 @@
 """Tests for pyonig CLI utility."""
 from __future__ import annotations
 
+import os
 import subprocess
 import sys
 
@@ -95,6 +96,46 @@ class TestCLIFileInput:
         assert result.returncode != 0
         assert "error" in result.stderr.lower() or "not found" in result.stderr.lower()
 
+    def test_mmap_is_opt_in(self, tmp_path):
+        """Test a markdown file renders the same whatever its size, unless --mmap is given."""
+        md_file = tmp_path / "test.md"
+        md_file.write_text("# Title\n\nSome `code` here\n" * 2000)
+        small = tmp_path / "small.md"
+        small.write_text("# Title\n\nSome `code` here\n")
+
+        default = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, str(md_file)],
+            capture_output=True,
+            text=True,
+        )
+        single = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, str(small)],
+            capture_output=True,
+            text=True,
+        )
+        mapped = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, "--mmap", str(md_file)],
+            capture_output=True,
+            text=True,
+        )
+
+        assert default.returncode == 0 and mapped.returncode == 0
+        assert default.stdout.startswith(single.stdout.rstrip("\n"))
+        # markdown is only cleaned up on the default path
+        assert "`" not in default.stdout
+        assert "`" in mapped.stdout
+
+    def test_mmap_needs_file(self):
+        """Test --mmap is refused for stdin."""
+        result = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, "--mmap", "-l", "json"],
+            input="{}",
+            capture_output=True,
+            text=True,
+        )
+        assert result.returncode == 2
+        assert "--mmap" in result.stderr
+
 
 class TestCLIStdin:
     """Test CLI with stdin input."""
@@ -312,3 +353,111 @@ class TestCLIIntegration:
         assert "value1" in result.stdout
         assert "value2" in result.stdout
 
+
+
+class TestCLIFollow:
+    """Test following live input with --follow."""
+
+    def test_follow_pipe_flushes_each_line(self):
+        """Test each line is printed before the pipe is closed."""
+        proc = subprocess.Popen(
+            [sys.executable, "-m", CLI_MODULE, "--follow", "--language", "log"],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+        )
+        try:
+            for n in range(3):
+                proc.stdin.write(b"2024-01-01 12:00:0%d ERROR failed\n" % n)
+                proc.stdin.flush()
+                assert b"ERROR failed" in proc.stdout.readline()
+        finally:
+            proc.stdin.close()
+            proc.wait(timeout=30)
+        assert proc.returncode == 0
+
+    def test_follow_file(self, tmp_path):
+        """Test a followed file is printed from the start."""
+        log_file = tmp_path / "app.log"
+        log_file.write_text("2024-01-01 12:00:00 INFO started\n")
+        proc = subprocess.Popen(
+            [sys.executable, "-m", CLI_MODULE, "--follow", str(log_file)],
+            stdout=subprocess.PIPE,
+        )
+        try:
+            assert b"started" in proc.stdout.readline()
+            with log_file.open("a") as file:
+                file.write("2024-01-01 12:00:01 INFO ready\n")
+            assert b"ready" in proc.stdout.readline()
+        finally:
+            proc.terminate()
+            proc.wait(timeout=30)
+
+
+class TestCLIProfile:
+    """Test the --profile-rules mode."""
+
+    def test_profile_file(self, tmp_path):
+        """Test the slowest rules are listed instead of the highlighted file."""
+        test_file = tmp_path / "test.json"
+        test_file.write_text('{"key": [1, 2, "three"]}\n')
+        result = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, "--profile-rules", "--top", "3", str(test_file)],
+            capture_output=True,
+            text=True,
+        )
+        assert result.returncode == 0
+        lines = result.stdout.splitlines()
+        assert lines[0].split()[:2] == ["ms", "calls"]
+        assert "source.json.json" in lines[1]
+        assert len(lines) == 5
+        assert "three" not in result.stdout
+
+    def test_profile_retries(self, tmp_path):
+        """Test --retries lists the patterns backtracking the most."""
+        test_file = tmp_path / "test.json"
+        test_file.write_text('{"key": [1, 2, "three"]}\n')
+        result = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, "--profile-rules", "--retries", "--threshold", "0", str(test_file)],
+            capture_output=True,
+            text=True,
+        )
+        assert result.returncode == 0
+        lines = result.stdout.splitlines()
+        assert lines[0].split()[:3] == ["per", "char", "retries"]
+        assert "source.json.json" in lines[1]
+        assert "retries per character" in lines[-1]
+
+    def test_profile_missing_file(self):
+        """Test profiling a missing file fails."""
+        result = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, "--profile-rules", "/nonexistent/file.json"],
+            capture_output=True,
+            text=True,
+        )
+        assert result.returncode == 1
+        assert "Error" in result.stderr
+
+    def test_file_named_profile(self, tmp_path):
+        """Test a file named profile is highlighted, not profiled."""
+        (tmp_path / "profile").write_text('{"key": "three"}\n')
+        result = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, "-l", "json", "profile"],
+            capture_output=True,
+            text=True,
+            cwd=tmp_path,
+            env={**os.environ, "PYTHONPATH": os.pathsep.join(sys.path)},
+        )
+        assert result.returncode == 0
+        assert "three" in result.stdout
+
+    def test_profile_options_need_profile_rules(self, tmp_path):
+        """Test the profiler options are refused without --profile-rules."""
+        test_file = tmp_path / "test.json"
+        test_file.write_text("{}\n")
+        result = subprocess.run(
+            [sys.executable, "-m", CLI_MODULE, "--retries", str(test_file)],
+            capture_output=True,
+            text=True,
+        )
+        assert result.returncode == 2
+        assert "--profile-rules" in result.stderr
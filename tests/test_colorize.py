@@ -4,11 +4,30 @@ Adapted from ansible-navigator's test_colorize.py
 """
 from __future__ import annotations
 
+import gc
+import sys
+import threading
+import time
+import tracemalloc
+
+from concurrent.futures import ThreadPoolExecutor
 from pathlib import Path
 
 import pytest
 
-from pyonig.colorize import Colorize
+import pyonig.colorize as colorize_module
+import pyonig.tm_tokenize.tokenize as tokenize_module
+
+from pyonig.colorize import (
+    DEFAULT_STYLE,
+    ColorSchema,
+    Colorize,
+    batched_style_runs,
+    strip_markdown,
+    style_runs,
+)
+from pyonig.curses_defs import SimpleLinePart
+from pyonig.tm_tokenize.tokenize import iter_tokenize, tokenize
 
 
 # Get paths to grammars and themes
@@ -184,6 +203,263 @@ class TestThemeLoading:
             assert theme_data is not None
 
 
+class TestStyleTable:
+    """Test theme resolution compiled to style IDs and a palette."""
+
+    SCHEMA = {
+        "tokenColors": [
+            {"scope": "string", "settings": {"foreground": "#ff0000"}},
+            {"scope": ["string.quoted", "keyword"], "settings": {"foreground": "#00ff00", "fontStyle": "bold italic"}},
+            {"scope": "keyword", "settings": {"foreground": "#0000ff"}},
+            {"scope": "markup.underline", "settings": {"fontStyle": "underline", "background": "#112233"}},
+        ],
+    }
+
+    def test_unstyled_scope_is_default(self):
+        """Test scopes without a rule map to style ID 0."""
+        schema = ColorSchema(self.SCHEMA)
+        assert schema.style_id(("source.json",)) == 0
+        assert schema.palette[0] == DEFAULT_STYLE
+
+    def test_style_ids_are_stable_and_shared(self):
+        """Test scope stacks resolving to the same style share one ID."""
+        schema = ColorSchema(self.SCHEMA)
+        quoted = schema.style_id(("source.json", "string.quoted.double"))
+        assert quoted != 0
+        assert schema.style_id(("source.json", "string.quoted.double")) == quoted
+        # The shortest matching prefix of a scope name wins
+        assert schema.style_id(("source.yaml", "string.unquoted")) == quoted
+        assert schema.palette[quoted].color == (255, 0, 0)
+        assert len(schema.palette) == 2
+
+    def test_first_rule_for_a_selector_wins(self):
+        """Test the first tokenColors entry naming a selector is used."""
+        schema = ColorSchema(self.SCHEMA)
+        style = schema.palette[schema.style_id(("keyword",))]
+        assert style.color == (0, 255, 0)
+        assert style.bold and style.italic and not style.underline
+
+    def test_background_and_font_style(self):
+        """Test palette entries carry background and decoration flags."""
+        schema = ColorSchema(self.SCHEMA)
+        style = schema.palette[schema.style_id(("text", "markup.underline.link"))]
+        assert style.color is None
+        assert style.background == (0x11, 0x22, 0x33)
+        assert style.underline
+        assert style.font_style == "underline"
+
+    def test_get_color_and_style(self):
+        """Test the color and fontStyle lookup is backed by the table."""
+        schema = ColorSchema(self.SCHEMA)
+        assert schema.get_color_and_style(("string.unquoted",)) == ((255, 0, 0), None)
+        assert schema.get_color_and_style(("keyword",)) == ((0, 255, 0), "bold italic")
+        assert schema.get_color_and_style(("comment",)) == (None, None)
+
+    def test_concurrent_style_ids(self):
+        """Test threads sharing a schema get one ID per style, matching the palette."""
+        colors = [f"#{n:06x}" for n in range(1, 201)]
+        schema = ColorSchema(
+            {"tokenColors": [{"scope": f"s{n}", "settings": {"foreground": color}} for n, color in enumerate(colors)]},
+        )
+
+        class YieldingList(list):
+            """A palette that lets other threads run between reading and growing it."""
+
+            def __len__(self) -> int:
+                time.sleep(0)
+                return super().__len__()
+
+        schema.palette = YieldingList(schema.palette)
+        # Switch threads as often as possible to interleave the allocations
+        interval = sys.getswitchinterval()
+        sys.setswitchinterval(1e-6)
+        barrier = threading.Barrier(8)
+
+        def resolve(worker: int) -> dict[int, int]:
+            barrier.wait()
+            # Each worker starts at a different scope so they race on all of them
+            order = [(n + worker * 25) % len(colors) for n in range(len(colors))]
+            return {n: schema.style_id((f"s{n}",)) for n in order}
+
+        try:
+            with ThreadPoolExecutor(max_workers=8) as pool:
+                results = list(pool.map(resolve, range(8)))
+        finally:
+            sys.setswitchinterval(interval)
+        assert len(schema.palette) == len(colors) + 1
+        for ids in results:
+            for n, style_id in ids.items():
+                assert schema.palette[style_id] == schema._resolve((f"s{n}",))
+
+    def test_render_uses_palette(self):
+        """Test rendered parts take their color and style from the palette."""
+        colorizer = Colorize(grammar_dir=str(GRAMMAR_DIR), theme_path=str(THEME_PATH))
+        colorized = colorizer.render('{"key": "value", "n": 1}\n', "source.json")
+        palette = colorizer._schema.palette
+        styles = {(style.color, style.font_style) for style in palette}
+        for part in colorized[0]:
+            assert (part.color, part.style) in styles
+        # Adjacent parts always differ in style
+        for left, right in zip(colorized[0], colorized[0][1:]):
+            assert (left.color, left.style) != (right.color, right.style)
+            assert right.column == left.column + len(left.chars)
+
+
+class TestLongLines:
+    """Test long lines are tokenized in batches from a UTF-8 buffer."""
+
+    LINE = '{"a": ["café", {"b": null, "ü": [1, 2.5e3]}, true], "c": "x\\"y"}' * 40 + "\n"
+
+    @pytest.fixture
+    def colorizer(self):
+        return Colorize(grammar_dir=str(GRAMMAR_DIR), theme_path=str(THEME_PATH))
+
+    def test_regions_match_short_line_path(self, colorizer, monkeypatch):
+        """Test the character offsets of a long str line are unchanged."""
+        compiler = colorizer.compiler_for("source.json")
+        monkeypatch.setattr(tokenize_module, "LONG_LINE", 10**9)
+        expected = tokenize(compiler, compiler.root_state, self.LINE, True)
+
+        batches = list(iter_tokenize(compiler, compiler.root_state, self.LINE, True, batch_size=7))
+        assert len(batches) > 1
+        assert tuple(region for _, _, batch in batches for region in batch) == expected[1]
+        assert batches[-1][0] == expected[0]
+        assert [pos for _, pos, _ in batches] == sorted(pos for _, pos, _ in batches)
+
+    def test_batched_style_runs(self, colorizer):
+        """Test runs built batch by batch are those of the whole line."""
+        compiler = colorizer.compiler_for("source.json")
+        line = self.LINE.encode()
+        _, regions = tokenize(compiler, compiler.root_state, line, True)
+        expected = style_runs(regions, len(line), colorizer.schema)
+
+        batches = iter_tokenize(compiler, compiler.root_state, line, True, batch_size=5)
+        assert batched_style_runs(batches, colorizer.schema)[1] == expected
+
+    def test_line_released(self, colorizer):
+        """Test no searches of a tokenized long line are kept alive."""
+        compiler = colorizer.compiler_for("source.json")
+        line = self.LINE.encode() * 20
+        tokenize(compiler, compiler.root_state, line, True)
+        gc.collect()
+        tracemalloc.start()
+        try:
+            for _ in range(3):
+                tokenize(compiler, compiler.root_state, line, True)
+            gc.collect()
+            retained = tracemalloc.get_traced_memory()[0]
+        finally:
+            tracemalloc.stop()
+        assert retained < len(line)
+
+    def test_render_unchanged(self, colorizer, monkeypatch):
+        """Test long lines render the same as through the short line path."""
+        doc = self.LINE * 2
+        long_render = colorizer.render(doc, "source.json", cache=False)
+        long_runs = list(colorizer.iter_style_runs(doc.encode().splitlines(), "source.json"))
+
+        monkeypatch.setattr(tokenize_module, "LONG_LINE", 10**9)
+        monkeypatch.setattr(colorize_module, "LONG_LINE", 10**9)
+        assert colorizer.render(doc, "source.json", cache=False) == long_render
+        assert list(colorizer.iter_style_runs(doc.encode().splitlines(), "source.json")) == long_runs
+
+
+class TestLongLineScaling:
+    """Test long lines tokenize in time linear in their length."""
+
+    LINES = {
+        "json-array": ("source.json", lambda n: "[" + ",".join(map(str, range(n))) + "]\n"),
+        "js-array": ("source.js", lambda n: "var a = [" + ",".join(map(str, range(n))) + "];\n"),
+        "js-parens": ("source.js", lambda n: "(" * n + "\n"),
+    }
+
+    @pytest.fixture
+    def colorizer(self):
+        return Colorize(grammar_dir=str(GRAMMAR_DIR), theme_path=str(THEME_PATH))
+
+    @staticmethod
+    def _seconds(compiler, line):
+        best = float("inf")
+        for _ in range(3):
+            began = time.perf_counter()
+            tokenize(compiler, compiler.root_state, line, True)
+            best = min(best, time.perf_counter() - began)
+        return best
+
+    @pytest.mark.parametrize("kind", list(LINES))
+    def test_four_times_longer(self, colorizer, kind):
+        """Test a line four times longer takes well under sixteen times as long."""
+        scope, make_line = self.LINES[kind]
+        compiler = colorizer.compiler_for(scope)
+        tokenize(compiler, compiler.root_state, make_line(10), True)
+
+        ratio = self._seconds(compiler, make_line(4000)) / self._seconds(compiler, make_line(1000))
+        assert ratio < 8
+
+    @pytest.mark.parametrize("kind", list(LINES))
+    def test_regions_match_short_line_path(self, colorizer, monkeypatch, kind):
+        """Test searching the patterns of a regset one by one finds the same regions."""
+        scope, make_line = self.LINES[kind]
+        compiler = colorizer.compiler_for(scope)
+        line = make_line(500)
+        regions = tokenize(compiler, compiler.root_state, line, True)
+
+        monkeypatch.setattr(tokenize_module, "LONG_LINE", 10**9)
+        assert tokenize(compiler, compiler.root_state, line, True) == regions
+
+
+def _md_lines(*texts):
+    """Build single part, uncolored lines."""
+    return [[SimpleLinePart(chars=text, column=0, color=None, style=None)] for text in texts]
+
+
+class TestStripMarkdown:
+    """Test the streaming markdown clean up."""
+
+    def test_is_lazy(self):
+        """Test lines are produced as the input is consumed."""
+        consumed = []
+
+        def source():
+            for line in _md_lines("one `two`\n", "three\n"):
+                consumed.append(line)
+                yield line
+
+        stripped = strip_markdown(source())
+        first = next(stripped)
+        assert first[0].chars == "one two\n"
+        assert len(consumed) == 1
+
+    def test_heading_and_rule(self):
+        """Test headings are stripped and rules between blank lines replaced."""
+        lines = list(strip_markdown(_md_lines("# Title\n", "\n", "---\n", "\n", "---\n", "text\n")))
+        chars = [line[0].chars for line in lines]
+        assert chars[0] == "Title\n"
+        assert chars[1].startswith("—")
+        assert chars[3].startswith("—")
+        # Not followed by a blank line
+        assert chars[5] == "---\n"
+        assert len(lines) == 7
+
+    def test_code_block_is_untouched(self):
+        """Test markdown within a fenced code block is kept."""
+        lines = list(strip_markdown(_md_lines("```yaml\n", "# *not* a heading\n", "```\n", "*em*\n")))
+        assert [line[0].chars for line in lines] == ["\n", "# *not* a heading\n", "\n", "em\n"]
+
+    def test_code_and_emphasis_in_one_part(self):
+        """Test both code and emphasis markers are removed from a part."""
+        lines = list(strip_markdown(_md_lines("`code` and *this*\n")))
+        assert lines[0][0].chars == "code and this\n"
+
+    def test_iter_render_matches_render(self):
+        """Test streamed markdown matches the whole document render."""
+        colorizer = Colorize(grammar_dir=str(GRAMMAR_DIR), theme_path=str(THEME_PATH))
+        doc = (Path(__file__).parent.parent / "README.md").read_text()
+        expected = [[part.chars for part in line] for line in colorizer.render(doc, "text.html.markdown", cache=False)]
+        streamed = [[part.chars for part in line] for line in colorizer.iter_render(doc, "text.html.markdown")]
+        assert streamed == expected
+
+
 @pytest.mark.skipif(not GRAMMAR_DIR.exists(), reason="Grammar directory not found")
 @pytest.mark.skipif(not THEME_PATH.exists(), reason="Theme file not found")
 class TestIntegration:
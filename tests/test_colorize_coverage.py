@@ -463,6 +463,56 @@ class TestAnsiToCursesEdgeCases:
         assert len(result) >= 1
 
 
+class TestNativeSgr:
+    """Test the native SGR parser behind ansi_to_curses and render_ansi."""
+
+    def test_combined_attributes(self):
+        """Test several attributes in one sequence are combined."""
+        import curses
+
+        result = ansi_to_curses("\x1b[1;4;35mText\x1b[0m")
+        assert [part.string for part in result] == ["Text"]
+        assert result[0].color == 5
+        assert result[0].decoration == curses.A_BOLD | curses.A_UNDERLINE
+
+    def test_true_color(self):
+        """Test 24-bit colors map onto the 256 color palette."""
+        assert ansi_to_curses("\x1b[38;2;255;0;0mX")[0].color == 196
+        assert ansi_to_curses("\x1b[38;2;128;128;128mX")[0].color == 244
+
+    def test_background_is_ignored(self):
+        """Test background colors do not change the foreground."""
+        result = ansi_to_curses("\x1b[32;48;5;196;48;2;1;2;3mText")
+        assert result[0].color == 2
+
+    def test_state_persists_until_reset(self):
+        """Test color carries over text until reset."""
+        result = ansi_to_curses("\x1b[31mred\x1b[1mbold red\x1b[22;39mplain")
+        assert [(part.string, part.color) for part in result] == [
+            ("red", 1),
+            ("bold red", 1),
+            ("plain", 0),
+        ]
+        assert [part.column for part in result] == [0, 3, 11]
+
+    def test_other_sequences_dropped(self):
+        """Test non SGR control sequences are removed from the text."""
+        result = ansi_to_curses("\x1b[2K\x1b[HCursor")
+        assert [part.string for part in result] == ["Cursor"]
+
+    def test_render_ansi_document(self):
+        """Test a document is split into lines like str.splitlines."""
+        doc = "\x1b[32mok\x1b[0m\r\n\n\x1b[0m\nlast\n"
+        lines = Colorize.render_ansi(doc, cache=False)
+        assert len(lines) == len(doc.splitlines())
+        assert lines[0][0].string == "ok"
+        assert lines[0][0].color == 2
+        assert lines[1][0].string == ""
+        assert lines[1][0].color == Color.BLACK
+        assert lines[2] == ()
+        assert lines[3][0].string == "last"
+
+
 class TestColorConversionEdgeCases:
     """Test color conversion edge cases."""
 
@@ -0,0 +1,112 @@
+"""Tests for lazily highlighted documents."""
+from __future__ import annotations
+
+from pathlib import Path
+
+import pytest
+
+from pyonig.colorize import Colorize
+from pyonig.document import HighlightedDocument
+
+
+GRAMMAR_DIR = Path(__file__).parent.parent / "src" / "pyonig" / "grammars"
+THEME_PATH = Path(__file__).parent.parent / "src" / "pyonig" / "themes" / "dark_vs.json"
+SAMPLE = Path(__file__).parent.parent / "demo" / "sample.py"
+
+
+@pytest.fixture(scope="module")
+def colorizer():
+    """A colorizer shared by the tests in this module."""
+    return Colorize(grammar_dir=str(GRAMMAR_DIR), theme_path=str(THEME_PATH))
+
+
+def _chars(lines):
+    return [[(part.chars, part.color, part.style) for part in line] for line in lines]
+
+
+class TestHighlightedDocument:
+    """Test the viewport-lazy highlighted document."""
+
+    def test_nothing_tokenized_up_front(self, colorizer):
+        """Test creating the document does no tokenization."""
+        document = HighlightedDocument(colorizer, SAMPLE.read_text(), "source.python")
+        assert document.tokenized_lines == 0
+        assert len(document) == len(SAMPLE.read_text().splitlines())
+
+    def test_viewport_tokenizes_only_what_is_needed(self, colorizer):
+        """Test the first screen only tokenizes the first block."""
+        doc = SAMPLE.read_text() * 10
+        document = HighlightedDocument(colorizer, doc, "source.python", checkpoint_every=16)
+        view = document.viewport(0, 10)
+        assert len(view) == 10
+        assert document.tokenized_lines == 16
+
+    def test_matches_full_render(self, colorizer):
+        """Test lines rendered in any order match the full render."""
+        doc = SAMPLE.read_text()
+        expected = _chars(colorizer.render(doc, "source.python", cache=False))
+        document = HighlightedDocument(
+            colorizer,
+            doc,
+            "source.python",
+            checkpoint_every=7,
+            max_blocks=2,
+        )
+        order = list(range(len(document)))
+        order = order[len(order) // 2 :] + order[: len(order) // 2][::-1]
+        rendered = {line_idx: document[line_idx] for line_idx in order}
+        assert _chars(rendered[line_idx] for line_idx in range(len(document))) == expected
+        assert _chars(document[10:30]) == expected[10:30]
+        assert _chars(document[-3:]) == expected[-3:]
+
+    def test_lines_sequence(self, colorizer):
+        """Test a sequence of lines is accepted in place of the text."""
+        document = HighlightedDocument(colorizer, ['{"a": 1}', "[]"], "source.json")
+        assert ["".join(part.chars for part in line) for line in document] == ['{"a": 1}\n', "[]\n"]
+
+    def test_index_errors(self, colorizer):
+        """Test out of range lines and invalid settings raise."""
+        document = HighlightedDocument(colorizer, "a\nb", "source.json")
+        assert document[-1][0].chars.startswith("b")
+        with pytest.raises(IndexError):
+            document[2]
+        with pytest.raises(ValueError, match="at least 1"):
+            HighlightedDocument(colorizer, "a", "source.json", checkpoint_every=0)
+
+    def test_no_color(self, colorizer):
+        """Test no_color documents are rendered plain."""
+        document = HighlightedDocument(colorizer, "a\nb", "no_color")
+        assert [line[0].chars for line in document] == ["a", "b"]
+        assert document[0][0].color is None
+
+    def test_tokenize_error_falls_back_to_plain(self, colorizer, monkeypatch):
+        """Test lines from a failing one onwards are plain."""
+        import pyonig.document
+
+        real_tokenize = pyonig.document.tokenize
+
+        def failing(compiler, state, line, first_line):
+            if line.startswith("boom"):
+                raise RuntimeError("boom")
+            return real_tokenize(compiler, state, line, first_line)
+
+        monkeypatch.setattr(pyonig.document, "tokenize", failing)
+        document = HighlightedDocument(
+            colorizer,
+            '"a"\n"b"\nboom\n"c"\n"d"',
+            "source.json",
+            checkpoint_every=2,
+        )
+        assert document[4][0].chars == '"d"'
+        assert document[4][0].color is None
+        assert document[3][0].color is None
+        assert document[1][0].color is not None
+
+    def test_markdown_keeps_line_numbers(self, colorizer):
+        """Test markdown clean up does not insert lines."""
+        doc = "# Title\n\nSome `code`\n```\n# not a heading\n```\n"
+        document = HighlightedDocument(colorizer, doc, "text.html.markdown", checkpoint_every=2)
+        assert len(document) == 6
+        assert "".join(part.chars for part in document[0]) == "Title\n"
+        assert "".join(part.chars for part in document[2]) == "Some code\n"
+        assert "".join(part.chars for part in document[4]) == "# not a heading\n"
@@ -0,0 +1,106 @@
+"""Tests for following growing files and pipes."""
+from __future__ import annotations
+
+import io
+import os
+
+import pytest
+
+import pyonig
+from pyonig.follow import follow_lines, stream_lines
+
+
+class TestStreamLines:
+    """Test reading a stream line by line."""
+
+    def test_lines_and_final_partial(self):
+        """Test line endings are removed and a final partial line is kept."""
+        stream = io.BytesIO(b"one\r\ntwo\n\nthree")
+        assert list(stream_lines(stream)) == [b"one", b"two", b"", b"three"]
+
+    def test_lines_split_across_reads(self):
+        """Test a line arriving in several reads is produced once complete."""
+        read_fd, write_fd = os.pipe()
+        with os.fdopen(read_fd, "rb", buffering=0) as reader:
+            lines = stream_lines(reader)
+            os.write(write_fd, b"par")
+            os.write(write_fd, b"tial\nnext")
+            assert next(lines) == b"partial"
+            os.write(write_fd, b"\n")
+            assert next(lines) == b"next"
+            os.close(write_fd)
+            assert list(lines) == []
+
+
+class TestFollowLines:
+    """Test following a file through growth, truncation and rotation."""
+
+    def test_growth(self, tmp_path):
+        """Test lines appended later are followed, partial lines wait."""
+        path = tmp_path / "app.log"
+        path.write_bytes(b"first\nsec")
+        lines = follow_lines(path, poll_interval=0.001, idle_timeout=0.05)
+        assert next(lines) == b"first"
+
+        with path.open("ab") as file:
+            file.write(b"ond\nthird\n")
+        assert next(lines) == b"second"
+        assert next(lines) == b"third"
+        assert list(lines) == []
+
+    def test_truncation(self, tmp_path):
+        """Test a truncated file is read again from the start."""
+        path = tmp_path / "app.log"
+        path.write_bytes(b"old line one\nold line two\n")
+        lines = follow_lines(path, poll_interval=0.001, idle_timeout=0.05)
+        assert [next(lines), next(lines)] == [b"old line one", b"old line two"]
+
+        path.write_bytes(b"new\n")
+        assert list(lines) == [None, b"new"]
+
+    def test_rotation(self, tmp_path):
+        """Test a rotated file is drained and the new file followed."""
+        path = tmp_path / "app.log"
+        path.write_bytes(b"before\n")
+        lines = follow_lines(path, poll_interval=0.001, idle_timeout=0.05)
+        assert next(lines) == b"before"
+
+        with path.open("ab") as file:
+            file.write(b"unterminated")
+        path.rename(tmp_path / "app.log.1")
+        path.write_bytes(b"after\n")
+        assert list(lines) == [b"unterminated", None, b"after"]
+
+    def test_missing(self, tmp_path):
+        """Test following a missing file fails at once."""
+        with pytest.raises(FileNotFoundError):
+            next(follow_lines(tmp_path / "missing.log"))
+
+
+class TestHighlightFollow:
+    """Test highlighting a followed file or stream."""
+
+    CONTENT = b'{"a": [1,\n  "two"],\n "b": null}\n'
+
+    def test_file_matches_highlight_bytes(self, tmp_path):
+        """Test a followed file is colored as the complete file would be."""
+        path = tmp_path / "data.json"
+        path.write_bytes(self.CONTENT)
+        lines = pyonig.highlight_follow(path, theme="dark", idle_timeout=0.05)
+        expected = pyonig.highlight_bytes(self.CONTENT, language="json", theme="dark")
+        assert b"\n".join(lines) == expected
+
+    def test_stream_detects_language(self):
+        """Test the language of a stream is detected from its first line."""
+        lines = pyonig.highlight_follow(io.BytesIO(b'{"a": 1}\n'), theme="dark")
+        assert list(lines) == [pyonig.highlight_bytes(b'{"a": 1}', language="json", theme="dark")]
+
+    def test_truncation_restarts_tokenizer(self, tmp_path):
+        """Test tokenizer state does not carry into a truncated file."""
+        path = tmp_path / "data.json"
+        path.write_bytes(b'{"open": "unterminated\n')
+        lines = pyonig.highlight_follow(path, language="json", theme="dark", idle_timeout=0.05)
+        next(lines)
+
+        path.write_bytes(b"[1]\n")
+        assert list(lines) == [pyonig.highlight_bytes(b"[1]", language="json", theme="dark")]
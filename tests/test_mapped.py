@@ -0,0 +1,82 @@
+"""Tests for memory-mapped line access."""
+from __future__ import annotations
+
+import pytest
+
+from pyonig._pyonig import line_index
+from pyonig.mapped import MappedLines
+
+
+def _starts(data):
+    return list(memoryview(line_index(data)).cast("n"))
+
+
+class TestLineIndex:
+    """Test the native line start index."""
+
+    @pytest.mark.parametrize(
+        ("data", "starts"),
+        [
+            (b"", [0]),
+            (b"a", [0, 1]),
+            (b"a\n", [0, 2]),
+            (b"a\nb", [0, 2, 3]),
+            (b"\n\n", [0, 1, 2]),
+            (b"a\r\nb\n", [0, 3, 5]),
+        ],
+    )
+    def test_starts(self, data, starts):
+        """Test a start per line and the end of the buffer are recorded."""
+        assert _starts(data) == starts
+
+    def test_buffer_protocol(self):
+        """Test any buffer is accepted and other objects rejected."""
+        assert _starts(bytearray(b"x\ny")) == [0, 2, 3]
+        assert _starts(memoryview(b"x\ny")[2:]) == [0, 1]
+        with pytest.raises(TypeError):
+            line_index("text")
+
+
+class TestMappedLines:
+    """Test lines read through a memory mapping."""
+
+    def test_lines_match_splitlines(self, tmp_path):
+        """Test lines match str.splitlines for \\n and \\r\\n endings."""
+        text = "first\r\nsecond\n\nthird ü\nlast"
+        path = tmp_path / "file.txt"
+        path.write_bytes(text.encode("utf-8"))
+        with MappedLines(path) as lines:
+            assert list(lines) == text.splitlines()
+            assert lines[-1] == "last"
+            assert lines[1:3] == ["second", ""]
+            assert bytes(lines.line_bytes(3)) == "third ü".encode("utf-8")
+            assert lines.size == len(text.encode("utf-8"))
+            assert lines.head(5) == b"first"
+
+    def test_invalid_utf8_replaced(self, tmp_path):
+        """Test invalid UTF-8 is replaced."""
+        path = tmp_path / "file.txt"
+        path.write_bytes(b"ok\n\xff\xfe bad\n")
+        with MappedLines(path) as lines:
+            assert lines[1] == "�� bad"
+
+    def test_empty_file(self, tmp_path):
+        """Test an empty file has no lines."""
+        path = tmp_path / "empty.txt"
+        path.write_bytes(b"")
+        with MappedLines(path) as lines:
+            assert len(lines) == 0
+            assert lines.head() == b""
+
+    def test_index_out_of_range(self, tmp_path):
+        """Test out of range lines raise IndexError."""
+        path = tmp_path / "file.txt"
+        path.write_bytes(b"one\n")
+        with MappedLines(path) as lines:
+            with pytest.raises(IndexError):
+                lines[1]
+
+    def test_missing_file(self, tmp_path):
+        """Test a missing file raises FileNotFoundError."""
+        with pytest.raises(FileNotFoundError):
+            MappedLines(tmp_path / "missing.txt")
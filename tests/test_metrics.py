@@ -0,0 +1,99 @@
+"""Tests for the process wide metrics and their Prometheus exposition."""
+from __future__ import annotations
+
+import threading
+
+import pyonig
+from pyonig.metrics import Counters
+
+
+CODE = 'def f(x: int) -> str:\n    """Doc."""\n    return f"{x!r}"  # done\n'
+
+
+class TestStats:
+    """Test the stats() snapshot."""
+
+    def test_highlight_counted(self):
+        """Test highlighting grows the search, line and time counters."""
+        before = pyonig.stats()
+        pyonig.highlight(CODE, language='python', cache=False)
+        after = pyonig.stats()
+
+        searches = after['searches'] - before['searches']
+        assert searches > 0
+        assert after['matches'] - before['matches'] + after['misses'] - before['misses'] == searches
+        assert after['bytes_scanned'] > before['bytes_scanned']
+        assert after['lines_tokenized'] - before['lines_tokenized'] == CODE.count('\n')
+        for name in ('tokenize_seconds', 'colorize_seconds', 'render_seconds'):
+            assert after[name] > before[name]
+
+    def test_streaming_counted(self):
+        """Test lines highlighted one at a time are counted as consumed."""
+        before = pyonig.stats()
+        lines = list(pyonig.highlight_bytes(CODE.encode(), language='python').splitlines())
+        after = pyonig.stats()
+        assert len(lines) == 3
+        assert after['lines_tokenized'] - before['lines_tokenized'] == 3
+        assert after['render_seconds'] > before['render_seconds']
+
+    def test_compiles_counted(self):
+        """Test compiling a new pattern is counted, a shared one is not."""
+        before = pyonig.stats()['regex_compiles']
+        pattern = pyonig.compile('metrics-new-pattern')
+        assert pyonig.stats()['regex_compiles'] == before + 1
+        again = pyonig.compile_regset('metrics-new-pattern', 'metrics-other')
+        assert pyonig.stats()['regex_compiles'] == before + 2
+        del pattern, again
+
+    def test_caches(self):
+        """Test each cache of the memory budget reports a hit ratio."""
+        pyonig.highlight(CODE, language='python')
+        pyonig.highlight(CODE, language='python')
+        caches = pyonig.stats()['caches']
+        assert caches['render']['hits'] >= 1
+        assert 0 < caches['render']['hit_ratio'] <= 1
+        assert all(0 <= cache['hit_ratio'] <= 1 for cache in caches.values())
+
+
+class TestCounters:
+    """Test the Python side counters."""
+
+    def test_threads(self):
+        """Test adds from several threads are not lost."""
+        counters = Counters('n', 'm')
+
+        def add():
+            for _ in range(1000):
+                counters.add(n=1, m=2)
+
+        threads = [threading.Thread(target=add) for _ in range(8)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        assert counters.snapshot() == {'n': 8000, 'm': 16000}
+
+
+class TestPrometheus:
+    """Test the Prometheus text exposition."""
+
+    def test_format(self):
+        """Test every metric has help and type lines and a sample."""
+        text = pyonig.prometheus_text()
+        assert text.endswith('\n')
+        lines = text.splitlines()
+        assert '# TYPE pyonig_searches_total counter' in lines
+        assert '# TYPE pyonig_memory_bytes gauge' in lines
+        assert any(line.startswith('pyonig_cache_hits_total{cache="render"} ') for line in lines)
+        for line in lines:
+            if not line.startswith('#'):
+                name, value = line.rsplit(' ', 1)
+                float(value)
+                assert name.startswith('pyonig_')
+
+    def test_snapshot_and_prefix(self):
+        """Test a given snapshot is exposed under a given prefix."""
+        snapshot = pyonig.stats()
+        snapshot['searches'] = 42
+        lines = pyonig.prometheus_text(snapshot, prefix='app_pyonig').splitlines()
+        assert 'app_pyonig_searches_total 42' in lines
@@ -1,8 +1,14 @@
 """Tests for pyonig C extension (core regex functionality)."""
 from __future__ import annotations
 
+import shutil
+import subprocess
+import sys
+import tracemalloc
+
 import pytest
 import pyonig
+from pyonig._pyonig import shared_regex_count
 
 
 class TestBasicRegex:
@@ -124,6 +130,231 @@ class TestRegSet:
         assert match is None
 
 
+class TestThreading:
+    """Test searching from several threads with the GIL released."""
+
+    def test_concurrent_regset_search(self):
+        """Test that a shared regset gives correct results across threads."""
+        from concurrent.futures import ThreadPoolExecutor
+
+        regset = pyonig.compile_regset("foo", "b(a)r", "baz")
+        subjects = [("x" * n) + "bar" + ("y" * n) for n in range(200)]
+
+        def search(subject):
+            idx, match = regset.search(subject)
+            return idx, match.span(), match.span(1)
+
+        with ThreadPoolExecutor(max_workers=8) as pool:
+            results = list(pool.map(search, subjects))
+
+        for n, (idx, span, group_span) in enumerate(results):
+            assert idx == 1
+            assert span == (n, n + 3)
+            assert group_span == (n + 1, n + 2)
+
+    def test_concurrent_compile(self):
+        """Test compiling from several threads with the GIL released."""
+        from concurrent.futures import ThreadPoolExecutor
+
+        def compile_and_search(n):
+            regset = pyonig.compile_regset("x{%d}" % n, "(y+)z")
+            pattern = pyonig.compile("a{%d}" % n)
+            return regset.search("y" * n + "z")[0], pattern.search("a" * n).span()
+
+        with ThreadPoolExecutor(max_workers=8) as pool:
+            results = list(pool.map(compile_and_search, range(1, 100)))
+
+        assert results == [(1, (0, n)) for n in range(1, 100)]
+
+    def test_regset_compile_errors(self):
+        """Test errors compiling a regset are raised once the GIL is back."""
+        with pytest.raises(pyonig.OnigError):
+            pyonig.compile_regset("ok", "[invalid")
+        with pytest.raises(TypeError):
+            pyonig.compile_regset("ok", 1)
+
+
+class TestSharedRegexes:
+    """Test patterns and regsets sharing compiled regexes."""
+
+    def test_compiled_once(self):
+        """Test a pattern is compiled once for every regset and pattern of it."""
+        before = shared_regex_count()
+        pattern = pyonig.compile("sh(a)red")
+        regsets = [pyonig.compile_regset("other%d" % n, "sh(a)red") for n in range(3)]
+        assert shared_regex_count() == before + 4
+
+        for regset in regsets:
+            idx, match = regset.search("is shared")
+            assert (idx, match.span(), match.span(1)) == (1, (3, 9), (5, 6))
+        assert pattern.search("is shared").span(1) == (5, 6)
+
+        del pattern, regsets, regset
+        assert shared_regex_count() == before
+
+    def test_outlives_regset(self):
+        """Test a shared regex stays usable after a regset of it is freed."""
+        regset = pyonig.compile_regset("kept", "dropped")
+        pattern = pyonig.compile("kept")
+        del regset
+        assert pattern.search("is kept").span() == (3, 7)
+        assert pyonig.compile_regset("kept").search("kept")[0] == 0
+
+    def test_repeated_in_regset(self):
+        """Test a regset can hold the same pattern more than once."""
+        before = shared_regex_count()
+        regset = pyonig.compile_regset("twice", "other", "twice")
+        assert shared_regex_count() == before + 2
+        assert regset.search("other twice")[0] == 1
+        del regset
+        assert shared_regex_count() == before
+
+    def test_failed_regset_releases(self):
+        """Test a regset that fails to compile releases the regexes it took."""
+        before = shared_regex_count()
+        pattern = pyonig.compile("held")
+        with pytest.raises(pyonig.OnigError):
+            pyonig.compile_regset("held", "fresh", "[invalid")
+        assert shared_regex_count() == before + 1
+        del pattern
+        assert shared_regex_count() == before
+
+    def test_concurrent_compile_shares(self):
+        """Test threads compiling the same patterns end up sharing them."""
+        from concurrent.futures import ThreadPoolExecutor
+
+        before = shared_regex_count()
+        patterns = tuple("race%d" % n for n in range(20))
+
+        def compile_all(_):
+            return pyonig.compile_regset(*patterns)
+
+        with ThreadPoolExecutor(max_workers=8) as pool:
+            regsets = list(pool.map(compile_all, range(32)))
+
+        assert shared_regex_count() == before + len(patterns)
+        assert all(regset.search("race7")[0] == 7 for regset in regsets)
+        del regsets
+        assert shared_regex_count() == before
+
+
+class TestRetryCounting:
+    """Test counting the retries of patterns and regsets."""
+
+    def test_pattern_counts(self):
+        """Test a backtracking pattern counts its retries across searches."""
+        pattern = pyonig.compile(r"(a|aa)+$", count_retries=True)
+        assert pattern.retries == 0
+        assert pattern.search("a" * 20 + "b") is None
+        first = pattern.retries
+        assert first > 1000
+        assert pattern.match("a" * 20 + "b") is None
+        assert pattern.retries > first
+        assert pyonig.compile(r"(a|aa)+$").retries is None
+
+    def test_same_matches(self):
+        """Test counting does not change what a pattern matches."""
+        for source in (r"(\w+) (?<x>\d)", r"a # comment", r"(?x) a # comment", r"\Gb|c"):
+            plain = pyonig.compile(source)
+            counting = pyonig.compile(source, count_retries=True)
+            assert repr(counting) == repr(plain)
+            assert counting.number_of_captures() == plain.number_of_captures()
+            groups = range(plain.number_of_captures() + 1)
+            for subject in ("word 1", "a # comment", "xa", "bc"):
+                for start in (0, 1):
+                    got, want = counting.search(subject, start), plain.search(subject, start)
+                    assert (got is None) == (want is None)
+                    if want is not None:
+                        assert [got.span(n) for n in groups] == [want.span(n) for n in groups]
+
+    def test_regset_counts_per_pattern(self):
+        """Test a regset counts the retries of each of its patterns."""
+        regset = pyonig.compile_regset(r"(a|aa)+b|c", r"x", count_retries=True)
+        assert regset.retries == (0, 0)
+        idx, match = regset.search("a" * 20 + "c")
+        assert (idx, match.span()) == (0, (20, 21))
+        slow, fast = regset.retries
+        assert slow > 1000
+        assert fast < slow
+        assert pyonig.compile_regset("x").retries is None
+        assert pyonig.compile_regset(count_retries=True).retries == ()
+
+    def test_shared_apart_from_plain(self):
+        """Test counting regexes are shared with each other but not plain ones."""
+        before = shared_regex_count()
+        plain = pyonig.compile("counted")
+        counting = pyonig.compile("counted", count_retries=True)
+        regset = pyonig.compile_regset("counted", count_retries=True)
+        assert shared_regex_count() == before + 2
+        del plain, counting, regset
+        assert shared_regex_count() == before
+
+
+class TestTracepoints:
+    """Test the USDT probes of extensions built with <sys/sdt.h>."""
+
+    def test_probes(self):
+        """Test every probe is in the extension's stapsdt notes."""
+        readelf = shutil.which('readelf')
+        if readelf is None:
+            pytest.skip('readelf not found')
+        notes = subprocess.run(
+            [readelf, '--notes', pyonig._pyonig.__file__],
+            capture_output=True, text=True, check=False,
+        ).stdout
+        if 'stapsdt' not in notes:
+            pytest.skip('built without <sys/sdt.h>')
+        names = {
+            line.split(':', 1)[1].strip()
+            for line in notes.splitlines()
+            if line.strip().startswith('Name:')
+        }
+        assert 'Provider: pyonig' in notes
+        assert {'compile', 'match', 'search', 'regset_search', 'match_alloc'} <= names
+
+
+class TestLongSubjects:
+    """Test searching long subjects."""
+
+    def test_earliest_match_4k_in(self):
+        """Test a match whose literal is about 4 KiB in is still the earliest."""
+        regset = pyonig.compile_regset("abcdef", "c")
+        pattern = pyonig.compile("[a-z]bcdef|y")
+        for offset in range(4080, 4100):
+            subject = b"x" * offset + b"abcdef" + b"y" * 10000
+            idx, match = regset.search(subject)
+            assert (idx, match.start()) == (0, offset)
+            assert pattern.search(subject).start() == offset
+            assert pattern.search(subject.decode(), 10).start() == offset
+
+    def test_long_match_before_short_one(self):
+        """Test a match reaching far ahead wins over a later short one."""
+        subject = "#ab" + "a" * 5000 + "x"
+        assert pyonig.compile(r"#[ab]*x|b").search(subject).span() == (0, 5004)
+        idx, match = pyonig.compile_regset(r"#[ab]*x", "b").search(subject.encode())
+        assert (idx, match.span()) == (0, (0, 5004))
+
+    def test_match_far_ahead(self):
+        """Test matches far from the start and at the end are found."""
+        subject = "é" * 50000 + "end"
+        assert pyonig.compile("end").search(subject).span() == (50000, 50003)
+        assert pyonig.compile("$").search(subject).span() == (50003, 50003)
+        assert pyonig.compile("missing").search(subject) is None
+
+    def test_subscript_does_not_leak(self):
+        """Test indexing a match frees its argument tuple."""
+        match = pyonig.compile(r"(\w+)").search(b"word")
+        tracemalloc.start()
+        try:
+            before = tracemalloc.get_traced_memory()[0]
+            for _ in range(10000):
+                match[1]
+            grown = tracemalloc.get_traced_memory()[0] - before
+        finally:
+            tracemalloc.stop()
+        assert grown < 10000
+
+
 class TestEdgeCases:
     """Test edge cases and boundary conditions."""
 
@@ -172,6 +403,47 @@ class TestEdgeCases:
         pass
 
 
+class TestBytesSubjects:
+    """Test searching UTF-8 bytes with byte offsets."""
+
+    def test_byte_offsets(self):
+        """Test bytes subjects report byte offsets and bytes groups."""
+        pattern = pyonig.compile(r"(w)(o)?rld")
+        text = "こんにちは world".encode("utf-8")
+        match = pattern.search(text)
+        assert match.span() == (16, 21)
+        assert match[0] == b"world"
+        assert match.span(2) == (17, 18)
+        assert match.string is text
+
+    def test_start_is_a_byte_offset(self):
+        """Test the start position of a bytes search is in bytes."""
+        pattern = pyonig.compile("o")
+        text = "ü ooo".encode("utf-8")
+        assert pattern.search(text, 4).span() == (4, 5)
+        assert pattern.match(text, 3).span() == (3, 4)
+        assert pattern.search(text, len(text)) is None
+
+    def test_regset_bytes(self):
+        """Test RegSet searches bytes with byte offsets."""
+        regset = pyonig.compile_regset("x", "w(or)")
+        idx, match = regset.search("ключ world".encode("utf-8"))
+        assert idx == 1
+        assert match.span() == (9, 12)
+        assert match[1] == b"or"
+
+    def test_unmatched_group(self):
+        """Test an unmatched optional group in a bytes match."""
+        match = pyonig.compile("a(b)?").search(b"a")
+        assert match[1] == b""
+        assert match.span(1) == (-1, -1)
+
+    def test_invalid_subject_type(self):
+        """Test subjects other than str and bytes are rejected."""
+        with pytest.raises(TypeError, match="str or bytes"):
+            pyonig.compile("a").search(1)
+
+
 class TestOptions:
     """Test various Oniguruma options."""
 
@@ -216,9 +488,53 @@ class TestErrorHandling:
         with pytest.raises(IndexError):
             match.group(5)  # Only has groups 0 and 1
 
+    def test_search_error(self):
+        """Test a search over the retry limit raises OnigError."""
+        pattern = pyonig.compile(r"(a+)+b")
+        with pytest.raises(pyonig.OnigError, match="retry-limit"):
+            pattern.search("a" * 40)
+        with pytest.raises(pyonig.OnigError, match="retry-limit"):
+            pattern.match("a" * 40)
+
+    def test_search_retry_limit(self):
+        """Test a search can be given up after fewer retries."""
+        pattern = pyonig.compile(r"(a+)+b")
+        with pytest.raises(pyonig.OnigError, match="retry-limit-in-search"):
+            pattern.search("a" * 20, retry_limit=1000)
+        assert pattern.search("a" * 5 + "b", retry_limit=1000).span() == (0, 6)
+        assert pattern.search("a" * 20) is None
+
     @pytest.mark.skip(reason="Named group access not yet implemented")
     def test_invalid_group_name(self):
         """Test accessing non-existent named group."""
         # Would test named group access errors
         pass
 
+
+
+class TestLazyImports:
+    """Test the highlighting API is imported on first use."""
+
+    def test_regex_api_alone(self):
+        """Test importing pyonig and compiling does not import the highlighting stack."""
+        code = (
+            "import sys, pyonig; pyonig.compile('a').search('a', 0);"
+            "print(sorted(m for m in ('pyonig.api', 'pyonig.colorize', 'curses', 'asyncio') if m in sys.modules))"
+        )
+        out = subprocess.run([sys.executable, "-c", code], capture_output=True, text=True, check=True)
+        assert out.stdout.strip() == "[]"
+
+    def test_lazy_attributes(self):
+        """Test the highlighting API and submodules resolve on access."""
+        from pyonig import api
+        from pyonig import theme
+
+        assert pyonig.highlight is api.highlight
+        assert pyonig.ThemeManager is theme.ThemeManager
+        assert pyonig.api is api
+        assert set(pyonig.__all__) <= set(dir(pyonig))
+
+    def test_unknown_attribute(self):
+        """Test unknown attributes still raise AttributeError."""
+        with pytest.raises(AttributeError, match="no_such_name"):
+            pyonig.no_such_name
@@ -0,0 +1,105 @@
+"""Tests for the per rule tokenizer profiler."""
+from __future__ import annotations
+
+import pyonig
+from pyonig.rule_profile import RuleProfile, _rule_paths, profile_rules
+from pyonig.tm_tokenize.grammars import Grammar
+from pyonig.tm_tokenize.reg import SEARCH_PROFILES
+
+
+CODE = 'def f(x: int) -> str:\n    """Doc."""\n    return f"{x!r}"  # done\n'
+
+
+class TestProfile:
+    """Test recording searches and attributing them to rules."""
+
+    def test_attributed_to_rules(self):
+        """Test searches are counted per regset and named by grammar and rule."""
+        with profile_rules() as profile:
+            pyonig.highlight(CODE, language='python', cache=False)
+        assert not SEARCH_PROFILES
+
+        stats = profile.stats()
+        assert stats == sorted(stats, key=lambda stat: stat.seconds, reverse=True)
+        assert all(stat.calls >= stat.matches for stat in stats)
+        by_rule = {(stat.grammar, stat.rule): stat for stat in stats}
+        root = by_rule['source.python.json', 'patterns']
+        assert root.kind == 'regset'
+        assert root.patterns > 1
+        assert root.calls >= CODE.count('\n')
+        assert root.scanned > 0
+        assert any(stat.rule.startswith('#') for stat in stats)
+
+    def test_end_with_back_reference(self):
+        """Test an end regex expanded from the begin match finds its rule."""
+        with profile_rules() as profile:
+            pyonig.highlight('cat <<END\nhello $x\nEND\n', language='shell', cache=False)
+        ends = [stat for stat in profile.stats() if stat.kind == 'end']
+        assert any(stat.rule.startswith('#heredoc') for stat in ends)
+        assert all(stat.grammar != '?' for stat in profile.stats())
+
+    def test_inactive_outside_block(self):
+        """Test nothing is recorded once the block exits."""
+        with profile_rules() as profile:
+            pass
+        pyonig.highlight(CODE, language='python', cache=False)
+        assert profile.stats() == []
+
+    def test_format(self):
+        """Test the table lists the slowest rules and a total."""
+        with profile_rules() as profile:
+            pyonig.highlight(CODE, language='python', cache=False)
+        lines = profile.format(top=3).splitlines()
+        assert lines[0].split() == ['ms', 'calls', 'scanned', 'matches', 'kind', 'rule']
+        assert len(lines) == 5
+        assert 'total in' in lines[-1]
+        assert RuleProfile().format().splitlines()[-1].split()[:2] == ['0.00', '0']
+
+
+    def test_retries(self):
+        """Test counting retries reports patterns by retries per character."""
+        with profile_rules(count_retries=True) as profile:
+            pyonig.highlight(CODE, language='python', cache=False)
+        retries = profile.retries()
+        assert retries
+        assert retries == sorted(retries, key=lambda stat: stat.per_char, reverse=True)
+        assert all(stat.per_char > 0 and stat.grammar != '?' for stat in retries)
+        worst = retries[0]
+        assert worst.per_char == worst.retries / worst.scanned
+        assert profile.retries(threshold=worst.per_char) == []
+
+        lines = profile.format_retries(threshold=0, top=2).splitlines()
+        assert lines[0].split() == ['per', 'char', 'retries', 'scanned', 'kind', 'rule']
+        assert len(lines) == 4
+        assert lines[-1].startswith(f'{len(retries)} patterns over 0')
+
+    def test_retries_not_counted(self):
+        """Test a profile not counting retries reports none."""
+        with profile_rules() as profile:
+            pyonig.highlight(CODE, language='python', cache=False)
+        assert profile.retries() == []
+
+
+class TestRulePaths:
+    """Test naming the rules of a grammar."""
+
+    def test_paths(self):
+        """Test rules are named from their repository key and grammar keys."""
+        grammar = Grammar.make({
+            'scopeName': 'source.test',
+            'patterns': [{'include': '#word'}, {'match': 'x', 'captures': {'0': {'name': 'y'}}}],
+            'repository': {
+                'word': {
+                    'begin': 'a',
+                    'end': 'b',
+                    'patterns': [{'match': 'c'}],
+                    'repository': {'inner': {'match': 'd'}},
+                },
+            },
+        })
+        paths = {path: rule for rule, path in _rule_paths(grammar).items()}
+        assert paths['#word'].begin == 'a'
+        assert paths['#word/patterns/0'].match == 'c'
+        assert paths['#word/repository/inner'].match == 'd'
+        assert paths['patterns/0'].include == '#word'
+        assert paths['patterns/1/captures/0'].name == ('y',)
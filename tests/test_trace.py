@@ -0,0 +1,58 @@
+"""Tests for recording the highlight pipeline as a trace."""
+from __future__ import annotations
+
+import json
+
+import pyonig
+from pyonig.trace import TRACES
+
+
+CODE = 'def f(x: int) -> str:\n    """Doc."""\n    return f"{x!r}"  # done\n'
+
+
+class TestRecordTrace:
+    """Test record_trace()."""
+
+    def test_stages(self):
+        """Test the stages of a highlight are recorded, a span per line."""
+        with pyonig.record_trace() as trace:
+            pyonig.highlight(CODE.encode(), cache=False)
+        names = [event['name'] for event in trace.events() if event['ph'] == 'X']
+        for name in ('highlight', 'detect', 'theme', 'tokenize', 'colorize', 'render'):
+            assert name in names
+        assert names.count('tokenize') == CODE.count('\n')
+        assert names.count('highlight') == 1
+
+    def test_save(self, tmp_path):
+        """Test the trace is written as Chrome trace-event JSON on exit."""
+        path = tmp_path / 'highlight.trace.json'
+        with pyonig.record_trace(path):
+            pyonig.highlight(CODE, language='python', cache=False)
+        data = json.loads(path.read_text())
+        events = data['traceEvents']
+        spans = [event for event in events if event['ph'] == 'X']
+        assert spans
+        for event in spans:
+            assert event['cat'] == 'pyonig'
+            assert event['dur'] >= 0
+            assert {'ts', 'pid', 'tid'} <= event.keys()
+        named = {event['tid'] for event in events if event['ph'] == 'M'}
+        assert {event['tid'] for event in spans} <= named
+
+    def test_threads(self):
+        """Test snippets highlighted by workers carry their thread's ID."""
+        snippets = [f'{{"key": {i}}}' for i in range(32)]
+        with pyonig.record_trace() as trace:
+            pyonig.highlight_many(snippets, language='json', cache=False, max_workers=4)
+        highlights = [event for event in trace.events() if event['name'] == 'highlight']
+        assert len(highlights) == len(snippets)
+        assert len(trace.thread_names) >= 1
+        assert {event['tid'] for event in highlights} <= trace.thread_names.keys()
+
+    def test_inactive(self):
+        """Test nothing is recorded outside the block."""
+        with pyonig.record_trace() as trace:
+            pass
+        pyonig.highlight(CODE, language='python', cache=False)
+        assert trace.spans == []
+        assert not TRACES
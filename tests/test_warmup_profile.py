@@ -0,0 +1,79 @@
+"""Tests for profile guided warmup."""
+from __future__ import annotations
+
+import json
+
+import pyonig
+from pyonig.tm_tokenize import reg
+from pyonig.tm_tokenize.compiler import COMPILE_LOGS
+from pyonig.warmup_profile import PROFILE_VERSION, WarmupProfile, regex_digest
+
+
+CODE = 'def f(x: int) -> str:\n    """Doc."""\n    return f"{x!r}"  # done\n'
+
+
+def _record(path):
+    with pyonig.record_warmup(path) as log:
+        pyonig.highlight(CODE, language='python', cache=False)
+    return log
+
+
+class TestRecord:
+    """Test recording a workload into a profile."""
+
+    def test_profile_written(self, tmp_path):
+        """Test the profile names the scopes and digests what was compiled."""
+        path = tmp_path / 'warmup.json'
+        log = _record(path)
+
+        data = json.loads(path.read_text())
+        assert data['version'] == PROFILE_VERSION
+        assert data['scopes'] == ['source.python']
+        assert len(data['regexes']) == len(log.regexes) > 0
+        assert not COMPILE_LOGS
+
+    def test_digests(self):
+        """Test digests are stable and tell a pattern from a regset of it."""
+        assert regex_digest('a+') == regex_digest('a+')
+        assert regex_digest('a+') != regex_digest(('a+',))
+        assert regex_digest(('a', 'b')) != regex_digest(('ab',))
+        assert len(regex_digest(('a', 'b'))) == 16
+
+
+class TestReplay:
+    """Test replaying a profile at startup."""
+
+    def test_compiles_only_profiled(self, tmp_path):
+        """Test replay compiles the recorded regexes and no others."""
+        path = tmp_path / 'warmup.json'
+        log = _record(path)
+
+        reg.REGEX_CACHE.clear()
+        compiled = pyonig.replay_warmup(path, max_workers=2).result(timeout=60)
+        assert 0 < compiled <= len(log.regexes)
+        assert all(key in reg.REGEX_CACHE for key in log.regexes)
+
+        reg.REGEX_CACHE.clear()
+        assert compiled < pyonig.warmup(['python'])
+
+    def test_output_unchanged(self, tmp_path):
+        """Test highlighting after a replay gives the same output."""
+        path = tmp_path / 'warmup.json'
+        _record(path)
+        expected = pyonig.highlight(CODE, language='python', theme='dark', cache=False)
+
+        reg.REGEX_CACHE.clear()
+        pyonig.replay_warmup(path).result(timeout=60)
+        assert pyonig.highlight(CODE, language='python', theme='dark', cache=False) == expected
+
+    def test_missing_or_stale_profile(self, tmp_path):
+        """Test a missing, corrupt or incompatible profile compiles nothing."""
+        assert pyonig.replay_warmup(tmp_path / 'missing.json').result(timeout=60) == 0
+
+        corrupt = tmp_path / 'corrupt.json'
+        corrupt.write_text('{')
+        assert pyonig.replay_warmup(corrupt).result(timeout=60) == 0
+
+        stale = tmp_path / 'stale.json'
+        stale.write_text(json.dumps({'version': 0, 'scopes': ['source.python'], 'regexes': ['00']}))
+        assert WarmupProfile.load(stale).regexes == frozenset()